@@ -0,0 +1,259 @@
+#include "physics/visibility2.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include "glm/geometric.hpp"
+#include "glm/vec2.hpp"
+#include "glog/logging.h"
+
+using glm::dvec2;
+using std::vector;
+
+namespace physics {
+namespace geometry2 {
+
+namespace {
+constexpr double kTurn = 2.0 * M_PI;
+
+// Distance below which consecutive polygon vertices are merged.
+constexpr double kSamePoint = 1e-9;
+
+// Compute the magnitude of the cross product of two 2d vectors.
+double Cross2Mag(const dvec2& a, const dvec2& b) {
+  return a.x * b.y - a.y * b.x;
+}
+
+// The angle of p around the origin in [0, 2pi).
+double Angle(const dvec2& p) {
+  const double theta = std::atan2(p.y, p.x);
+  return theta < 0.0 ? theta + kTurn : theta;
+}
+
+// An occluder relative to the viewpoint, running counterclockwise from a to b
+// through less than half a turn.
+struct Segment {
+  dvec2 a;
+  dvec2 b;
+};
+
+// How far along dir (in multiples of it) the ray from the viewpoint hits the
+// line through segment.
+double Along(const Segment& segment, const dvec2& dir) {
+  const dvec2 delta = segment.b - segment.a;
+  return Cross2Mag(segment.a, delta) / Cross2Mag(dir, delta);
+}
+
+// Orders segments by distance along the current sweep direction. This stays
+// consistent as the sweep turns as long as segments don't cross.
+class NearerAlong {
+ public:
+  NearerAlong(const vector<Segment>* segments, const dvec2* dir)
+      : segments_(segments), dir_(dir) {}
+
+  bool operator()(uint32_t i, uint32_t j) const {
+    const Segment& a = (*segments_)[i];
+    const Segment& b = (*segments_)[j];
+    double t_a = Along(a, *dir_);
+    double t_b = Along(b, *dir_);
+    if (std::fabs(t_a - t_b) > kSamePoint * std::max(t_a, t_b)) {
+      return t_a < t_b;
+    }
+    // The segments meet on the sweep direction, so compare them just past it:
+    // halfway to the nearer of their ends.
+    const dvec2& end = (Cross2Mag(a.b, b.b) > 0.0) ? a.b : b.b;
+    const dvec2 past = glm::normalize(*dir_) + glm::normalize(end);
+    t_a = Along(a, past);
+    t_b = Along(b, past);
+    if (t_a != t_b) return t_a < t_b;
+    return i < j;
+  }
+
+ private:
+  const vector<Segment>* const segments_;
+  const dvec2* const dir_;
+};
+
+struct Event {
+  double angle;
+  // Where the sweep is when it reaches the event.
+  dvec2 p;
+  bool begin;
+  uint32_t segment_i;
+
+  bool operator<(const Event& rhs) const {
+    if (angle != rhs.angle) return angle < rhs.angle;
+    // Segments ending leave before those beginning at the same angle arrive.
+    return !begin && rhs.begin;
+  }
+};
+
+// Adds the segment a -> b (relative to the viewpoint) and its events, split
+// where it crosses +x so that the sweep can start there.
+void AddSegment(dvec2 a, dvec2 b, vector<Segment>* segments,
+                vector<Event>* events) {
+  const double winding = Cross2Mag(a, b);
+  // Segments pointing at the viewpoint hide nothing.
+  if (winding == 0.0) return;
+  if (winding < 0.0) std::swap(a, b);
+
+  const auto add = [segments, events](dvec2 a, dvec2 b, double angle_a,
+                                      double angle_b) {
+    const uint32_t segment_i = static_cast<uint32_t>(segments->size());
+    segments->push_back({a, b});
+    events->push_back({angle_a, a, true, segment_i});
+    events->push_back({angle_b, b, false, segment_i});
+  };
+  const double angle_a = Angle(a);
+  const double angle_b = Angle(b);
+  if (angle_b > angle_a) {
+    add(a, b, angle_a, angle_b);
+  } else if (angle_b == 0.0) {
+    add(a, b, angle_a, kTurn);
+  } else {
+    const dvec2 cross_p(a.x + (b.x - a.x) * (a.y / (a.y - b.y)), 0.0);
+    add(a, cross_p, angle_a, kTurn);
+    add(cross_p, b, 0.0, angle_b);
+  }
+}
+}  // namespace
+
+Visibility2::Visibility2(double range)
+    : range_(range), dirty_(true), sweep_count_(0) {
+  CHECK_GT(range, 0.0) << "Visibility range must be positive.";
+}
+
+void Visibility2::SetOccluders(const std::vector<Line2>& occluders) {
+  occluders_ = occluders;
+  dirty_ = true;
+}
+
+const std::vector<dvec2>& Visibility2::Compute(dvec2 viewpoint) {
+  if (dirty_ || (viewpoint != viewpoint_)) {
+    viewpoint_ = viewpoint;
+    dirty_ = false;
+    Sweep();
+  }
+  return polygon_;
+}
+
+void Visibility2::Sweep() {
+  ++sweep_count_;
+  polygon_.clear();
+  angles_.clear();
+
+  vector<Segment> segments;
+  vector<Event> events;
+  segments.reserve(occluders_.size() * 2 + 8);
+  events.reserve(segments.capacity() * 2);
+  for (const Line2& occluder : occluders_) {
+    AddSegment(occluder.start() - viewpoint_, occluder.end() - viewpoint_,
+               &segments, &events);
+  }
+  // Where nothing occludes, the range does.
+  const dvec2 corners[] = {{range_, -range_},
+                           {range_, range_},
+                           {-range_, range_},
+                           {-range_, -range_}};
+  for (int i = 0; i < 4; ++i) {
+    AddSegment(corners[i], corners[(i + 1) % 4], &segments, &events);
+  }
+  std::sort(events.begin(), events.end());
+
+  const auto emit = [this](dvec2 p, double angle) {
+    if (!polygon_.empty()) {
+      const dvec2 step = p - (polygon_.back() - viewpoint_);
+      if (glm::dot(step, step) <= kSamePoint * kSamePoint) return;
+    }
+    polygon_.push_back(p + viewpoint_);
+    angles_.push_back(angle);
+  };
+
+  // The segments under the sweep, nearest first.
+  dvec2 dir;
+  std::set<uint32_t, NearerAlong> active(NearerAlong(&segments, &dir));
+  vector<std::set<uint32_t, NearerAlong>::iterator> active_iter(
+      segments.size());
+  for (size_t i = 0; i < events.size();) {
+    const double angle = events[i].angle;
+    dir = events[i].p;
+    const bool had_nearest = !active.empty();
+    const uint32_t nearest = had_nearest ? *active.begin() : 0;
+
+    size_t end_i = i;
+    for (; (end_i < events.size()) && (events[end_i].angle == angle);
+         ++end_i) {
+      const Event& event = events[end_i];
+      if (event.begin) {
+        active_iter[event.segment_i] = active.insert(event.segment_i).first;
+      } else {
+        active.erase(active_iter[event.segment_i]);
+      }
+    }
+    i = end_i;
+
+    // Where the nearest segment changes, the polygon jumps along dir from the
+    // old to the new one.
+    if (active.empty()) continue;
+    const uint32_t new_nearest = *active.begin();
+    if (had_nearest && (new_nearest == nearest)) continue;
+    if (had_nearest) {
+      emit(dir * Along(segments[nearest], dir), angle);
+    }
+    emit(dir * Along(segments[new_nearest], dir), angle);
+  }
+}
+
+dvec2 Visibility2::Boundary(double theta) const {
+  CHECK(!polygon_.empty()) << "No polygon computed yet.";
+  theta = std::fmod(theta, kTurn);
+  if (theta < 0.0) theta += kTurn;
+
+  // The edge from the last vertex at or before theta to the next.
+  size_t next_i =
+      std::upper_bound(angles_.begin(), angles_.end(), theta) - angles_.begin();
+  if (next_i == polygon_.size()) next_i = 0;
+  const size_t prev_i = (next_i == 0) ? polygon_.size() - 1 : next_i - 1;
+  const dvec2 a = polygon_[prev_i] - viewpoint_;
+  const dvec2 delta = polygon_[next_i] - polygon_[prev_i];
+  const dvec2 dir(std::cos(theta), std::sin(theta));
+  const double project = Cross2Mag(dir, delta);
+  if (project == 0.0) return polygon_[prev_i];
+  return viewpoint_ + dir * (Cross2Mag(a, delta) / project);
+}
+
+bool Visibility2::Visible(dvec2 p) const {
+  const dvec2 to_p = p - viewpoint_;
+  if ((to_p.x == 0.0) && (to_p.y == 0.0)) return true;
+  const dvec2 to_boundary = Boundary(Angle(to_p)) - viewpoint_;
+  return glm::dot(to_p, to_p) <= glm::dot(to_boundary, to_boundary);
+}
+
+void Visibility2::Arc(double theta_a, double theta_b,
+                      std::vector<dvec2>* arc) const {
+  CHECK(!polygon_.empty()) << "No polygon computed yet.";
+  const double span = std::min(std::max(theta_b - theta_a, 0.0), kTurn);
+  double start = std::fmod(theta_a, kTurn);
+  if (start < 0.0) start += kTurn;
+
+  arc->push_back(Boundary(start));
+  size_t vertex_i =
+      std::upper_bound(angles_.begin(), angles_.end(), start) - angles_.begin();
+  // Added to the angles of vertices once the walk wraps past +x.
+  double turns = 0.0;
+  for (size_t n = 0; n < polygon_.size(); ++n, ++vertex_i) {
+    if (vertex_i == polygon_.size()) {
+      vertex_i = 0;
+      turns = kTurn;
+    }
+    if (angles_[vertex_i] + turns >= start + span) break;
+    arc->push_back(polygon_[vertex_i]);
+  }
+  arc->push_back(Boundary(start + span));
+}
+
+}  // namespace geometry2
+}  // namespace physics
@@ -0,0 +1,76 @@
+#ifndef PHYSICS_VISIBILITY2_H_
+#define PHYSICS_VISIBILITY2_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include <glm/vec2.hpp>
+
+#include "physics/geometry2.h"
+
+namespace physics {
+namespace geometry2 {
+
+// The region visible from a point among line segment occluders (the
+// visibility polygon), found with an angular sweep over the occluders'
+// endpoints in O(n log n) for n occluders:
+//
+//   Visibility2 visibility(400.0);
+//   visibility.SetOccluders(walls);
+//   ...
+//   // Per frame; only sweeps again if eye moved.
+//   const std::vector<glm::dvec2>& polygon = visibility.Compute(eye);
+//
+// The polygon's vertices are in order of increasing angle around the
+// viewpoint (as atan2 measures it, starting from +x), so it's star shaped
+// around the viewpoint and can be drawn as a triangle fan from it. Where
+// nothing occludes, it's bounded by the square reaching range from the
+// viewpoint on each side.
+//
+// Occluders are assumed to cross neither each other nor that square except at
+// their endpoints. Where they do, the polygon may follow the farther occluder
+// up to the next endpoint.
+class Visibility2 {
+ public:
+  explicit Visibility2(double range);
+
+  // Replaces the occluders, so the next Compute sweeps again.
+  void SetOccluders(const std::vector<Line2>& occluders);
+
+  // The visibility polygon from viewpoint, swept again only if the viewpoint
+  // or occluders changed since the last call.
+  const std::vector<glm::dvec2>& Compute(glm::dvec2 viewpoint);
+
+  // Queries on the last computed polygon, each O(log n).
+  //
+  // Where the ray from the viewpoint at angle theta (radians) leaves the
+  // polygon.
+  glm::dvec2 Boundary(double theta) const;
+  // Whether there's a line of sight from the viewpoint to p.
+  bool Visible(glm::dvec2 p) const;
+  // Appends the polygon's boundary from angle theta_a counterclockwise to
+  // theta_b (at most a full turn): where it starts and ends, and the vertices
+  // between.
+  void Arc(double theta_a, double theta_b, std::vector<glm::dvec2>* arc) const;
+
+  // How many times Compute has swept, e.g. to check that caching works.
+  uint64_t sweep_count() const { return sweep_count_; }
+
+ private:
+  void Sweep();
+
+  const double range_;
+  std::vector<Line2> occluders_;
+  bool dirty_;
+  glm::dvec2 viewpoint_;
+
+  std::vector<glm::dvec2> polygon_;
+  // The angle of each polygon vertex around the viewpoint, in [0, 2pi].
+  std::vector<double> angles_;
+  uint64_t sweep_count_;
+};
+
+}  // namespace geometry2
+}  // namespace physics
+
+#endif  // PHYSICS_VISIBILITY2_H_
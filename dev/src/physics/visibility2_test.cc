@@ -0,0 +1,152 @@
+#include "physics/visibility2.h"
+
+#include <math.h>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "glm/geometric.hpp"
+#include "glm/vec2.hpp"
+#include "gtest/gtest.h"
+
+using glm::dvec2;
+using std::vector;
+
+namespace physics {
+namespace geometry2 {
+
+namespace {
+double Area(const vector<dvec2>& polygon) {
+  double area = 0.0;
+  for (size_t i = 0; i < polygon.size(); ++i) {
+    const dvec2& a = polygon[i];
+    const dvec2& b = polygon[(i + 1) % polygon.size()];
+    area += a.x * b.y - a.y * b.x;
+  }
+  return area * 0.5;
+}
+
+// Adds the outline of the axis aligned box with corners a and b.
+void AddBox(dvec2 a, dvec2 b, vector<Line2>* lines) {
+  lines->push_back({{a.x, a.y}, {b.x, a.y}});
+  lines->push_back({{b.x, a.y}, {b.x, b.y}});
+  lines->push_back({{b.x, b.y}, {a.x, b.y}});
+  lines->push_back({{a.x, b.y}, {a.x, a.y}});
+}
+
+// The distance to the nearest occluder along a ray, the slow way.
+double CastRay(const vector<Line2>& lines, const Ray2& ray) {
+  double nearest = std::numeric_limits<double>::max();
+  for (const Line2& line : lines) {
+    const auto [intersects, p] = Operations2::Intersects(ray, line);
+    if (intersects) nearest = std::min(nearest, glm::length(p - ray.start()));
+  }
+  return nearest;
+}
+}  // namespace
+
+TEST(Visibility2Test, noOccluders_isRangeSquare) {
+  Visibility2 visibility(10.0);
+  const vector<dvec2>& polygon = visibility.Compute({3, 4});
+  EXPECT_DOUBLE_EQ(Area(polygon), 400.0);
+  for (const dvec2& p : polygon) {
+    EXPECT_DOUBLE_EQ(std::max(std::fabs(p.x - 3), std::fabs(p.y - 4)), 10.0);
+  }
+}
+
+TEST(Visibility2Test, wallCastsShadow) {
+  Visibility2 visibility(10.0);
+  visibility.SetOccluders({{{2, -1}, {2, 1}}});
+  const vector<dvec2>& polygon = visibility.Compute({0, 0});
+
+  // The shadow's a trapezoid from the wall to the edge of the range.
+  EXPECT_NEAR(Area(polygon), 400.0 - 48.0, 1e-9);
+  EXPECT_TRUE(visibility.Visible({1, 0}));
+  EXPECT_FALSE(visibility.Visible({3, 0}));
+  EXPECT_TRUE(visibility.Visible({3, 2}));
+  EXPECT_NEAR(visibility.Boundary(0.0).x, 2.0, 1e-9);
+  EXPECT_NEAR(visibility.Boundary(M_PI).x, -10.0, 1e-9);
+}
+
+TEST(Visibility2Test, closedRoom) {
+  vector<Line2> walls;
+  AddBox({-2, -3}, {4, 1}, &walls);
+  Visibility2 visibility(100.0);
+  visibility.SetOccluders(walls);
+  EXPECT_NEAR(Area(visibility.Compute({0, 0})), 24.0, 1e-9);
+  EXPECT_NEAR(Area(visibility.Compute({3.5, -2.5})), 24.0, 1e-9);
+}
+
+TEST(Visibility2Test, matchesRayCasting) {
+  constexpr double kRange = 50.0;
+  std::mt19937 rng(11);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+  // Boxes in separate cells of a grid, so that none of them cross.
+  vector<Line2> lines;
+  for (int y = -4; y < 4; ++y) {
+    for (int x = -4; x < 4; ++x) {
+      if ((x == 0) && (y == 0)) continue;
+      const dvec2 cell(x * 10.0, y * 10.0);
+      const dvec2 a = cell + dvec2(unit(rng) * 4.0, unit(rng) * 4.0);
+      AddBox(a, a + dvec2(1.0 + unit(rng) * 4.0, 1.0 + unit(rng) * 4.0),
+             &lines);
+    }
+  }
+  Visibility2 visibility(kRange);
+  visibility.SetOccluders(lines);
+
+  for (int trial = 0; trial < 10; ++trial) {
+    const dvec2 eye(unit(rng) * 9.0, unit(rng) * 9.0);
+    visibility.Compute(eye);
+    // Rays that miss every box stop at the range.
+    vector<Line2> bounded = lines;
+    AddBox(eye - dvec2(kRange), eye + dvec2(kRange), &bounded);
+    for (int ray_i = 0; ray_i < 500; ++ray_i) {
+      const double theta = unit(rng) * 2.0 * M_PI;
+      const double expected =
+          CastRay(bounded, Ray2(eye, {std::cos(theta), std::sin(theta)}));
+      ASSERT_NEAR(glm::length(visibility.Boundary(theta) - eye), expected,
+                  1e-6)
+          << "Eye (" << eye.x << ", " << eye.y << "), theta " << theta;
+    }
+  }
+}
+
+TEST(Visibility2Test, arc) {
+  Visibility2 visibility(10.0);
+  visibility.Compute({0, 0});
+
+  vector<dvec2> arc;
+  visibility.Arc(-M_PI / 2, 0.0, &arc);
+  ASSERT_EQ(arc.size(), 3);
+  EXPECT_NEAR(arc[0].x, 0.0, 1e-9);
+  EXPECT_NEAR(arc[0].y, -10.0, 1e-9);
+  EXPECT_NEAR(arc[1].x, 10.0, 1e-9);
+  EXPECT_NEAR(arc[1].y, -10.0, 1e-9);
+  EXPECT_NEAR(arc[2].x, 10.0, 1e-9);
+  EXPECT_NEAR(arc[2].y, 0.0, 1e-9);
+
+  // Across +x.
+  arc.clear();
+  visibility.Arc(-0.1, 0.1, &arc);
+  ASSERT_GE(arc.size(), 2);
+  for (const dvec2& p : arc) EXPECT_NEAR(p.x, 10.0, 1e-9);
+}
+
+TEST(Visibility2Test, cachesUntilSomethingMoves) {
+  Visibility2 visibility(10.0);
+  visibility.Compute({0, 0});
+  visibility.Compute({0, 0});
+  EXPECT_EQ(visibility.sweep_count(), 1);
+
+  visibility.Compute({1, 0});
+  EXPECT_EQ(visibility.sweep_count(), 2);
+
+  visibility.SetOccluders({{{2, -1}, {2, 1}}});
+  visibility.Compute({1, 0});
+  EXPECT_EQ(visibility.sweep_count(), 3);
+}
+
+}  // namespace geometry2
+}  // namespace physics
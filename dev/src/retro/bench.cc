@@ -0,0 +1,184 @@
+// Renderer throughput benchmark. Records a frame's worth of typical drawing
+// (two tile layers, text and primitives) into a FbDrawList once, then replays
+// it for a number of frames on a headless screen, reporting frames/sec and
+// draw calls/sec. The final frame's checksum is also reported so that changes
+// in output can be spotted alongside changes in speed.
+//
+//   retro_bench --backend=software --frames=1000
+//
+// With --capture, timed frames are also captured (see retro::FbCapture) and
+// the render thread's cost of capturing is reported. Reading frames back
+// stalls Flip until they're drawn, so that cost is part of frames/sec too.
+
+#include <stdint.h>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "gflags/gflags.h"
+#include "glm/vec2.hpp"
+#include "glog/logging.h"
+#include "retro/fbcapture.h"
+#include "retro/fbcore.h"
+#include "retro/fbdrawlist.h"
+#include "retro/fbgfx.h"
+#include "retro/fbimg.h"
+
+DEFINE_string(backend, "accelerated",
+              "FbGfx backend to benchmark, \"accelerated\" or \"software\".");
+DEFINE_uint32(frames, 600, "Number of timed frames.");
+DEFINE_uint32(warmup_frames, 60, "Number of untimed frames drawn first.");
+DEFINE_int32(width, 640, "Screen width.");
+DEFINE_int32(height, 480, "Screen height.");
+DEFINE_string(capture, "",
+              "If set, timed frames are captured as PNGs named with this "
+              "prefix.");
+
+using glm::ivec2;
+using retro::FbCapture;
+using retro::FbColor32;
+using retro::FbDrawList;
+using retro::FbGfx;
+using retro::FbImg;
+
+namespace {
+constexpr int32_t kTileSide = 16;
+constexpr int32_t kTilesetSide = 8;
+
+// Builds a kTilesetSide x kTilesetSide sheet of tiles, half of which are
+// hollow outlines so that alpha blending gets exercised.
+std::unique_ptr<FbImg> MakeTileset() {
+  auto tileset = FbImg::OfSize(ivec2(kTilesetSide * kTileSide));
+  FbGfx::Cls(*tileset, FbColor32::TRANSPARENT_BLACK);
+  for (int32_t y = 0; y < kTilesetSide; ++y) {
+    for (int32_t x = 0; x < kTilesetSide; ++x) {
+      const ivec2 p = ivec2(x, y) * kTileSide;
+      const FbColor32 color(static_cast<uint8_t>(x * 32),
+                            static_cast<uint8_t>(y * 32), 0x80, 0xff);
+      if ((x + y) & 1) {
+        FbGfx::Rect(*tileset, p, ivec2(kTileSide), color);
+        FbGfx::Rect(*tileset, p + ivec2(1), ivec2(kTileSide - 2), color);
+      } else {
+        FbGfx::FillRect(*tileset, p, ivec2(kTileSide), color);
+      }
+    }
+  }
+  return tileset;
+}
+
+void RecordTileLayer(const FbImg& tileset, uint32_t seed, FbDrawList* list) {
+  const ivec2 res(FLAGS_width, FLAGS_height);
+  for (int32_t y = 0; y < res.y; y += kTileSide) {
+    for (int32_t x = 0; x < res.x; x += kTileSide) {
+      const int32_t tile =
+          (x * 7 + y * 13 + seed) % (kTilesetSide * kTilesetSide);
+      const ivec2 src_a =
+          ivec2(tile % kTilesetSide, tile / kTilesetSide) * kTileSide;
+      list->Put(tileset, {x, y}, src_a, src_a + ivec2(kTileSide - 1));
+    }
+  }
+}
+
+void RecordFrame(const FbImg& tileset, FbDrawList* list) {
+  list->Cls(FbColor32::BLACK);
+  RecordTileLayer(tileset, 0, list);
+  RecordTileLayer(tileset, 17, list);
+
+  for (int32_t i = 0; i < 64; ++i) {
+    const ivec2 a((i * 37) % FLAGS_width, (i * 53) % FLAGS_height);
+    const ivec2 b((i * 91) % FLAGS_width, (i * 29) % FLAGS_height);
+    list->Line(a, b, FbColor32(0xff, 0xff, 0x00, 0xc0));
+    list->PSet(b, FbColor32::WHITE);
+    list->Rect(a, {24, 16}, FbColor32::GREEN);
+    list->FillRect(b, {20, 12}, FbColor32(0x00, 0x40, 0xff, 0x80));
+  }
+
+  for (int32_t i = 0; i < 16; ++i) {
+    list->TextLine(absl::StrCat("Line of benchmark text #", i),
+                   {8, 8 + i * 10}, FbColor32::WHITE);
+  }
+  list->TextParagraph(
+      "The quick brown fox jumps over the lazy dog, then does it again and "
+      "again until the paragraph is long enough to wrap a few times.",
+      {FLAGS_width / 2, 8}, {FLAGS_width - 8, FLAGS_height / 2},
+      FbColor32::YELLOW, FbGfx::TEXT_ALIGN_H_CENTER, FbGfx::TEXT_ALIGN_V_TOP);
+}
+
+// FNV-1a over the frame's pixels.
+uint64_t Checksum(const std::vector<uint32_t>& pixels) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (const uint32_t pixel : pixels) {
+    hash = (hash ^ pixel) * 0x100000001b3;
+  }
+  return hash;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  google::InitGoogleLogging(argv[0]);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  CHECK((FLAGS_backend == "accelerated") || (FLAGS_backend == "software"))
+      << "Unknown backend: " << FLAGS_backend;
+  FbGfx::Screen({FLAGS_width, FLAGS_height}, false, "retro_bench", {-1, -1},
+                FbGfx::ScreenOptions()
+                    .SetBackend(FLAGS_backend == "software"
+                                    ? FbGfx::BACKEND_SOFTWARE
+                                    : FbGfx::BACKEND_ACCELERATED)
+                    .SetHeadless(true)
+                    .SetOffscreen(!FLAGS_capture.empty()));
+
+  const std::unique_ptr<FbImg> tileset = MakeTileset();
+  FbDrawList frame;
+  RecordFrame(*tileset, &frame);
+
+  for (uint32_t i = 0; i < FLAGS_warmup_frames; ++i) {
+    FbGfx::ReplayDrawList(frame);
+    FbGfx::Flip();
+  }
+
+  if (!FLAGS_capture.empty()) {
+    FbGfx::StartCapture(std::make_unique<FbCapture>(FLAGS_capture));
+  }
+  double capture_seconds = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < FLAGS_frames; ++i) {
+    FbGfx::ReplayDrawList(frame);
+    FbGfx::Flip();
+    capture_seconds += FbGfx::GetFrameStats().capture_seconds;
+  }
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  const std::unique_ptr<FbCapture> capture = FbGfx::StopCapture();
+
+  // One more (untimed) frame to read back, since Flip clobbers the frame.
+  FbGfx::ReplayDrawList(frame);
+  const uint64_t checksum = Checksum(FbGfx::ReadFrame());
+  FbGfx::Flip();
+
+  const double seconds = elapsed.count();
+  std::cout << "backend: " << FLAGS_backend << "\n"
+            << "resolution: " << FLAGS_width << "x" << FLAGS_height << "\n"
+            << "frames: " << FLAGS_frames << "\n"
+            << "draw calls/frame: " << frame.size() << "\n"
+            << "seconds: " << seconds << "\n"
+            << "frames/sec: " << FLAGS_frames / seconds << "\n"
+            << "draw calls/sec: " << FLAGS_frames * frame.size() / seconds
+            << "\n"
+            << "final frame checksum: " << std::hex << checksum << std::dec
+            << std::endl;
+  if (capture != nullptr) {
+    std::cout << "capture ms/frame: "
+              << capture_seconds * 1000.0 / FLAGS_frames << "\n"
+              << "readback ms/frame (synchronous): "
+              << capture->readback_seconds() * 1000.0 / FLAGS_frames << "\n"
+              << "capture share of frame time: "
+              << capture_seconds * 100.0 / seconds << "%\n"
+              << "frames captured: " << capture->captured() << "\n"
+              << "frames dropped: " << capture->dropped() << std::endl;
+  }
+  return 0;
+}
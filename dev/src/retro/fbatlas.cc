@@ -0,0 +1,121 @@
+#include "retro/fbatlas.h"
+
+#include <algorithm>
+
+#include "SDL.h"
+#include "glog/logging.h"
+#include "retro/fbgfx.h"
+#include "retro/fbsoft.h"
+#include "util/deleterptr.h"
+
+using glm::ivec2;
+using std::string;
+using std::unique_ptr;
+using util::deleter_ptr;
+
+namespace retro {
+
+FbAtlas::FbAtlas(int32_t page_side) : page_side_(page_side) {
+  CHECK_GT(page_side, 0) << "Bad atlas page side: " << page_side;
+}
+
+FbAtlas::Page FbAtlas::MakePage() const {
+  if (FbGfx::is_software()) {
+    return {std::shared_ptr<const FbImg>(
+                new FbImg(std::make_unique<fbsoft::Buffer>(ivec2(page_side_)),
+                          page_side_, page_side_, false)),
+            SkylinePacker(ivec2(page_side_))};
+  }
+
+  SDL_RendererInfo info;
+  CHECK_EQ(SDL_GetRendererInfo(FbGfx::renderer_.get(), &info), 0)
+      << "SDL error (SDL_GetRendererInfo): " << SDL_GetError();
+  int32_t side = page_side_;
+  if (info.max_texture_width > 0) side = std::min(side, info.max_texture_width);
+  if (info.max_texture_height > 0) {
+    side = std::min(side, info.max_texture_height);
+  }
+
+  // Pages hold stb_image's byte order directly (see TextureFromStbImage).
+  // They're created as render targets only so that they can be cleared
+  // without uploading a page of zeros; reloaded pages are static textures.
+  deleter_ptr<SDL_Texture> texture(
+      SDL_CreateTexture(FbGfx::renderer_.get(), SDL_PIXELFORMAT_ABGR8888,
+                        SDL_TEXTUREACCESS_TARGET, side, side),
+      [](SDL_Texture* t) { SDL_DestroyTexture(t); });
+  CHECK_NE(texture.get(), static_cast<SDL_Texture*>(NULL))
+      << "SDL error (SDL_CreateTexture): " << SDL_GetError();
+  FbGfx::SetRenderTarget(texture.get());
+  FbGfx::SetRenderColor(FbColor32(0));
+  CHECK_EQ(SDL_RenderClear(FbGfx::renderer_.get()), 0)
+      << "SDL error (SDL_RenderClear): " << SDL_GetError();
+
+  // With a texture budget set, pages keep a copy of their pixels to be
+  // reloaded from if dropped. Without one nothing is dropped, so no copy is
+  // made. The font's page is made before a budget can be set, so it's never
+  // dropped.
+  std::unique_ptr<std::vector<uint32_t>> pixels;
+  if (FbGfx::GetTextureBudget() > 0) {
+    pixels = std::make_unique<std::vector<uint32_t>>(side * side, 0);
+  }
+  return {std::shared_ptr<const FbImg>(new FbImg(
+              std::move(texture), side, side, false, false, std::move(pixels))),
+          SkylinePacker(ivec2(side))};
+}
+
+unique_ptr<FbImg> FbAtlas::FromFile(const string& filename) {
+  FbGfx::CheckInit(__func__);
+
+  ivec2 dims;
+  const deleter_ptr<FbImg::StbImageData> image_data =
+      FbImg::LoadStbImage(filename, &dims);
+  return FromStbImage(image_data.get(), dims, filename);
+}
+
+unique_ptr<FbImg> FbAtlas::FromStbImage(const FbImg::StbImageData* data,
+                                        ivec2 dims, const string& filename) {
+  const ivec2 padded_dims = dims + ivec2(kPadding);
+  ivec2 p;
+  Page* page = nullptr;
+  for (Page& candidate : pages_) {
+    if (candidate.packer.Pack(padded_dims, &p)) {
+      page = &candidate;
+      break;
+    }
+  }
+  if (page == nullptr) {
+    Page new_page = MakePage();
+    if (!new_page.packer.Pack(padded_dims, &p)) {
+      LOG(WARNING) << "Image " << filename << " (" << dims.x << "x" << dims.y
+                   << ") is too large for an atlas page, loading it alone.";
+      return FbImg::FromStbImage(data, dims, filename);
+    }
+    pages_.push_back(std::move(new_page));
+    page = &pages_.back();
+  }
+
+  if (FbGfx::is_software()) {
+    fbsoft::Surface dst = page->img->buffer_->surface();
+    dst.pixels = dst.row(p.y) + p.x;
+    FbImg::CopyStbImage(data, dims, dst);
+  } else {
+    std::vector<uint32_t>* const copy = page->img->cpu_copy_.get();
+    if (copy != nullptr) {
+      const uint32_t* src = reinterpret_cast<const uint32_t*>(data);
+      const int32_t side = page->img->width();
+      for (int32_t y = 0; y < dims.y; ++y) {
+        std::copy_n(src + y * dims.x, dims.x,
+                    copy->data() + (p.y + y) * side + p.x);
+      }
+    }
+    ++FbGfx::frame_stats_.uploads;
+    const SDL_Rect rect{p.x, p.y, dims.x, dims.y};
+    CHECK_EQ(SDL_UpdateTexture(FbGfx::GetTexture(page->img.get()), &rect, data,
+                               dims.x * sizeof(uint32_t)),
+             0)
+        << "SDL error (SDL_UpdateTexture): " << SDL_GetError();
+  }
+  return unique_ptr<FbImg>(new FbImg(page->img, p, dims.x, dims.y));
+}
+
+}  // namespace retro
@@ -0,0 +1,62 @@
+#ifndef RETRO_FBATLAS_H_
+#define RETRO_FBATLAS_H_
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "glm/vec2.hpp"
+#include "retro/fbimg.h"
+#include "retro/skylinepacker.h"
+#include "util/noncopyable.h"
+
+namespace retro {
+
+// Packs images into a few large "page" textures, handing out FbImgs that are
+// views of their area of a page. Since FbBatch (and the text drawing in FbGfx)
+// group draws by underlying texture, images sharing a page batch together.
+//
+// Pages are kept alive by the views into them, so views may outlive the
+// atlas. Like FbGfx, this can only be used from the thread that called
+// FbGfx::Screen.
+class FbAtlas : public util::NonCopyable {
+  friend class FbImgLoader;
+
+ public:
+  static constexpr int32_t kDefaultPageSide = 2048;
+
+  // page_side is clamped to the renderer's maximum texture size.
+  explicit FbAtlas(int32_t page_side = kDefaultPageSide);
+
+  // Load an image from a file into the atlas. Images too large for a page
+  // are loaded as standalone images instead.
+  std::unique_ptr<FbImg> FromFile(const std::string& filename);
+
+  size_t page_count() const { return pages_.size(); }
+
+ private:
+  // Images are padded by this many transparent pixels on their right and
+  // bottom edges so that filtering never samples a neighbor.
+  static constexpr int32_t kPadding = 1;
+
+  struct Page {
+    std::shared_ptr<const FbImg> img;
+    SkylinePacker packer;
+  };
+
+  // Creates an empty (transparent) page.
+  Page MakePage() const;
+
+  // Packs RGBA bytes into a page. filename is only used for logging.
+  std::unique_ptr<FbImg> FromStbImage(const FbImg::StbImageData* data,
+                                      glm::ivec2 dims,
+                                      const std::string& filename);
+
+  const int32_t page_side_;
+  std::vector<Page> pages_;
+};
+
+}  // namespace retro
+
+#endif  // RETRO_FBATLAS_H_
@@ -0,0 +1,184 @@
+#include "retro/fbbatch.h"
+
+#include <algorithm>
+#include <tuple>
+
+#include "glog/logging.h"
+#include "retro/fbimg.h"
+#include "retro/fbsoft.h"
+
+using glm::ivec2;
+
+namespace retro {
+
+FbBatch::FbBatch() : begun_(false), mode_(SORT_DEFERRED) {}
+
+void FbBatch::Begin(SortMode mode) {
+  CHECK(!begun_) << "FbBatch::Begin called twice without a call to End.";
+  begun_ = true;
+  mode_ = mode;
+  quads_.clear();
+  texture_order_.clear();
+}
+
+void FbBatch::Put(const FbImg& src, ivec2 p, ivec2 src_a, ivec2 src_b) {
+  FbGfx::CheckInit(__func__);
+  AddQuad(nullptr, src, p, FbGfx::PutOptions(), src_a, src_b);
+}
+void FbBatch::Put(const FbImg& target, const FbImg& src, ivec2 p, ivec2 src_a,
+                  ivec2 src_b) {
+  FbGfx::CheckInit(__func__);
+  target.CheckTarget(__func__);
+  AddQuad(&target, src, p, FbGfx::PutOptions(), src_a, src_b);
+}
+
+void FbBatch::PutEx(const FbImg& src, ivec2 p, FbGfx::PutOptions opts,
+                    ivec2 src_a, ivec2 src_b) {
+  FbGfx::CheckInit(__func__);
+  AddQuad(nullptr, src, p, opts, src_a, src_b);
+}
+void FbBatch::PutEx(const FbImg& target, const FbImg& src, ivec2 p,
+                    FbGfx::PutOptions opts, ivec2 src_a, ivec2 src_b) {
+  FbGfx::CheckInit(__func__);
+  target.CheckTarget(__func__);
+  AddQuad(&target, src, p, opts, src_a, src_b);
+}
+
+uint32_t FbBatch::GetOrder(const FbImg* img) {
+  return texture_order_.emplace(img, texture_order_.size()).first->second;
+}
+
+void FbBatch::AddQuad(const FbImg* target, const FbImg& src, ivec2 p,
+                      FbGfx::PutOptions opts, ivec2 src_a, ivec2 src_b) {
+  CHECK(begun_) << "FbBatch::Begin must be called before adding to a batch.";
+  CHECK(!src.is_locked()) << "Can't draw a locked image.";
+  // Quads are keyed by the image actually holding the pixels, so that views
+  // into the same atlas page batch together.
+  const FbImg& src_root = src.root();
+  Quad quad{GetOrder(target),
+            GetOrder(&src_root),
+            static_cast<uint32_t>(quads_.size()),
+            target,
+            &src_root,
+            opts.blend,
+            opts.mod,
+            {},
+            {}};
+  FbGfx::ComputePutRects({src.width(), src.height()},
+                         p + FbGfx::DrawOffset(target), src_a, src_b,
+                         &quad.src_rect, &quad.dst_rect);
+  quad.src_rect.x += src.origin_.x;
+  quad.src_rect.y += src.origin_.y;
+  if ((quad.dst_rect.w <= 0) || (quad.dst_rect.h <= 0)) return;
+  if (FbGfx::Culled(target, {quad.dst_rect.x, quad.dst_rect.y},
+                    {quad.dst_rect.x + quad.dst_rect.w - 1,
+                     quad.dst_rect.y + quad.dst_rect.h - 1})) {
+    return;
+  }
+  quads_.push_back(quad);
+}
+
+void FbBatch::End() {
+  CHECK(begun_) << "FbBatch::End called without a call to Begin.";
+  begun_ = false;
+  if (quads_.empty()) return;
+
+  if (mode_ == SORT_TEXTURE) {
+    std::sort(quads_.begin(), quads_.end(), [](const Quad& a, const Quad& b) {
+      return std::tie(a.target_order, a.src_order, a.blend, a.sequence) <
+             std::tie(b.target_order, b.src_order, b.blend, b.sequence);
+    });
+  }
+
+  uint32_t run_start = 0;
+  for (uint32_t i = 1; i <= quads_.size(); ++i) {
+    if ((i == quads_.size()) || (quads_[i].target != quads_[run_start].target) ||
+        (quads_[i].src != quads_[run_start].src) ||
+        (quads_[i].blend != quads_[run_start].blend)) {
+      Submit(run_start, i);
+      run_start = i;
+    }
+  }
+  quads_.clear();
+}
+
+void FbBatch::SubmitSoftware(uint32_t begin, uint32_t end) {
+  const Quad& first = quads_[begin];
+  const fbsoft::Surface dst = FbGfx::GetSoftSurface(first.target);
+  const fbsoft::Surface src = FbGfx::GetSoftSurface(first.src);
+  for (uint32_t i = begin; i < end; ++i) {
+    const Quad& quad = quads_[i];
+    fbsoft::Blit(dst, {quad.dst_rect.x, quad.dst_rect.y}, src,
+                 {quad.src_rect.x, quad.src_rect.y},
+                 {quad.src_rect.w, quad.src_rect.h}, quad.blend, quad.mod);
+  }
+  FbGfx::CountDraw(end - begin, end - begin);
+}
+
+void FbBatch::Submit(uint32_t begin, uint32_t end) {
+  if (FbGfx::is_software()) {
+    SubmitSoftware(begin, end);
+    return;
+  }
+
+  const Quad& first = quads_[begin];
+  SDL_Texture* const src = FbGfx::GetTexture(first.src);
+  FbGfx::SetRenderTarget(FbGfx::GetTexture(first.target));
+  FbGfx::SetTextureBlendMode(src, FbGfx::GetSdlBlendMode(first.blend));
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+  // Texture modulation is carried by the vertex colors instead.
+  FbGfx::SetTextureMod(src, FbColor32::WHITE);
+
+  vertices_.clear();
+  indices_.clear();
+  const float inv_w = 1.0f / first.src->width();
+  const float inv_h = 1.0f / first.src->height();
+  for (uint32_t i = begin; i < end; ++i) {
+    const Quad& quad = quads_[i];
+    const SDL_Color color{
+        static_cast<Uint8>(quad.mod.channel.r),
+        static_cast<Uint8>(quad.mod.channel.g),
+        static_cast<Uint8>(quad.mod.channel.b),
+        static_cast<Uint8>(quad.mod.channel.a)};
+    const float x0 = quad.dst_rect.x;
+    const float y0 = quad.dst_rect.y;
+    const float x1 = quad.dst_rect.x + quad.dst_rect.w;
+    const float y1 = quad.dst_rect.y + quad.dst_rect.h;
+    const float u0 = quad.src_rect.x * inv_w;
+    const float v0 = quad.src_rect.y * inv_h;
+    const float u1 = (quad.src_rect.x + quad.src_rect.w) * inv_w;
+    const float v1 = (quad.src_rect.y + quad.src_rect.h) * inv_h;
+
+    const int base = static_cast<int>(vertices_.size());
+    vertices_.push_back({{x0, y0}, color, {u0, v0}});
+    vertices_.push_back({{x1, y0}, color, {u1, v0}});
+    vertices_.push_back({{x1, y1}, color, {u1, v1}});
+    vertices_.push_back({{x0, y1}, color, {u0, v1}});
+    indices_.insert(indices_.end(),
+                    {base, base + 1, base + 2, base, base + 2, base + 3});
+  }
+  CHECK_EQ(SDL_RenderGeometry(FbGfx::renderer_.get(), src,
+                              vertices_.data(),
+                              static_cast<int>(vertices_.size()),
+                              indices_.data(),
+                              static_cast<int>(indices_.size())),
+           0)
+      << "SDL error (SDL_RenderGeometry): " << SDL_GetError();
+  FbGfx::CountDraw(1, end - begin);
+#else
+  // No geometry API, so we can only save on the render target and blend mode
+  // changes.
+  for (uint32_t i = begin; i < end; ++i) {
+    const Quad& quad = quads_[i];
+    FbGfx::SetTextureMod(src, quad.mod);
+    CHECK_EQ(SDL_RenderCopy(FbGfx::renderer_.get(), src, &quad.src_rect,
+                            &quad.dst_rect),
+             0)
+        << "SDL error (SDL_RenderCopy): " << SDL_GetError();
+  }
+  FbGfx::CountDraw(end - begin, end - begin);
+#endif
+}
+
+}  // namespace retro
@@ -0,0 +1,111 @@
+#ifndef RETRO_FBBATCH_H_
+#define RETRO_FBBATCH_H_
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include "SDL.h"
+#include "glm/vec2.hpp"
+#include "retro/fbcore.h"
+#include "retro/fbgfx.h"
+#include "util/noncopyable.h"
+
+namespace retro {
+
+class FbImg;
+// Collects FbGfx::Put/PutEx style quads between calls to Begin and End, then
+// submits them with as few state changes and draw calls as possible (a single
+// SDL_RenderGeometry call per run of quads sharing a target, source and blend
+// mode).
+//
+// Quads drawn to the screen go through the viewport set when they're added
+// (see FbGfx::SetViewport), and are culled then if they fall outside of it.
+//
+// Images passed to Put/PutEx must outlive the call to End. Like FbGfx, this
+// can only be used from the thread that called FbGfx::Screen.
+//
+//   FbBatch batch;
+//   batch.Begin();
+//   for (...) batch.Put(tiles, p, src_a, src_b);
+//   batch.End();
+//
+// By default quads keep the order they were added in, so this is a drop-in
+// replacement for a sequence of Put calls. SORT_TEXTURE merges more but only
+// suits quads that don't overlap.
+//
+class FbBatch : public util::NonCopyable {
+ public:
+  enum SortMode {
+    // Quads are drawn in the order they were submitted. Consecutive quads
+    // sharing a target, source and blend mode are merged into one draw call.
+    // The default.
+    SORT_DEFERRED,
+    // Quads are grouped by target, then source, then blend mode (each in
+    // order of first use). Submission order is only preserved among quads
+    // sharing all three, so this should only be used when quads with
+    // different sources don't overlap, or when their order doesn't matter.
+    SORT_TEXTURE
+  };
+
+  FbBatch();
+
+  void Begin(SortMode mode = SORT_DEFERRED);
+
+  // These mirror FbGfx::Put and FbGfx::PutEx.
+  void Put(const FbImg& src, glm::ivec2 p, glm::ivec2 src_a = {-1, -1},
+           glm::ivec2 src_b = {-1, -1});
+  void Put(const FbImg& target, const FbImg& src, glm::ivec2 p,
+           glm::ivec2 src_a = {-1, -1}, glm::ivec2 src_b = {-1, -1});
+  void PutEx(const FbImg& src, glm::ivec2 p, FbGfx::PutOptions opts,
+             glm::ivec2 src_a = {-1, -1}, glm::ivec2 src_b = {-1, -1});
+  void PutEx(const FbImg& target, const FbImg& src, glm::ivec2 p,
+             FbGfx::PutOptions opts, glm::ivec2 src_a = {-1, -1},
+             glm::ivec2 src_b = {-1, -1});
+
+  // Submits all of the quads collected since Begin.
+  void End();
+
+  bool is_begun() const { return begun_; }
+
+ private:
+  struct Quad {
+    uint32_t target_order;
+    uint32_t src_order;
+    uint32_t sequence;
+    // nullptr for the screen.
+    const FbImg* target;
+    // The root of the source image (its atlas page if it's a view), which
+    // src_rect is relative to.
+    const FbImg* src;
+    FbGfx::PutOptions::BlendMode blend;
+    FbColor32 mod;
+    SDL_Rect src_rect;
+    SDL_Rect dst_rect;
+  };
+
+  void AddQuad(const FbImg* target, const FbImg& src, glm::ivec2 p,
+               FbGfx::PutOptions opts, glm::ivec2 src_a, glm::ivec2 src_b);
+
+  // Order of first use of an image in this batch, used as a sort key so that
+  // sorting is deterministic.
+  uint32_t GetOrder(const FbImg* img);
+
+  // Draws quads_[begin, end), which must all share a target, source and blend
+  // mode.
+  void Submit(uint32_t begin, uint32_t end);
+  void SubmitSoftware(uint32_t begin, uint32_t end);
+
+  bool begun_;
+  SortMode mode_;
+  std::vector<Quad> quads_;
+  std::unordered_map<const FbImg*, uint32_t> texture_order_;
+
+  // Scratch buffers re-used between calls to End.
+  std::vector<SDL_Vertex> vertices_;
+  std::vector<int> indices_;
+};
+
+}  // namespace retro
+
+#endif  // RETRO_FBBATCH_H_
@@ -0,0 +1,164 @@
+#include "retro/fbbatch.h"
+
+#include <memory>
+#include <vector>
+
+#include "SDL.h"
+#include "glm/vec2.hpp"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "retro/fbcore.h"
+#include "retro/fbgfx.h"
+#include "retro/fbimg.h"
+#include "retro/fbtestscreen.h"
+
+namespace retro {
+namespace {
+using fbtest::DrawCalls;
+using fbtest::ScreenRow;
+using glm::ivec2;
+using ::testing::ElementsAre;
+
+constexpr uint32_t kRed = FbColor32::RED;
+constexpr uint32_t kGreen = FbColor32::GREEN;
+constexpr uint32_t kBlue = FbColor32::BLUE;
+constexpr uint32_t kWhite = FbColor32::WHITE;
+constexpr uint32_t kBlack = FbColor32::BLACK;
+
+// Batches go through SDL's renderer, so these use the accelerated backend
+// (SDL's software renderer when headless). Two rows of eight pixels fit four
+// 2x2 quads side by side.
+class FbBatchTest : public ::testing::Test {
+ protected:
+  static void SetUpTestSuite() { fbtest::OpenHeadlessScreen({8, 2}); }
+
+  void SetUp() override {
+    red_ = Solid(FbColor32::RED);
+    green_ = Solid(FbColor32::GREEN);
+    FbGfx::Flip();
+  }
+
+  static std::unique_ptr<FbImg> Solid(FbColor32 color) {
+    std::unique_ptr<FbImg> img = FbImg::OfSize({2, 2});
+    FbGfx::Cls(*img, color);
+    return img;
+  }
+
+  std::unique_ptr<FbImg> red_;
+  std::unique_ptr<FbImg> green_;
+};
+}  // namespace
+
+TEST_F(FbBatchTest, deferred_mergesConsecutiveQuadsOnly) {
+  const uint32_t calls = DrawCalls([this] {
+    FbBatch batch;
+    batch.Begin();
+    batch.Put(*red_, {0, 0});
+    batch.Put(*red_, {2, 0});
+    batch.Put(*green_, {4, 0});
+    batch.Put(*red_, {6, 0});
+    batch.End();
+  });
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+  EXPECT_EQ(calls, 3);
+#else
+  EXPECT_EQ(calls, 4);
+#endif
+}
+
+TEST_F(FbBatchTest, sortTexture_mergesBySource) {
+  const uint32_t calls = DrawCalls([this] {
+    FbBatch batch;
+    batch.Begin(FbBatch::SORT_TEXTURE);
+    batch.Put(*red_, {0, 0});
+    batch.Put(*green_, {2, 0});
+    batch.Put(*red_, {4, 0});
+    batch.Put(*green_, {6, 0});
+    batch.End();
+  });
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+  EXPECT_EQ(calls, 2);
+#else
+  EXPECT_EQ(calls, 4);
+#endif
+}
+
+TEST_F(FbBatchTest, deferred_keepsOrderOfOverlappingQuads) {
+  FbGfx::Cls();
+  FbBatch batch;
+  batch.Begin();
+  batch.Put(*red_, {0, 0});
+  batch.Put(*green_, {1, 0});
+  batch.Put(*red_, {2, 0});
+  batch.End();
+  EXPECT_THAT(ScreenRow(0),
+              ElementsAre(kRed, kGreen, kRed, kRed, kBlack, kBlack, kBlack,
+                          kBlack));
+  FbGfx::Flip();
+}
+
+TEST_F(FbBatchTest, sortTexture_reordersBySource) {
+  FbGfx::Cls();
+  FbBatch batch;
+  batch.Begin(FbBatch::SORT_TEXTURE);
+  batch.Put(*red_, {0, 0});
+  batch.Put(*green_, {1, 0});
+  batch.Put(*red_, {2, 0});
+  batch.End();
+  // Both red quads come first, so green ends up on top.
+  EXPECT_THAT(ScreenRow(0),
+              ElementsAre(kRed, kGreen, kGreen, kRed, kBlack, kBlack, kBlack,
+                          kBlack));
+  FbGfx::Flip();
+}
+
+TEST_F(FbBatchTest, put_ordersSourceCorners) {
+  std::unique_ptr<FbImg> quad = FbImg::OfSize({2, 2});
+  FbGfx::PSet(*quad, {0, 0}, FbColor32::RED);
+  FbGfx::PSet(*quad, {1, 0}, FbColor32::GREEN);
+  FbGfx::PSet(*quad, {0, 1}, FbColor32::BLUE);
+  FbGfx::PSet(*quad, {1, 1}, FbColor32::WHITE);
+
+  // The corners can be given in any order, with each axis flipped
+  // independently of the other.
+  FbGfx::Cls();
+  FbGfx::Put(*quad, {0, 0}, {1, 0}, {0, 1});
+  FbGfx::Put(*quad, {2, 0}, {0, 1}, {1, 0});
+  FbGfx::Put(*quad, {4, 0}, {1, 1}, {0, 0});
+  FbBatch batch;
+  batch.Begin();
+  batch.Put(*quad, {6, 0}, {1, 0}, {0, 1});
+  batch.End();
+  EXPECT_THAT(ScreenRow(0),
+              ElementsAre(kRed, kGreen, kRed, kGreen, kRed, kGreen, kRed,
+                          kGreen));
+  EXPECT_THAT(ScreenRow(1),
+              ElementsAre(kBlue, kWhite, kBlue, kWhite, kBlue, kWhite, kBlue,
+                          kWhite));
+
+  // A single row, given right to left.
+  FbGfx::Cls();
+  FbGfx::Put(*quad, {0, 0}, {1, 0}, {0, 0});
+  EXPECT_THAT(ScreenRow(0),
+              ElementsAre(kRed, kGreen, kBlack, kBlack, kBlack, kBlack, kBlack,
+                          kBlack));
+  EXPECT_THAT(ScreenRow(1),
+              ElementsAre(kBlack, kBlack, kBlack, kBlack, kBlack, kBlack,
+                          kBlack, kBlack));
+  FbGfx::Flip();
+}
+
+TEST_F(FbBatchTest, put_locked_dies) {
+  // Like FbGfx::Put, a locked image can't be added to a batch (and so can't
+  // be submitted from an FbRenderQueue either).
+  std::unique_ptr<FbImg> streaming = FbImg::OfSizeStreaming({2, 2});
+  streaming->Lock();
+  FbBatch batch;
+  batch.Begin();
+  EXPECT_DEATH(batch.Put(*streaming, {0, 0}), "locked");
+  streaming->Unlock();
+  batch.Put(*streaming, {0, 0});
+  batch.End();
+}
+
+}  // namespace retro
@@ -0,0 +1,140 @@
+#include "retro/fbcapture.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "SDL.h"
+#include "absl/strings/str_cat.h"
+#include "glog/logging.h"
+#include "retro/fbgfx.h"
+#include "retro/fbsoft.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+using absl::StrCat;
+using glm::ivec2;
+using std::string;
+
+namespace retro {
+
+ivec2 FbCapture::ScreenDims() {
+  FbGfx::CheckInit("FbCapture");
+  if (FbGfx::is_software()) {
+    const fbsoft::Surface screen = FbGfx::GetSoftScreen();
+    return {screen.w, screen.h};
+  }
+  if (FbGfx::offscreen_screen_ != nullptr) return FbGfx::logical_res_;
+  ivec2 dims;
+  CHECK_EQ(SDL_GetRendererOutputSize(FbGfx::renderer_.get(), &dims.x, &dims.y),
+           0)
+      << "SDL error (SDL_GetRendererOutputSize): " << SDL_GetError();
+  return dims;
+}
+
+FbCapture::FbCapture(const string& path_prefix, const Options& options)
+    : path_prefix_(path_prefix),
+      options_(options),
+      dims_(ScreenDims()),
+      captured_(0),
+      dropped_(0),
+      readback_seconds_(0),
+      written_(0),
+      raw_file_(nullptr),
+      next_worker_(0) {
+  CHECK_GT(options.worker_count, 0) << "FbCapture needs at least one worker.";
+  if (options.format == FORMAT_RAW) {
+    const string filename = StrCat(path_prefix, ".rgba");
+    raw_file_ = fopen(filename.c_str(), "wb");
+    CHECK_NE(raw_file_, static_cast<FILE*>(nullptr))
+        << "Couldn't open " << filename << " for writing.";
+  }
+  const uint32_t worker_count =
+      options.format == FORMAT_RAW ? 1 : options.worker_count;
+  for (uint32_t i = 0; i < worker_count; ++i) {
+    workers_.push_back(
+        std::make_unique<thread::WorkQueue>(options.worker_queue_length));
+  }
+}
+
+FbCapture::~FbCapture() {
+  // Join the workers first, as they write to raw_file_.
+  workers_.clear();
+  if (raw_file_ != nullptr) fclose(raw_file_);
+}
+
+void FbCapture::Capture() {
+  const auto start = std::chrono::steady_clock::now();
+  ivec2 dims = dims_;
+  std::vector<uint32_t> pixels;
+  // Whether pixels are RGBA8888 words rather than RGBA bytes.
+  bool rgba8888 = true;
+  if (FbGfx::is_software()) {
+    const fbsoft::Surface screen = FbGfx::GetSoftScreen();
+    dims = {screen.w, screen.h};
+    pixels.resize(screen.w * screen.h);
+    for (int32_t y = 0; y < screen.h; ++y) {
+      std::copy_n(screen.row(y), screen.w, pixels.data() + y * screen.w);
+    }
+  } else if (FbGfx::offscreen_screen_ == nullptr) {
+    // Read straight from the window (sized by the viewport SDL reads).
+    pixels = FbGfx::ReadFrame(&dims);
+  } else {
+    // Read the offscreen screen as RGBA bytes, which the workers can write
+    // as they are.
+    pixels.resize(dims_.x * dims_.y);
+    FbGfx::SetRenderTarget(FbGfx::GetTexture(nullptr));
+    CHECK_EQ(SDL_RenderReadPixels(FbGfx::renderer_.get(), nullptr,
+                                  SDL_PIXELFORMAT_RGBA32, pixels.data(),
+                                  dims_.x * sizeof(uint32_t)),
+             0)
+        << "SDL error (SDL_RenderReadPixels): " << SDL_GetError();
+    rgba8888 = false;
+  }
+  readback_seconds_ +=
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+  Write(captured_++, dims, std::move(pixels), rgba8888);
+  FbGfx::frame_stats_.capture_seconds +=
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+}
+
+void FbCapture::Write(uint64_t frame, ivec2 dims,
+                      std::vector<uint32_t> pixels, bool rgba8888) {
+  // Shared so that offering the work to each worker doesn't copy the frame.
+  auto shared_pixels =
+      std::make_shared<std::vector<uint32_t>>(std::move(pixels));
+  auto write = [this, frame, dims, shared_pixels, rgba8888]() {
+    std::vector<uint32_t>& pixels = *shared_pixels;
+    // RGBA8888 words are RGBA bytes when stored big-endian.
+    if (rgba8888) {
+      for (uint32_t& pixel : pixels) pixel = SDL_SwapBE32(pixel);
+    }
+    if (options_.format == FORMAT_PNG) {
+      const string filename =
+          StrCat(path_prefix_, absl::Dec(frame, absl::kZeroPad6), ".png");
+      if (stbi_write_png(filename.c_str(), dims.x, dims.y, 4, pixels.data(),
+                         dims.x * sizeof(uint32_t)) == 0) {
+        LOG(WARNING) << "Couldn't write captured frame " << filename;
+        return;
+      }
+    } else if (fwrite(pixels.data(), sizeof(uint32_t), pixels.size(),
+                      raw_file_) != pixels.size()) {
+      LOG(WARNING) << "Couldn't write captured frame " << frame;
+      return;
+    }
+    written_.fetch_add(1, std::memory_order_relaxed);
+  };
+
+  for (uint32_t i = 0; i < workers_.size(); ++i) {
+    const uint32_t worker = (next_worker_ + i) % workers_.size();
+    if (workers_[worker]->TryAddWork(write)) {
+      next_worker_ = worker + 1;
+      return;
+    }
+  }
+  ++dropped_;
+}
+
+}  // namespace retro
@@ -0,0 +1,117 @@
+#ifndef RETRO_FBCAPTURE_H_
+#define RETRO_FBCAPTURE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "glm/vec2.hpp"
+#include "thread/workqueue.h"
+#include "util/noncopyable.h"
+
+namespace retro {
+
+// Records the frames FbGfx draws to disk, for bug reports and benchmark
+// replays:
+//
+//   FbGfx::StartCapture(std::make_unique<FbCapture>("capture/frame_"));
+//   ...
+//   FbGfx::StopCapture();
+//
+// Every Flip reads the frame back and hands it to worker threads to encode
+// and write out. If the workers fall behind, frames are dropped rather than
+// blocking the render thread.
+//
+// Reading back is synchronous: SDL_RenderReadPixels flushes the renderer's
+// queue and waits for the pixels, and SDL's renderer has no way to read back
+// without waiting. So capturing with BACKEND_ACCELERATED stalls every Flip
+// until the GPU catches up; FrameStats::capture_seconds and readback_seconds()
+// show the cost. Frames are read from the offscreen screen if there is one
+// (ScreenOptions::offscreen), otherwise from the window. With BACKEND_SOFTWARE
+// the frame is already in memory, so it's just copied.
+//
+// Like FbGfx, this can only be used from the thread that called
+// FbGfx::Screen.
+class FbCapture : public util::NonCopyable {
+ public:
+  enum Format {
+    // A PNG per frame, named path_prefix followed by the 6 digit frame
+    // number.
+    FORMAT_PNG,
+    // Every frame's RGBA bytes, rows packed, one after another in a single
+    // file named path_prefix followed by ".rgba". Much cheaper to write than
+    // PNG, but the screen size mustn't change while capturing.
+    FORMAT_RAW
+  };
+
+  struct Options {
+   public:
+    Options() : format(FORMAT_PNG), worker_count(2), worker_queue_length(8) {}
+    Format format;
+    // With FORMAT_RAW, frames are written in order by a single worker.
+    uint32_t worker_count;
+    // Frames each worker can have waiting before frames are dropped.
+    uint32_t worker_queue_length;
+
+    Options& SetFormat(Format format) {
+      this->format = format;
+      return *this;
+    }
+    Options& SetWorkerCount(uint32_t worker_count) {
+      this->worker_count = worker_count;
+      return *this;
+    }
+    Options& SetWorkerQueueLength(uint32_t worker_queue_length) {
+      this->worker_queue_length = worker_queue_length;
+      return *this;
+    }
+  };
+
+  explicit FbCapture(const std::string& path_prefix,
+                     const Options& options = Options());
+  // Blocks until frames handed to the workers are written.
+  ~FbCapture();
+
+  // Captures the screen as it is now. Called by FbGfx::Flip while capturing.
+  void Capture();
+
+  // Frames captured, including those dropped.
+  uint64_t captured() const { return captured_; }
+  // Frames dropped because the workers had fallen behind.
+  uint64_t dropped() const { return dropped_; }
+  // Frames written out so far.
+  uint64_t written() const { return written_.load(std::memory_order_relaxed); }
+  // Time the render thread has spent reading frames back, waiting on the GPU
+  // included.
+  double readback_seconds() const { return readback_seconds_; }
+
+ private:
+  // The size of whatever the screen is drawn into.
+  static glm::ivec2 ScreenDims();
+  // Hands a frame to the workers. If rgba8888, pixels are RGBA8888 words
+  // (FbColor32::value), otherwise they're already RGBA bytes.
+  void Write(uint64_t frame, glm::ivec2 dims, std::vector<uint32_t> pixels,
+             bool rgba8888);
+
+  const std::string path_prefix_;
+  const Options options_;
+  const glm::ivec2 dims_;
+
+  uint64_t captured_;
+  uint64_t dropped_;
+  double readback_seconds_;
+  std::atomic_uint64_t written_;
+
+  FILE* raw_file_;
+
+  uint32_t next_worker_;
+  // Declared last so that workers finish before the rest is destroyed.
+  std::vector<std::unique_ptr<thread::WorkQueue>> workers_;
+};
+
+}  // namespace retro
+
+#endif  // RETRO_FBCAPTURE_H_
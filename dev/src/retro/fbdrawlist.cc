@@ -0,0 +1,149 @@
+#include "retro/fbdrawlist.h"
+
+#include "glog/logging.h"
+#include "retro/fbimg.h"
+
+using absl::string_view;
+using glm::ivec2;
+
+namespace retro {
+
+FbDrawList::Command& FbDrawList::Add(CommandType type, const FbImg* target,
+                                     FbColor32 color) {
+  if (target != nullptr) target->CheckTarget("FbDrawList");
+  commands_.push_back({type, target, nullptr, {0, 0}, {0, 0}, {0, 0}, color,
+                       FbGfx::PutOptions(), FbGfx::TEXT_ALIGN_H_LEFT,
+                       FbGfx::TEXT_ALIGN_V_TOP, 0, 0});
+  return commands_.back();
+}
+
+void FbDrawList::Clear() {
+  commands_.clear();
+  text_.clear();
+}
+
+// Cls
+
+void FbDrawList::Cls(FbColor32 col) { Add(CMD_CLS, nullptr, col); }
+void FbDrawList::Cls(const FbImg& target, FbColor32 col) {
+  Add(CMD_CLS, &target, col);
+}
+
+// PSet
+
+void FbDrawList::PSet(ivec2 p, FbColor32 color) {
+  Add(CMD_PSET, nullptr, color).a = p;
+}
+void FbDrawList::PSet(const FbImg& target, ivec2 p, FbColor32 color) {
+  Add(CMD_PSET, &target, color).a = p;
+}
+
+// Line
+
+void FbDrawList::Line(ivec2 a, ivec2 b, FbColor32 color) {
+  Command& command = Add(CMD_LINE, nullptr, color);
+  command.a = a;
+  command.b = b;
+}
+void FbDrawList::Line(const FbImg& target, ivec2 a, ivec2 b, FbColor32 color) {
+  Command& command = Add(CMD_LINE, &target, color);
+  command.a = a;
+  command.b = b;
+}
+
+// Rect
+
+void FbDrawList::Rect(ivec2 a, ivec2 b, FbColor32 color) {
+  Command& command = Add(CMD_RECT, nullptr, color);
+  command.a = a;
+  command.b = b;
+}
+void FbDrawList::Rect(const FbImg& target, ivec2 a, ivec2 b, FbColor32 color) {
+  Command& command = Add(CMD_RECT, &target, color);
+  command.a = a;
+  command.b = b;
+}
+
+// FillRect
+
+void FbDrawList::FillRect(ivec2 a, ivec2 b, FbColor32 color) {
+  Command& command = Add(CMD_FILL_RECT, nullptr, color);
+  command.a = a;
+  command.b = b;
+}
+void FbDrawList::FillRect(const FbImg& target, ivec2 a, ivec2 b,
+                          FbColor32 color) {
+  Command& command = Add(CMD_FILL_RECT, &target, color);
+  command.a = a;
+  command.b = b;
+}
+
+// TextLine & TextParagraph
+
+void FbDrawList::AddText(CommandType type, const FbImg* target,
+                         string_view text, ivec2 a, ivec2 b, FbColor32 color,
+                         FbGfx::TextHAlign h_align,
+                         FbGfx::TextVAlign v_align) {
+  Command& command = Add(type, target, color);
+  command.a = a;
+  command.b = b;
+  command.h_align = h_align;
+  command.v_align = v_align;
+  command.text_offset = static_cast<uint32_t>(text_.size());
+  command.text_size = static_cast<uint32_t>(text.size());
+  text_.append(text.data(), text.size());
+}
+
+void FbDrawList::TextLine(string_view text, ivec2 p, FbColor32 color,
+                          FbGfx::TextHAlign h_align,
+                          FbGfx::TextVAlign v_align) {
+  AddText(CMD_TEXT_LINE, nullptr, text, p, {0, 0}, color, h_align, v_align);
+}
+void FbDrawList::TextLine(const FbImg& target, string_view text, ivec2 p,
+                          FbColor32 color, FbGfx::TextHAlign h_align,
+                          FbGfx::TextVAlign v_align) {
+  AddText(CMD_TEXT_LINE, &target, text, p, {0, 0}, color, h_align, v_align);
+}
+
+void FbDrawList::TextParagraph(string_view text, ivec2 a, ivec2 b,
+                               FbColor32 color, FbGfx::TextHAlign h_align,
+                               FbGfx::TextVAlign v_align) {
+  AddText(CMD_TEXT_PARAGRAPH, nullptr, text, a, b, color, h_align, v_align);
+}
+void FbDrawList::TextParagraph(const FbImg& target, string_view text, ivec2 a,
+                               ivec2 b, FbColor32 color,
+                               FbGfx::TextHAlign h_align,
+                               FbGfx::TextVAlign v_align) {
+  AddText(CMD_TEXT_PARAGRAPH, &target, text, a, b, color, h_align, v_align);
+}
+
+// Put & PutEx
+
+void FbDrawList::AddPut(const FbImg* target, const FbImg& src, ivec2 p,
+                        FbGfx::PutOptions opts, ivec2 src_a, ivec2 src_b) {
+  Command& command = Add(CMD_PUT, target, FbColor32::WHITE);
+  command.src = &src;
+  command.a = p;
+  command.b = src_a;
+  command.c = src_b;
+  command.opts = opts;
+}
+
+void FbDrawList::Put(const FbImg& src, ivec2 p, ivec2 src_a, ivec2 src_b) {
+  AddPut(nullptr, src, p, FbGfx::PutOptions(), src_a, src_b);
+}
+void FbDrawList::Put(const FbImg& target, const FbImg& src, ivec2 p,
+                     ivec2 src_a, ivec2 src_b) {
+  AddPut(&target, src, p, FbGfx::PutOptions(), src_a, src_b);
+}
+
+void FbDrawList::PutEx(const FbImg& src, ivec2 p, FbGfx::PutOptions opts,
+                       ivec2 src_a, ivec2 src_b) {
+  AddPut(nullptr, src, p, opts, src_a, src_b);
+}
+void FbDrawList::PutEx(const FbImg& target, const FbImg& src, ivec2 p,
+                       FbGfx::PutOptions opts, ivec2 src_a, ivec2 src_b) {
+  AddPut(&target, src, p, opts, src_a, src_b);
+}
+
+}  // namespace retro
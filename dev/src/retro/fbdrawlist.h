@@ -0,0 +1,134 @@
+#ifndef RETRO_FBDRAWLIST_H_
+#define RETRO_FBDRAWLIST_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "glm/vec2.hpp"
+#include "retro/fbcore.h"
+#include "retro/fbgfx.h"
+#include "util/noncopyable.h"
+
+namespace retro {
+
+class FbImg;
+// A recording of FbGfx drawing commands that can be replayed later. Unlike
+// FbGfx, recording into a FbDrawList doesn't touch the renderer, so lists can
+// be built on any thread (one thread per list at a time) and then handed to
+// FbGfx::QueueDrawList or FbGfx::ReplayDrawList.
+//
+// Images referenced by recorded commands must outlive the replay of the list.
+// The recording methods mirror their FbGfx counterparts.
+class FbDrawList : public util::NonCopyable {
+  friend class FbGfx;
+  friend class FbDrawListTest;
+
+ public:
+  FbDrawList() {}
+
+  void Cls(FbColor32 col = FbColor32::BLACK);
+  void Cls(const FbImg& target, FbColor32 col = FbColor32::BLACK);
+
+  void PSet(glm::ivec2 p, FbColor32 color = FbColor32::WHITE);
+  void PSet(const FbImg& target, glm::ivec2 p,
+            FbColor32 color = FbColor32::WHITE);
+
+  void Line(glm::ivec2 a, glm::ivec2 b, FbColor32 color = FbColor32::WHITE);
+  void Line(const FbImg& target, glm::ivec2 a, glm::ivec2 b,
+            FbColor32 color = FbColor32::WHITE);
+
+  void Rect(glm::ivec2 a, glm::ivec2 b, FbColor32 color = FbColor32::WHITE);
+  void Rect(const FbImg& target, glm::ivec2 a, glm::ivec2 b,
+            FbColor32 color = FbColor32::WHITE);
+
+  void FillRect(glm::ivec2 a, glm::ivec2 b,
+                FbColor32 color = FbColor32::WHITE);
+  void FillRect(const FbImg& target, glm::ivec2 a, glm::ivec2 b,
+                FbColor32 color = FbColor32::WHITE);
+
+  void TextLine(absl::string_view text, glm::ivec2 p,
+                FbColor32 color = FbColor32::WHITE,
+                FbGfx::TextHAlign h_align = FbGfx::TEXT_ALIGN_H_LEFT,
+                FbGfx::TextVAlign v_align = FbGfx::TEXT_ALIGN_V_TOP);
+  void TextLine(const FbImg& target, absl::string_view text, glm::ivec2 p,
+                FbColor32 color = FbColor32::WHITE,
+                FbGfx::TextHAlign h_align = FbGfx::TEXT_ALIGN_H_LEFT,
+                FbGfx::TextVAlign v_align = FbGfx::TEXT_ALIGN_V_TOP);
+
+  void TextParagraph(absl::string_view text, glm::ivec2 a, glm::ivec2 b,
+                     FbColor32 color = FbColor32::WHITE,
+                     FbGfx::TextHAlign h_align = FbGfx::TEXT_ALIGN_H_LEFT,
+                     FbGfx::TextVAlign v_align = FbGfx::TEXT_ALIGN_V_TOP);
+  void TextParagraph(const FbImg& target, absl::string_view text, glm::ivec2 a,
+                     glm::ivec2 b, FbColor32 color = FbColor32::WHITE,
+                     FbGfx::TextHAlign h_align = FbGfx::TEXT_ALIGN_H_LEFT,
+                     FbGfx::TextVAlign v_align = FbGfx::TEXT_ALIGN_V_TOP);
+
+  void Put(const FbImg& src, glm::ivec2 p, glm::ivec2 src_a = {-1, -1},
+           glm::ivec2 src_b = {-1, -1});
+  void Put(const FbImg& target, const FbImg& src, glm::ivec2 p,
+           glm::ivec2 src_a = {-1, -1}, glm::ivec2 src_b = {-1, -1});
+
+  void PutEx(const FbImg& src, glm::ivec2 p, FbGfx::PutOptions opts,
+             glm::ivec2 src_a = {-1, -1}, glm::ivec2 src_b = {-1, -1});
+  void PutEx(const FbImg& target, const FbImg& src, glm::ivec2 p,
+             FbGfx::PutOptions opts, glm::ivec2 src_a = {-1, -1},
+             glm::ivec2 src_b = {-1, -1});
+
+  // Remove all recorded commands, keeping the allocated storage.
+  void Clear();
+
+  size_t size() const { return commands_.size(); }
+  bool empty() const { return commands_.empty(); }
+
+ private:
+  enum CommandType {
+    CMD_CLS,
+    CMD_PSET,
+    CMD_LINE,
+    CMD_RECT,
+    CMD_FILL_RECT,
+    CMD_TEXT_LINE,
+    CMD_TEXT_PARAGRAPH,
+    CMD_PUT
+  };
+
+  // A single recorded command. Which fields are meaningful depends on type;
+  // a and b hold the points (or p and src_a/src_b for puts), and text lives in
+  // text_ at [text_offset, text_offset + text_size).
+  struct Command {
+    CommandType type;
+    const FbImg* target;
+    const FbImg* src;
+    glm::ivec2 a;
+    glm::ivec2 b;
+    glm::ivec2 c;
+    FbColor32 color;
+    FbGfx::PutOptions opts;
+    FbGfx::TextHAlign h_align;
+    FbGfx::TextVAlign v_align;
+    uint32_t text_offset;
+    uint32_t text_size;
+  };
+
+  Command& Add(CommandType type, const FbImg* target, FbColor32 color);
+  void AddText(CommandType type, const FbImg* target, absl::string_view text,
+               glm::ivec2 a, glm::ivec2 b, FbColor32 color,
+               FbGfx::TextHAlign h_align, FbGfx::TextVAlign v_align);
+  void AddPut(const FbImg* target, const FbImg& src, glm::ivec2 p,
+              FbGfx::PutOptions opts, glm::ivec2 src_a, glm::ivec2 src_b);
+
+  absl::string_view GetText(const Command& command) const {
+    return absl::string_view(text_).substr(command.text_offset,
+                                           command.text_size);
+  }
+
+  std::vector<Command> commands_;
+  std::string text_;
+};
+
+}  // namespace retro
+
+#endif  // RETRO_FBDRAWLIST_H_
@@ -0,0 +1,167 @@
+#include "retro/fbdrawlist.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "glm/vec2.hpp"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "retro/fbcore.h"
+#include "retro/fbgfx.h"
+#include "retro/fbimg.h"
+#include "retro/fbtestscreen.h"
+
+namespace retro {
+using glm::ivec2;
+using ::testing::ElementsAre;
+
+namespace {
+constexpr uint32_t kRed = FbColor32::RED;
+constexpr uint32_t kGreen = FbColor32::GREEN;
+constexpr uint32_t kBlue = FbColor32::BLUE;
+constexpr uint32_t kWhite = FbColor32::WHITE;
+}  // namespace
+
+// A friend of FbDrawList so that tests can inspect recorded commands. Replay
+// tests draw to a one row screen on the software backend, whose frame can
+// still be read after Flip (which is when queued lists are replayed).
+class FbDrawListTest : public ::testing::Test {
+ protected:
+  static void SetUpTestSuite() {
+    fbtest::OpenHeadlessScreen({4, 1}, FbGfx::BACKEND_SOFTWARE);
+  }
+
+  static size_t CommandCount(const FbDrawList& list) {
+    return list.commands_.size();
+  }
+  static FbDrawList::CommandType Type(const FbDrawList& list, size_t i) {
+    return list.commands_[i].type;
+  }
+  static const FbImg* Target(const FbDrawList& list, size_t i) {
+    return list.commands_[i].target;
+  }
+  static const FbImg* Src(const FbDrawList& list, size_t i) {
+    return list.commands_[i].src;
+  }
+  static ivec2 A(const FbDrawList& list, size_t i) {
+    return list.commands_[i].a;
+  }
+  static ivec2 B(const FbDrawList& list, size_t i) {
+    return list.commands_[i].b;
+  }
+  static ivec2 C(const FbDrawList& list, size_t i) {
+    return list.commands_[i].c;
+  }
+  static uint32_t Color(const FbDrawList& list, size_t i) {
+    return list.commands_[i].color;
+  }
+  static const FbGfx::PutOptions& Opts(const FbDrawList& list, size_t i) {
+    return list.commands_[i].opts;
+  }
+  static FbGfx::TextHAlign HAlign(const FbDrawList& list, size_t i) {
+    return list.commands_[i].h_align;
+  }
+  static absl::string_view Text(const FbDrawList& list, size_t i) {
+    return list.GetText(list.commands_[i]);
+  }
+
+  static constexpr FbDrawList::CommandType CMD_CLS = FbDrawList::CMD_CLS;
+  static constexpr FbDrawList::CommandType CMD_LINE = FbDrawList::CMD_LINE;
+  static constexpr FbDrawList::CommandType CMD_TEXT_PARAGRAPH =
+      FbDrawList::CMD_TEXT_PARAGRAPH;
+  static constexpr FbDrawList::CommandType CMD_PUT = FbDrawList::CMD_PUT;
+};
+
+TEST_F(FbDrawListTest, recordsCommands) {
+  std::unique_ptr<FbImg> target = FbImg::OfSize({4, 4});
+  std::unique_ptr<FbImg> src = FbImg::OfSize({2, 2});
+
+  FbDrawList list;
+  list.Cls(FbColor32::BLUE);
+  list.Line(*target, {1, 2}, {3, 4}, FbColor32::RED);
+  list.TextParagraph("hello", {0, 0}, {31, 7}, FbColor32::GREEN,
+                     FbGfx::TEXT_ALIGN_H_RIGHT);
+  list.PutEx(*target, *src, {5, 6},
+             FbGfx::PutOptions()
+                 .SetBlend(FbGfx::PutOptions::BLEND_ADD)
+                 .SetMod(FbColor32::YELLOW),
+             {0, 0}, {1, 1});
+  ASSERT_EQ(list.size(), 4);
+  ASSERT_EQ(CommandCount(list), 4);
+
+  EXPECT_EQ(Type(list, 0), CMD_CLS);
+  EXPECT_EQ(Target(list, 0), nullptr);
+  EXPECT_EQ(Color(list, 0), kBlue);
+
+  EXPECT_EQ(Type(list, 1), CMD_LINE);
+  EXPECT_EQ(Target(list, 1), target.get());
+  EXPECT_EQ(A(list, 1), ivec2(1, 2));
+  EXPECT_EQ(B(list, 1), ivec2(3, 4));
+  EXPECT_EQ(Color(list, 1), kRed);
+
+  EXPECT_EQ(Type(list, 2), CMD_TEXT_PARAGRAPH);
+  EXPECT_EQ(Text(list, 2), "hello");
+  EXPECT_EQ(B(list, 2), ivec2(31, 7));
+  EXPECT_EQ(Color(list, 2), kGreen);
+  EXPECT_EQ(HAlign(list, 2), FbGfx::TEXT_ALIGN_H_RIGHT);
+
+  EXPECT_EQ(Type(list, 3), CMD_PUT);
+  EXPECT_EQ(Target(list, 3), target.get());
+  EXPECT_EQ(Src(list, 3), src.get());
+  EXPECT_EQ(A(list, 3), ivec2(5, 6));
+  EXPECT_EQ(B(list, 3), ivec2(0, 0));
+  EXPECT_EQ(C(list, 3), ivec2(1, 1));
+  EXPECT_EQ(Opts(list, 3).blend, FbGfx::PutOptions::BLEND_ADD);
+  EXPECT_EQ(static_cast<uint32_t>(Opts(list, 3).mod), FbColor32::YELLOW);
+
+  list.Clear();
+  EXPECT_TRUE(list.empty());
+}
+
+TEST_F(FbDrawListTest, textSurvivesArenaGrowth) {
+  FbDrawList list;
+  std::vector<std::string> texts;
+  for (int i = 0; i < 1000; ++i) {
+    texts.push_back(absl::StrCat("line ", i, std::string(i % 37, '.')));
+    list.TextLine(texts.back(), {0, i});
+  }
+  ASSERT_EQ(list.size(), texts.size());
+  for (size_t i = 0; i < texts.size(); ++i) {
+    ASSERT_EQ(Text(list, i), texts[i]) << "Command " << i;
+  }
+}
+
+TEST_F(FbDrawListTest, replayMatchesDrawingDirectly) {
+  FbDrawList list;
+  list.Cls(FbColor32::BLUE);
+  list.PSet({1, 0}, FbColor32::RED);
+  list.Line({2, 0}, {3, 0}, FbColor32::GREEN);
+
+  FbGfx::Cls();
+  FbGfx::ReplayDrawList(list);
+  EXPECT_THAT(fbtest::ScreenRow(0), ElementsAre(kBlue, kRed, kGreen, kGreen));
+  FbGfx::Flip();
+}
+
+TEST_F(FbDrawListTest, queuedListsReplayByOrderThenSequence) {
+  // The list replayed i-th covers pixels i and up, so each pixel ends up
+  // showing which list was replayed in its position.
+  FbDrawList lists[4];
+  const uint32_t colors[] = {kRed, kGreen, kBlue, kWhite};
+  for (int32_t i = 0; i < 4; ++i) {
+    lists[i].FillRect({i, 0}, {3, 0}, colors[i]);
+  }
+
+  FbGfx::Cls();
+  FbGfx::QueueDrawList(lists[2], 1);
+  FbGfx::QueueDrawList(lists[0], -1);
+  FbGfx::QueueDrawList(lists[3], 1);
+  FbGfx::QueueDrawList(lists[1]);
+  FbGfx::Flip();
+  EXPECT_THAT(fbtest::ScreenRow(0), ElementsAre(kRed, kGreen, kBlue, kWhite));
+}
+
+}  // namespace retro
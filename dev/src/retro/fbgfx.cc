@@ -1,7 +1,25 @@
 #include "retro/fbgfx.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iterator>
+#include <string_view>
+
+#include "absl/strings/str_cat.h"
+#include "glm/common.hpp"
+#include "retro/fbatlas.h"
+#include "retro/fbcapture.h"
+#include "retro/fbdrawlist.h"
 #include "retro/fbimg.h"
+#include "retro/fbimgcache.h"
+#include "retro/fbimgloader.h"
+#include "retro/fbsoft.h"
+#include "retro/fbtargetpool.h"
+#include "retro/fbtextlayout.h"
 
+using absl::StrCat;
 using absl::string_view;
 using glm::ivec2;
 using glm::ivec3;
@@ -11,15 +29,68 @@ using util::deleter_ptr;
 
 namespace retro {
 namespace {
-const ivec2 kTextCharacterDims{8, 8};
+// Calls draw(begin, end) for each run of consecutive primitives with the same
+// color and for which joins(previous, next) holds.
+template <typename Prim, typename Joins, typename Draw>
+void ForEachRun(absl::Span<const Prim> prims, Joins joins, Draw draw) {
+  size_t begin = 0;
+  for (size_t i = 1; i <= prims.size(); ++i) {
+    if ((i < prims.size()) &&
+        (prims[i].color.value == prims[i - 1].color.value) &&
+        joins(prims[i - 1], prims[i])) {
+      continue;
+    }
+    draw(begin, i);
+    begin = i;
+  }
+}
 }  // namespace
 
 // Gfx variables
 
 FbGfx::Cleanup FbGfx::cleanup_;
+// Defined ahead of the images FbGfx owns, which untrack themselves from it
+// when destroyed.
+std::list<const FbImg*> FbGfx::texture_lru_;
+size_t FbGfx::texture_bytes_ = 0;
+size_t FbGfx::texture_budget_ = 0;
+FbGfx::TextureMemoryStats FbGfx::texture_stats_;
+uint64_t FbGfx::frame_count_ = 0;
 deleter_ptr<SDL_Window> FbGfx::window_ = nullptr;
 deleter_ptr<SDL_Renderer> FbGfx::renderer_ = nullptr;
+unique_ptr<FbAtlas> FbGfx::atlas_ = nullptr;
+unique_ptr<FbImgLoader> FbGfx::loader_ = nullptr;
+unique_ptr<FbTargetPool> FbGfx::target_pool_ = nullptr;
+unique_ptr<FbImgCache> FbGfx::image_cache_ = nullptr;
+unique_ptr<FbCapture> FbGfx::capture_ = nullptr;
 unique_ptr<FbImg> FbGfx::basic_font_ = nullptr;
+util::LruCache<size_t, FbGfx::CachedText> FbGfx::text_cache_(
+    FbGfx::kDefaultTextCacheCapacity);
+
+FbGfx::Backend FbGfx::backend_ = FbGfx::BACKEND_ACCELERATED;
+bool FbGfx::headless_ = false;
+unique_ptr<FbImg> FbGfx::soft_screen_ = nullptr;
+deleter_ptr<SDL_Texture> FbGfx::soft_present_texture_ = nullptr;
+bool FbGfx::offscreen_ = false;
+FbGfx::ScreenOptions::PresentScale FbGfx::present_scale_ =
+    FbGfx::ScreenOptions::PRESENT_SCALE_INTEGER;
+ivec2 FbGfx::logical_res_(0, 0);
+const ivec2 FbGfx::kTextCharacterDims{8, 8};
+unique_ptr<FbImg> FbGfx::offscreen_screen_ = nullptr;
+SDL_Rect FbGfx::present_rect_{0, 0, 0, 0};
+FbViewport FbGfx::viewport_({0, 0}, {0, 0}, {0, 0});
+bool FbGfx::viewport_set_ = false;
+
+FbGfx::FrameStats FbGfx::frame_stats_;
+FbGfx::FrameStats FbGfx::last_frame_stats_;
+std::chrono::steady_clock::time_point FbGfx::frame_start_;
+bool FbGfx::stats_overlay_ = false;
+
+std::vector<SDL_Point> FbGfx::point_scratch_;
+std::vector<SDL_Rect> FbGfx::rect_scratch_;
+
+std::mutex FbGfx::draw_list_queue_mutex_;
+std::vector<FbGfx::QueuedDrawList> FbGfx::draw_list_queue_;
 
 // Input variables
 
@@ -28,12 +99,28 @@ uint32_t FbGfx::input_cycle_ = 0;
 FbGfx::MouseButtonPressedState FbGfx::mouse_button_state_{false, false, false};
 ivec3 FbGfx::mouse_pointer_position_{0, 0, 0};
 bool FbGfx::close_pressed_ = false;
+FbGfx::MouseButtonPressedState FbGfx::pending_mouse_button_state_{false, false,
+                                                                  false};
+bool FbGfx::pending_close_pressed_ = false;
+
+util::RingBuffer<FbGfx::InputEvent> FbGfx::input_queue_(
+    FbGfx::kInputQueueCapacity);
+std::chrono::steady_clock::time_point FbGfx::oldest_polled_input_;
+bool FbGfx::polled_input_ = false;
 
 void FbGfx::Screen(ivec2 res, bool fullscreen, const string& title,
-                   ivec2 physical_res) {
+                   ivec2 physical_res, ScreenOptions opts) {
   CHECK(!is_init()) << "Cannot initialize FbGfx more than once.";
+  backend_ = opts.backend;
+  headless_ = opts.headless;
+  offscreen_ = opts.offscreen;
+  present_scale_ = opts.present_scale;
+  logical_res_ = res;
+  viewport_ = FbViewport({0, 0}, {0, 0}, res);
+  viewport_set_ = false;
 
   sdl_util::Cleanup::RegisterModule();
+  if (headless_) SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
   SDL_Init(SDL_INIT_VIDEO);
 
   if ((physical_res.x == -1) || (physical_res.y == -1)) physical_res = res;
@@ -48,46 +135,364 @@ void FbGfx::Screen(ivec2 res, bool fullscreen, const string& title,
   CHECK_NE(window_.get(), static_cast<SDL_Window*>(nullptr))
       << "SDL error (SDL_CreateWindow): " << SDL_GetError();
   renderer_ = deleter_ptr<SDL_Renderer>(
-      SDL_CreateRenderer(window_.get(), -1,
-                         SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC |
-                             SDL_RENDERER_TARGETTEXTURE),
+      SDL_CreateRenderer(
+          window_.get(), -1,
+          (headless_ ? SDL_RENDERER_SOFTWARE
+                     : SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC) |
+              (is_software() ? 0 : SDL_RENDERER_TARGETTEXTURE)),
       [](SDL_Renderer* r) { SDL_DestroyRenderer(r); });
 
   CHECK_NE(renderer_.get(), static_cast<SDL_Renderer*>(nullptr))
       << "SDL error (SDL_CreateRenderer): " << SDL_GetError();
 
-  CHECK_EQ(SDL_RenderSetLogicalSize(renderer_.get(), res.x, res.y), 0)
-      << "SDL error (SDL_RenderSetLogicalSize): " << SDL_GetError();
+  if (!offscreen_) {
+    CHECK_EQ(SDL_RenderSetLogicalSize(renderer_.get(), res.x, res.y), 0)
+        << "SDL error (SDL_RenderSetLogicalSize): " << SDL_GetError();
+  }
 
   CHECK_EQ(SDL_SetRenderDrawBlendMode(renderer_.get(), SDL_BLENDMODE_BLEND), 0)
       << "SDL error (SDL_SetRenderDrawBlendMode): " << SDL_GetError();
 
+  if (is_software()) {
+    soft_screen_ = FbImg::OfSize(res);
+    soft_present_texture_ = deleter_ptr<SDL_Texture>(
+        SDL_CreateTexture(renderer_.get(), SDL_PIXELFORMAT_RGBA8888,
+                          SDL_TEXTUREACCESS_STREAMING, res.x, res.y),
+        [](SDL_Texture* t) { SDL_DestroyTexture(t); });
+    CHECK_NE(soft_present_texture_.get(), static_cast<SDL_Texture*>(nullptr))
+        << "SDL error (SDL_CreateTexture): " << SDL_GetError();
+  } else if (offscreen_) {
+    offscreen_screen_ = FbImg::OfSize(res);
+  }
+  if (offscreen_) {
+    SDL_Texture* screen = is_software() ? soft_present_texture_.get()
+                                        : offscreen_screen_->texture_.get();
+    CHECK_EQ(SDL_SetTextureScaleMode(screen, opts.nearest_filtering
+                                                 ? SDL_ScaleModeNearest
+                                                 : SDL_ScaleModeLinear),
+             0)
+        << "SDL error (SDL_SetTextureScaleMode): " << SDL_GetError();
+    UpdatePresentRect();
+  }
+
+  if (!opts.image_cache_dir.empty()) {
+    image_cache_ = std::make_unique<FbImgCache>(opts.image_cache_dir);
+  }
+  atlas_ = std::make_unique<FbAtlas>();
+  loader_ = std::make_unique<FbImgLoader>(atlas_.get());
+  target_pool_ = std::make_unique<FbTargetPool>();
+
   // Load the system font
   PrepareFont();
 
   // Reveal our window
-  SDL_ShowWindow(window_.get());
+  if (!headless_) SDL_ShowWindow(window_.get());
+
+  frame_stats_ = FrameStats();
+  frame_start_ = std::chrono::steady_clock::now();
+}
+
+FbGfx::Backend FbGfx::GetBackend() {
+  CheckInit(__func__);
+  return backend_;
+}
+
+bool FbGfx::IsHeadless() {
+  CheckInit(__func__);
+  return headless_;
+}
+
+std::vector<uint32_t> FbGfx::ReadFrame(ivec2* dims) {
+  CheckInit(__func__);
+  if (is_software()) {
+    const fbsoft::Surface screen = GetSoftScreen();
+    std::vector<uint32_t> pixels(screen.w * screen.h);
+    for (int32_t y = 0; y < screen.h; ++y) {
+      std::copy_n(screen.row(y), screen.w, pixels.data() + y * screen.w);
+    }
+    if (dims != nullptr) *dims = {screen.w, screen.h};
+    return pixels;
+  }
+
+  ivec2 size = logical_res_;
+  if (!offscreen_) {
+    // With no rect SDL reads the viewport, which the logical size letterboxes
+    // within the output. The viewport comes back in logical pixels, so scale
+    // it back up to the output pixels actually read.
+    SDL_Rect viewport;
+    SDL_RenderGetViewport(renderer_.get(), &viewport);
+    glm::vec2 scale;
+    SDL_RenderGetScale(renderer_.get(), &scale.x, &scale.y);
+    size = {std::lround(viewport.w * scale.x),
+            std::lround(viewport.h * scale.y)};
+  }
+  std::vector<uint32_t> pixels(size.x * size.y);
+  SetRenderTarget(GetTexture(nullptr));
+  CHECK_EQ(SDL_RenderReadPixels(renderer_.get(), nullptr,
+                                SDL_PIXELFORMAT_RGBA8888, pixels.data(),
+                                size.x * sizeof(uint32_t)),
+           0)
+      << "SDL error (SDL_RenderReadPixels): " << SDL_GetError();
+  if (dims != nullptr) *dims = size;
+  return pixels;
+}
+
+fbsoft::Surface FbGfx::GetSoftSurface(const FbImg* target) {
+  if (target == nullptr) {
+    fbsoft::Surface surface = GetSoftScreen();
+    surface.pixels = surface.row(viewport_.clip_p().y) + viewport_.clip_p().x;
+    surface.w = viewport_.clip_dims().x;
+    surface.h = viewport_.clip_dims().y;
+    return surface;
+  }
+  fbsoft::Surface surface = target->root().buffer_->surface();
+  surface.pixels = surface.row(target->origin_.y) + target->origin_.x;
+  surface.w = target->width();
+  surface.h = target->height();
+  return surface;
+}
+
+fbsoft::Surface FbGfx::GetSoftScreen() {
+  return soft_screen_->root().buffer_->surface();
+}
+
+void FbGfx::PresentScreen(SDL_Texture* screen) {
+  SetRenderTarget(nullptr);
+  if (!offscreen_) {
+    CHECK_EQ(SDL_RenderCopy(renderer_.get(), screen, nullptr, nullptr), 0)
+        << "SDL error (SDL_RenderCopy): " << SDL_GetError();
+    return;
+  }
+  // The window may have changed size (going fullscreen, say).
+  UpdatePresentRect();
+  SetRenderColor(FbColor32::BLACK);
+  CHECK_EQ(SDL_RenderClear(renderer_.get()), 0)
+      << "SDL error (SDL_RenderClear): " << SDL_GetError();
+  CHECK_EQ(SDL_RenderCopy(renderer_.get(), screen, nullptr, &present_rect_), 0)
+      << "SDL error (SDL_RenderCopy): " << SDL_GetError();
+}
+
+void FbGfx::UpdatePresentRect() {
+  ivec2 output;
+  CHECK_EQ(SDL_GetRendererOutputSize(renderer_.get(), &output.x, &output.y), 0)
+      << "SDL error (SDL_GetRendererOutputSize): " << SDL_GetError();
+  ivec2 size;
+  const int32_t integer_scale =
+      std::min(output.x / logical_res_.x, output.y / logical_res_.y);
+  if ((present_scale_ == ScreenOptions::PRESENT_SCALE_INTEGER) &&
+      (integer_scale > 0)) {
+    size = logical_res_ * integer_scale;
+  } else if (output.x * logical_res_.y <= output.y * logical_res_.x) {
+    // Limited by width.
+    size = {output.x, output.x * logical_res_.y / logical_res_.x};
+  } else {
+    size = {output.y * logical_res_.x / logical_res_.y, output.y};
+  }
+  present_rect_ = {(output.x - size.x) / 2, (output.y - size.y) / 2, size.x,
+                   size.y};
+}
+
+ivec2 FbGfx::ToLogical(int32_t x, int32_t y) {
+  // Without offscreen rendering, SDL_RenderSetLogicalSize makes SDL do this.
+  if (!offscreen_) return {x, y};
+  return {static_cast<int32_t>(
+              std::floor(static_cast<double>(x - present_rect_.x) *
+                         logical_res_.x / present_rect_.w)),
+          static_cast<int32_t>(
+              std::floor(static_cast<double>(y - present_rect_.y) *
+                         logical_res_.y / present_rect_.h))};
+}
+
+SDL_Texture* FbGfx::GetTexture(const FbImg* target) {
+  if (target == nullptr) {
+    if (offscreen_screen_ == nullptr) return nullptr;
+    target = offscreen_screen_.get();
+  }
+  const FbImg& img = target->root();
+  if (img.texture_ == nullptr) {
+    const auto start = std::chrono::steady_clock::now();
+    img.ReloadTexture();
+    frame_stats_.reload_seconds +=
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+            .count();
+    ++frame_stats_.reloads;
+    texture_bytes_ += img.texture_bytes();
+    ++texture_stats_.reloads;
+  }
+  if (img.last_used_frame_ != frame_count_) {
+    img.last_used_frame_ = frame_count_;
+    texture_lru_.splice(texture_lru_.end(), texture_lru_, img.lru_entry_);
+  }
+  return img.texture_.get();
+}
+
+// Texture budget
+
+void FbGfx::SetTextureBudget(size_t bytes) { texture_budget_ = bytes; }
+
+size_t FbGfx::GetTextureBudget() { return texture_budget_; }
+
+FbGfx::TextureMemoryStats FbGfx::GetTextureMemoryStats() {
+  TextureMemoryStats stats = texture_stats_;
+  stats.resident_bytes = texture_bytes_;
+  return stats;
+}
+
+void FbGfx::TrackTexture(const FbImg* img) {
+  img->lru_entry_ = texture_lru_.insert(texture_lru_.end(), img);
+  img->last_used_frame_ = frame_count_;
+  texture_bytes_ += img->texture_bytes();
+}
+
+void FbGfx::UntrackTexture(const FbImg* img) {
+  texture_lru_.erase(img->lru_entry_);
+  if (img->texture_ != nullptr) texture_bytes_ -= img->texture_bytes();
+}
+
+void FbGfx::EnforceTextureBudget() {
+  if (texture_budget_ == 0) return;
+  for (auto i = texture_lru_.begin();
+       (texture_bytes_ > texture_budget_) && (i != texture_lru_.end()); ++i) {
+    const FbImg* img = *i;
+    // The list is in order of use, so everything from here on was drawn in
+    // the frame just finished.
+    if (img->last_used_frame_ == frame_count_) break;
+    if ((img->texture_ == nullptr) || !img->is_reloadable()) continue;
+    img->DropTexture();
+    texture_bytes_ -= img->texture_bytes();
+    ++texture_stats_.drops;
+  }
 }
 
 void FbGfx::PrepareFont() {
-  basic_font_ = FbImg::FromFile(kSystemFontPath);
-  SDL_Texture* font_tex = basic_font_.get()->texture_.get();
-  CHECK_EQ(SDL_SetTextureBlendMode(font_tex, SDL_BLENDMODE_BLEND), 0)
-      << "SDL error (SDL_SetTextureBlendMode): " << SDL_GetError();
-  CHECK_EQ(SDL_SetTextureAlphaMod(font_tex, 255), 0)
-      << "SDL error (SDL_SetTextureAlphaMod): " << SDL_GetError();
+  // The font lives in the shared atlas so that text batches with sprites and
+  // tiles on the same page.
+  basic_font_ = atlas_->FromFile(kSystemFontPath);
+}
+
+FbAtlas& FbGfx::GetAtlas() {
+  CheckInit(__func__);
+  return *atlas_;
+}
+
+FbImgLoader& FbGfx::GetLoader() {
+  CheckInit(__func__);
+  return *loader_;
+}
+
+FbTargetPool& FbGfx::GetTargetPool() {
+  CheckInit(__func__);
+  return *target_pool_;
 }
 
 void FbGfx::SetRenderTarget(SDL_Texture* target) {
+  if (SDL_GetRenderTarget(renderer_.get()) == target) return;
   CHECK_EQ(SDL_SetRenderTarget(renderer_.get(), target), 0)
       << "SDL error (SDL_SetRenderTarget): " << SDL_GetError();
+  ++frame_stats_.target_changes;
+  const SDL_Texture* screen = offscreen_screen_ == nullptr
+                                  ? nullptr
+                                  : offscreen_screen_->texture_.get();
+  if (viewport_set_ && (target == screen)) ApplyViewportClip();
 }
 
 void FbGfx::SetRenderColor(FbColor32 col) {
+  Uint8 r, g, b, a;
+  SDL_GetRenderDrawColor(renderer_.get(), &r, &g, &b, &a);
+  if ((r == col.channel.r) && (g == col.channel.g) && (b == col.channel.b) &&
+      (a == col.channel.a)) {
+    return;
+  }
   CHECK_EQ(SDL_SetRenderDrawColor(renderer_.get(), col.channel.r, col.channel.g,
                                   col.channel.b, col.channel.a),
            0)
       << "SDL error (SDL_SetRenderDrawColor): " << SDL_GetError();
+  ++frame_stats_.color_changes;
+}
+
+void FbGfx::SetTextureBlendMode(SDL_Texture* texture, SDL_BlendMode mode) {
+  SDL_BlendMode current;
+  if ((SDL_GetTextureBlendMode(texture, &current) == 0) && (current == mode)) {
+    return;
+  }
+  CHECK_EQ(SDL_SetTextureBlendMode(texture, mode), 0)
+      << "SDL error (SDL_SetTextureBlendMode): " << SDL_GetError();
+  ++frame_stats_.blend_changes;
+}
+
+void FbGfx::SetTextureMod(SDL_Texture* texture, FbColor32 mod) {
+  Uint8 r, g, b, a;
+  SDL_GetTextureColorMod(texture, &r, &g, &b);
+  if ((r != mod.channel.r) || (g != mod.channel.g) || (b != mod.channel.b)) {
+    CHECK_EQ(SDL_SetTextureColorMod(texture, mod.channel.r, mod.channel.g,
+                                    mod.channel.b),
+             0)
+        << "SDL error (SDL_SetTextureColorMod): " << SDL_GetError();
+    ++frame_stats_.color_changes;
+  }
+  SDL_GetTextureAlphaMod(texture, &a);
+  if (a != mod.channel.a) {
+    CHECK_EQ(SDL_SetTextureAlphaMod(texture, mod.channel.a), 0)
+        << "SDL error (SDL_SetTextureAlphaMod): " << SDL_GetError();
+    ++frame_stats_.color_changes;
+  }
+}
+
+// Frame statistics
+
+const FbGfx::FrameStats& FbGfx::GetFrameStats() {
+  CheckInit(__func__);
+  return last_frame_stats_;
+}
+
+void FbGfx::SetStatsOverlay(bool enabled) {
+  CheckInit(__func__);
+  stats_overlay_ = enabled;
+}
+
+void FbGfx::StartCapture(unique_ptr<FbCapture> capture) {
+  CheckInit(__func__);
+  StopCapture();
+  capture_ = std::move(capture);
+}
+
+unique_ptr<FbCapture> FbGfx::StopCapture() {
+  CheckInit(__func__);
+  return std::move(capture_);
+}
+
+void FbGfx::DrawStatsOverlay() {
+  const FrameStats& stats = last_frame_stats_;
+  const string lines[] = {
+      StrCat("cpu ", stats.submit_seconds * 1000.0, "ms present ",
+             stats.present_seconds * 1000.0, "ms"),
+      StrCat("draws ", stats.draw_calls, " prims ", stats.primitives,
+             " culled ", stats.culled),
+      StrCat("target ", stats.target_changes, " blend ", stats.blend_changes,
+             " color ", stats.color_changes),
+      StrCat("uploads ", stats.uploads, " input ",
+             stats.input_latency_seconds * 1000.0, "ms"),
+      StrCat("reloads ", stats.reloads, " ", stats.reload_seconds * 1000.0,
+             "ms")};
+  int32_t width = 0;
+  for (const string& line : lines) {
+    width = std::max(width, static_cast<int32_t>(line.size()));
+  }
+  const int32_t height = static_cast<int32_t>(std::size(lines));
+  // The overlay ignores the viewport.
+  const FbViewport viewport = viewport_;
+  const bool viewport_set = viewport_set_;
+  if (viewport_set) ResetViewport();
+  InternalFillRect(nullptr, {0, 0},
+                   ivec2(width, height) * kTextCharacterDims + ivec2(4),
+                   FbColor32(0, 0, 0, 0xa0));
+  ivec2 p{2, 2};
+  for (const string& line : lines) {
+    InternalTextLine(nullptr, line, p, FbColor32::WHITE, TEXT_ALIGN_H_LEFT,
+                     TEXT_ALIGN_V_TOP);
+    p.y += kTextCharacterDims.y;
+  }
+  if (viewport_set) SetViewport(viewport);
 }
 
 bool FbGfx::IsFullscreen() {
@@ -103,6 +508,14 @@ void FbGfx::SetFullscreen(bool fullscreen) {
       << "SDL error (SDL_SetWindowFullscreen): " << SDL_GetError();
 }
 
+int32_t FbGfx::GetRefreshRate() {
+  CheckInit(__func__);
+  if (headless_) return 0;
+  SDL_DisplayMode mode;
+  if (SDL_GetWindowDisplayMode(window_.get(), &mode) != 0) return 0;
+  return mode.refresh_rate;
+}
+
 ivec2 FbGfx::GetResolution() {
   CheckInit("GetResolution");
   ivec2 res;
@@ -110,24 +523,199 @@ ivec2 FbGfx::GetResolution() {
   return res;
 }
 
-void FbGfx::Flip() { SDL_RenderPresent(renderer_.get()); }
+void FbGfx::Flip() {
+  CheckInit(__func__);
+  loader_->Upload();
+  ReplayQueuedDrawLists();
+  if (capture_ != nullptr) capture_->Capture();
+  if (stats_overlay_) DrawStatsOverlay();
+  if (is_software()) {
+    const fbsoft::Surface screen = GetSoftScreen();
+    CHECK_EQ(SDL_UpdateTexture(soft_present_texture_.get(), nullptr,
+                               screen.pixels,
+                               screen.pitch * sizeof(fbsoft::Pixel)),
+             0)
+        << "SDL error (SDL_UpdateTexture): " << SDL_GetError();
+    ++frame_stats_.uploads;
+    PresentScreen(soft_present_texture_.get());
+  } else if (offscreen_) {
+    PresentScreen(GetTexture(nullptr));
+  }
+
+  const auto present_start = std::chrono::steady_clock::now();
+  SDL_RenderPresent(renderer_.get());
+  const auto present_end = std::chrono::steady_clock::now();
+
+  frame_stats_.submit_seconds =
+      std::chrono::duration<double>(present_start - frame_start_).count();
+  frame_stats_.present_seconds =
+      std::chrono::duration<double>(present_end - present_start).count();
+  if (polled_input_) {
+    frame_stats_.input_latency_seconds =
+        std::chrono::duration<double>(present_end - oldest_polled_input_)
+            .count();
+    polled_input_ = false;
+  }
+  last_frame_stats_ = frame_stats_;
+  frame_stats_ = FrameStats();
+  frame_start_ = present_end;
+
+  target_pool_->Recycle();
+  EnforceTextureBudget();
+  ++frame_count_;
+}
+
+// Viewport
+
+void FbGfx::SetViewport(const FbViewport& viewport) {
+  CheckInit(__func__);
+  const ivec2 clip_b = viewport.clip_p() + viewport.clip_dims();
+  CHECK((viewport.clip_p().x >= 0) && (viewport.clip_p().y >= 0) &&
+        (viewport.clip_dims().x > 0) && (viewport.clip_dims().y > 0) &&
+        (clip_b.x <= logical_res_.x) && (clip_b.y <= logical_res_.y))
+      << "Viewport clip area must lie within the screen.";
+  viewport_ = viewport;
+  viewport_set_ = true;
+  if (is_software()) return;
+  SetRenderTarget(GetTexture(nullptr));
+  ApplyViewportClip();
+}
+
+void FbGfx::ResetViewport() {
+  CheckInit(__func__);
+  viewport_ = FbViewport({0, 0}, {0, 0}, logical_res_);
+  viewport_set_ = false;
+  if (is_software()) return;
+  SetRenderTarget(GetTexture(nullptr));
+  ApplyViewportClip();
+}
+
+const FbViewport& FbGfx::GetViewport() {
+  CheckInit(__func__);
+  return viewport_;
+}
+
+ivec2 FbGfx::DrawOffset(const FbImg* target) {
+  if (target != nullptr) return {0, 0};
+  // The software screen surface already starts at the clip area.
+  return is_software() ? -viewport_.camera()
+                       : viewport_.clip_p() - viewport_.camera();
+}
+
+bool FbGfx::Culled(const FbImg* target, ivec2 a, ivec2 b,
+                   uint32_t primitives) {
+  ivec2 lo(0, 0);
+  ivec2 dims;
+  if (target != nullptr) {
+    dims = {target->width(), target->height()};
+  } else {
+    if (!is_software()) lo = viewport_.clip_p();
+    dims = viewport_.clip_dims();
+  }
+  const ivec2 hi = lo + dims - ivec2(1);
+  if ((b.x >= lo.x) && (b.y >= lo.y) && (a.x <= hi.x) && (a.y <= hi.y)) {
+    return false;
+  }
+  frame_stats_.culled += primitives;
+  return true;
+}
+
+void FbGfx::ApplyViewportClip() {
+  if (!viewport_set_) {
+    CHECK_EQ(SDL_RenderSetClipRect(renderer_.get(), nullptr), 0)
+        << "SDL error (SDL_RenderSetClipRect): " << SDL_GetError();
+    return;
+  }
+  const SDL_Rect clip{viewport_.clip_p().x, viewport_.clip_p().y,
+                      viewport_.clip_dims().x, viewport_.clip_dims().y};
+  CHECK_EQ(SDL_RenderSetClipRect(renderer_.get(), &clip), 0)
+      << "SDL error (SDL_RenderSetClipRect): " << SDL_GetError();
+}
+
+// Draw lists
+
+void FbGfx::QueueDrawList(const FbDrawList& list, int32_t order) {
+  std::lock_guard<std::mutex> lock(draw_list_queue_mutex_);
+  draw_list_queue_.push_back(
+      {order, static_cast<uint32_t>(draw_list_queue_.size()), &list});
+}
+
+void FbGfx::ReplayQueuedDrawLists() {
+  std::vector<QueuedDrawList> queue;
+  {
+    std::lock_guard<std::mutex> lock(draw_list_queue_mutex_);
+    queue.swap(draw_list_queue_);
+  }
+  std::sort(queue.begin(), queue.end(),
+            [](const QueuedDrawList& a, const QueuedDrawList& b) {
+              return (a.order != b.order) ? (a.order < b.order)
+                                          : (a.sequence < b.sequence);
+            });
+  for (const auto& queued : queue) ReplayDrawList(*queued.list);
+}
+
+void FbGfx::ReplayDrawList(const FbDrawList& list) {
+  CheckInit(__func__);
+  for (const auto& command : list.commands_) {
+    const FbImg* target = command.target;
+    switch (command.type) {
+      case FbDrawList::CMD_CLS:
+        InternalCls(target, command.color);
+        break;
+      case FbDrawList::CMD_PSET:
+        InternalPSet(target, command.a, command.color);
+        break;
+      case FbDrawList::CMD_LINE:
+        InternalLine(target, command.a, command.b, command.color);
+        break;
+      case FbDrawList::CMD_RECT:
+        InternalRect(target, command.a, command.b, command.color);
+        break;
+      case FbDrawList::CMD_FILL_RECT:
+        InternalFillRect(target, command.a, command.b, command.color);
+        break;
+      case FbDrawList::CMD_TEXT_LINE:
+        InternalTextLine(target, list.GetText(command), command.a,
+                         command.color, command.h_align, command.v_align);
+        break;
+      case FbDrawList::CMD_TEXT_PARAGRAPH:
+        InternalTextParagraph(target, list.GetText(command), command.a,
+                              command.b, command.color, command.h_align,
+                              command.v_align);
+        break;
+      case FbDrawList::CMD_PUT:
+        InternalPut(target, *command.src, command.a, command.opts, command.b,
+                    command.c);
+        break;
+      default:
+        CHECK(false) << "Unknown draw list command: " << command.type;
+    }
+  }
+}
 
 // Cls
 
 void FbGfx::Cls(const FbImg& target, FbColor32 col) {
   CheckInit(__func__);
   target.CheckTarget(__func__);
-  InternalCls(target.texture_.get(), col);
+  InternalCls(&target, col);
 }
 void FbGfx::Cls(FbColor32 col) {
   CheckInit(__func__);
   InternalCls(nullptr, col);
 }
-void FbGfx::InternalCls(SDL_Texture* texture, FbColor32 col) {
-  SetRenderTarget(texture);
+void FbGfx::InternalCls(const FbImg* target, FbColor32 col) {
+  if (is_software()) {
+    fbsoft::Clear(target != nullptr ? GetSoftSurface(target) : GetSoftScreen(),
+                  col);
+    CountDraw(1);
+    return;
+  }
+  SetRenderTarget(GetTexture(target));
   SetRenderColor(col);
   CHECK_EQ(SDL_RenderClear(renderer_.get()), 0)
       << "SDL error (SDL_RenderClear): " << SDL_GetError();
+  CountDraw(1);
 }
 
 // PSet
@@ -139,13 +727,21 @@ void FbGfx::PSet(ivec2 p, FbColor32 color) {
 void FbGfx::PSet(const FbImg& target, ivec2 p, FbColor32 color) {
   CheckInit(__func__);
   target.CheckTarget(__func__);
-  InternalPSet(target.texture_.get(), p, color);
+  InternalPSet(&target, p, color);
 }
-void FbGfx::InternalPSet(SDL_Texture* texture, glm::ivec2 p, FbColor32 color) {
-  SetRenderTarget(texture);
+void FbGfx::InternalPSet(const FbImg* target, glm::ivec2 p, FbColor32 color) {
+  p += DrawOffset(target);
+  if (Culled(target, p, p)) return;
+  if (is_software()) {
+    fbsoft::PSet(GetSoftSurface(target), p, color);
+    CountDraw(1);
+    return;
+  }
+  SetRenderTarget(GetTexture(target));
   SetRenderColor(color);
   CHECK_EQ(SDL_RenderDrawPoint(renderer_.get(), p.x, p.y), 0)
       << "SDL error (SDL_RenderDrawPoint): " << SDL_GetError();
+  CountDraw(1);
 }
 
 // Line
@@ -157,14 +753,24 @@ void FbGfx::Line(ivec2 a, ivec2 b, FbColor32 color) {
 void FbGfx::Line(const FbImg& target, ivec2 a, ivec2 b, FbColor32 color) {
   CheckInit(__func__);
   target.CheckTarget(__func__);
-  InternalLine(target.texture_.get(), a, b, color);
+  InternalLine(&target, a, b, color);
 }
-void FbGfx::InternalLine(SDL_Texture* texture, ivec2 a, ivec2 b,
+void FbGfx::InternalLine(const FbImg* target, ivec2 a, ivec2 b,
                          FbColor32 color) {
-  SetRenderTarget(texture);
+  const ivec2 offset = DrawOffset(target);
+  a += offset;
+  b += offset;
+  if (Culled(target, glm::min(a, b), glm::max(a, b))) return;
+  if (is_software()) {
+    fbsoft::Line(GetSoftSurface(target), a, b, color);
+    CountDraw(1);
+    return;
+  }
+  SetRenderTarget(GetTexture(target));
   SetRenderColor(color);
   CHECK_EQ(SDL_RenderDrawLine(renderer_.get(), a.x, a.y, b.x, b.y), 0)
       << "SDL error (SDL_RenderDrawLine): " << SDL_GetError();
+  CountDraw(1);
 }
 
 // Rect
@@ -176,15 +782,23 @@ void FbGfx::Rect(ivec2 a, ivec2 b, FbColor32 color) {
 void FbGfx::Rect(const FbImg& target, ivec2 a, ivec2 b, FbColor32 color) {
   CheckInit(__func__);
   target.CheckTarget(__func__);
-  InternalRect(target.texture_.get(), a, b, color);
+  InternalRect(&target, a, b, color);
 }
-void FbGfx::InternalRect(SDL_Texture* texture, ivec2 a, ivec2 b,
+void FbGfx::InternalRect(const FbImg* target, ivec2 a, ivec2 b,
                          FbColor32 color) {
-  SetRenderTarget(texture);
+  a += DrawOffset(target);
+  if (Culled(target, a, a + b - ivec2(1))) return;
+  if (is_software()) {
+    fbsoft::Rect(GetSoftSurface(target), a, b, color);
+    CountDraw(1);
+    return;
+  }
+  SetRenderTarget(GetTexture(target));
   SetRenderColor(color);
   SDL_Rect rect{a.x, a.y, b.x, b.y};
   CHECK_EQ(SDL_RenderDrawRect(renderer_.get(), &rect), 0)
       << "SDL error (SDL_RenderDrawRect): " << SDL_GetError();
+  CountDraw(1);
 }
 
 // FillRect
@@ -196,124 +810,336 @@ void FbGfx::FillRect(ivec2 a, ivec2 b, FbColor32 color) {
 void FbGfx::FillRect(const FbImg& target, ivec2 a, ivec2 b, FbColor32 color) {
   CheckInit(__func__);
   target.CheckTarget(__func__);
-  InternalFillRect(target.texture_.get(), a, b, color);
+  InternalFillRect(&target, a, b, color);
 }
-void FbGfx::InternalFillRect(SDL_Texture* texture, ivec2 a, ivec2 b,
+void FbGfx::InternalFillRect(const FbImg* target, ivec2 a, ivec2 b,
                              FbColor32 color) {
-  SetRenderTarget(texture);
+  a += DrawOffset(target);
+  if (Culled(target, a, a + b - ivec2(1))) return;
+  if (is_software()) {
+    fbsoft::FillRect(GetSoftSurface(target), a, b, color);
+    CountDraw(1);
+    return;
+  }
+  SetRenderTarget(GetTexture(target));
   SetRenderColor(color);
   SDL_Rect rect{a.x, a.y, b.x, b.y};
   CHECK_EQ(SDL_RenderFillRect(renderer_.get(), &rect), 0)
       << "SDL error (SDL_RenderFillRect): " << SDL_GetError();
+  CountDraw(1);
+}
+
+// PSetMany
+
+void FbGfx::PSetMany(absl::Span<const PointPrim> points) {
+  CheckInit(__func__);
+  InternalPSetMany(nullptr, points);
+}
+void FbGfx::PSetMany(const FbImg& target, absl::Span<const PointPrim> points) {
+  CheckInit(__func__);
+  target.CheckTarget(__func__);
+  InternalPSetMany(&target, points);
+}
+void FbGfx::InternalPSetMany(const FbImg* target,
+                             absl::Span<const PointPrim> points) {
+  if (points.empty()) return;
+  const ivec2 offset = DrawOffset(target);
+  if (is_software()) {
+    const fbsoft::Surface surface = GetSoftSurface(target);
+    uint32_t drawn = 0;
+    for (const PointPrim& point : points) {
+      const ivec2 p = point.p + offset;
+      if (Culled(target, p, p)) continue;
+      fbsoft::PSet(surface, p, point.color);
+      ++drawn;
+    }
+    CountDraw(drawn, drawn);
+    return;
+  }
+  SetRenderTarget(GetTexture(target));
+  ForEachRun(
+      points, [](const PointPrim&, const PointPrim&) { return true; },
+      [target, points, offset](size_t begin, size_t end) {
+        point_scratch_.clear();
+        for (size_t i = begin; i < end; ++i) {
+          const ivec2 p = points[i].p + offset;
+          if (Culled(target, p, p)) continue;
+          point_scratch_.push_back({p.x, p.y});
+        }
+        if (point_scratch_.empty()) return;
+        SetRenderColor(points[begin].color);
+        const int count = static_cast<int>(point_scratch_.size());
+        CHECK_EQ(
+            SDL_RenderDrawPoints(renderer_.get(), point_scratch_.data(), count),
+            0)
+            << "SDL error (SDL_RenderDrawPoints): " << SDL_GetError();
+        CountDraw(1, count);
+      });
+}
+
+// LinesMany
+
+void FbGfx::LinesMany(absl::Span<const LinePrim> lines) {
+  CheckInit(__func__);
+  InternalLinesMany(nullptr, lines);
+}
+void FbGfx::LinesMany(const FbImg& target, absl::Span<const LinePrim> lines) {
+  CheckInit(__func__);
+  target.CheckTarget(__func__);
+  InternalLinesMany(&target, lines);
+}
+void FbGfx::InternalLinesMany(const FbImg* target,
+                              absl::Span<const LinePrim> lines) {
+  if (lines.empty()) return;
+  const ivec2 offset = DrawOffset(target);
+  if (is_software()) {
+    const fbsoft::Surface surface = GetSoftSurface(target);
+    uint32_t drawn = 0;
+    for (const LinePrim& line : lines) {
+      const ivec2 a = line.a + offset;
+      const ivec2 b = line.b + offset;
+      if (Culled(target, glm::min(a, b), glm::max(a, b))) continue;
+      fbsoft::Line(surface, a, b, line.color);
+      ++drawn;
+    }
+    CountDraw(drawn, drawn);
+    return;
+  }
+  SetRenderTarget(GetTexture(target));
+  ForEachRun(
+      lines,
+      [](const LinePrim& prev, const LinePrim& next) {
+        return prev.b == next.a;
+      },
+      [target, lines, offset](size_t begin, size_t end) {
+        // A run is a polyline through the first line's start and every
+        // line's end, culled as a whole by its bounds.
+        ivec2 lo = lines[begin].a + offset;
+        ivec2 hi = lo;
+        point_scratch_.clear();
+        point_scratch_.push_back({lo.x, lo.y});
+        for (size_t i = begin; i < end; ++i) {
+          const ivec2 p = lines[i].b + offset;
+          lo = glm::min(lo, p);
+          hi = glm::max(hi, p);
+          point_scratch_.push_back({p.x, p.y});
+        }
+        if (Culled(target, lo, hi, end - begin)) return;
+        SetRenderColor(lines[begin].color);
+        const int count = static_cast<int>(point_scratch_.size());
+        CHECK_EQ(
+            SDL_RenderDrawLines(renderer_.get(), point_scratch_.data(), count),
+            0)
+            << "SDL error (SDL_RenderDrawLines): " << SDL_GetError();
+        CountDraw(1, end - begin);
+      });
+}
+
+// RectsMany & FillRectsMany
+
+void FbGfx::RectsMany(absl::Span<const RectPrim> rects) {
+  CheckInit(__func__);
+  InternalRectsMany(nullptr, rects, false);
+}
+void FbGfx::RectsMany(const FbImg& target, absl::Span<const RectPrim> rects) {
+  CheckInit(__func__);
+  target.CheckTarget(__func__);
+  InternalRectsMany(&target, rects, false);
+}
+void FbGfx::FillRectsMany(absl::Span<const RectPrim> rects) {
+  CheckInit(__func__);
+  InternalRectsMany(nullptr, rects, true);
+}
+void FbGfx::FillRectsMany(const FbImg& target,
+                          absl::Span<const RectPrim> rects) {
+  CheckInit(__func__);
+  target.CheckTarget(__func__);
+  InternalRectsMany(&target, rects, true);
+}
+void FbGfx::InternalRectsMany(const FbImg* target,
+                              absl::Span<const RectPrim> rects, bool fill) {
+  if (rects.empty()) return;
+  const ivec2 offset = DrawOffset(target);
+  if (is_software()) {
+    const fbsoft::Surface surface = GetSoftSurface(target);
+    uint32_t drawn = 0;
+    for (const RectPrim& rect : rects) {
+      const ivec2 a = rect.a + offset;
+      if (Culled(target, a, a + rect.b - ivec2(1))) continue;
+      if (fill) {
+        fbsoft::FillRect(surface, a, rect.b, rect.color);
+      } else {
+        fbsoft::Rect(surface, a, rect.b, rect.color);
+      }
+      ++drawn;
+    }
+    CountDraw(drawn, drawn);
+    return;
+  }
+  SetRenderTarget(GetTexture(target));
+  ForEachRun(
+      rects, [](const RectPrim&, const RectPrim&) { return true; },
+      [target, rects, fill, offset](size_t begin, size_t end) {
+        rect_scratch_.clear();
+        for (size_t i = begin; i < end; ++i) {
+          const ivec2 a = rects[i].a + offset;
+          if (Culled(target, a, a + rects[i].b - ivec2(1))) continue;
+          rect_scratch_.push_back({a.x, a.y, rects[i].b.x, rects[i].b.y});
+        }
+        if (rect_scratch_.empty()) return;
+        SetRenderColor(rects[begin].color);
+        const int count = static_cast<int>(rect_scratch_.size());
+        if (fill) {
+          CHECK_EQ(
+              SDL_RenderFillRects(renderer_.get(), rect_scratch_.data(), count),
+              0)
+              << "SDL error (SDL_RenderFillRects): " << SDL_GetError();
+        } else {
+          CHECK_EQ(
+              SDL_RenderDrawRects(renderer_.get(), rect_scratch_.data(), count),
+              0)
+              << "SDL error (SDL_RenderDrawRects): " << SDL_GetError();
+        }
+        CountDraw(1, count);
+      });
 }
 
 // Put & PutEx
 
 void FbGfx::Put(const FbImg& src, ivec2 p, ivec2 src_a, ivec2 src_b) {
   CheckInit(__func__);
-  InternalPut(nullptr, src.texture_.get(), {src.width(), src.height()}, p,
-              PutOptions(), src_a, src_b);
+  InternalPut(nullptr, src, p, PutOptions(), src_a, src_b);
 }
 void FbGfx::Put(const FbImg& target, const FbImg& src, ivec2 p, ivec2 src_a,
                 ivec2 src_b) {
   CheckInit(__func__);
   target.CheckTarget(__func__);
-  InternalPut(target.texture_.get(), src.texture_.get(),
-              {src.width(), src.height()}, p, PutOptions(), src_a, src_b);
+  InternalPut(&target, src, p, PutOptions(), src_a, src_b);
 }
 
 void FbGfx::PutEx(const FbImg& src, ivec2 p, PutOptions opts, ivec2 src_a,
                   ivec2 src_b) {
   CheckInit(__func__);
-  InternalPut(nullptr, src.texture_.get(), {src.width(), src.height()}, p, opts,
-              src_a, src_b);
+  InternalPut(nullptr, src, p, opts, src_a, src_b);
 }
 void FbGfx::PutEx(const FbImg& target, const FbImg& src, ivec2 p,
                   PutOptions opts, ivec2 src_a, ivec2 src_b) {
   CheckInit(__func__);
   target.CheckTarget(__func__);
-  InternalPut(target.texture_.get(), src.texture_.get(),
-              {src.width(), src.height()}, p, opts, src_a, src_b);
+  InternalPut(&target, src, p, opts, src_a, src_b);
 }
 
-inline SDL_BlendMode GetSdlBlendMode(FbGfx::PutOptions::BlendMode m) {
+SDL_BlendMode FbGfx::GetSdlBlendMode(PutOptions::BlendMode m) {
   switch (m) {
-    case FbGfx::PutOptions::BLEND_NONE:
+    case PutOptions::BLEND_NONE:
       return SDL_BLENDMODE_NONE;
-    case FbGfx::PutOptions::BLEND_ALPHA:
+    case PutOptions::BLEND_ALPHA:
       return SDL_BLENDMODE_BLEND;
-    case FbGfx::PutOptions::BLEND_ADD:
+    case PutOptions::BLEND_ADD:
       return SDL_BLENDMODE_ADD;
-    case FbGfx::PutOptions::BLEND_MOD:
+    case PutOptions::BLEND_MOD:
       return SDL_BLENDMODE_MOD;
     default:
       CHECK(false) << "Not a real blend mode: " << m;
   }
 }
 
-void FbGfx::InternalPut(SDL_Texture* dest, SDL_Texture* src, ivec2 src_dims,
-                        ivec2 p, PutOptions opts, ivec2 src_a, ivec2 src_b) {
-  SetRenderTarget(dest);
+bool FbGfx::ComputePutRects(ivec2 src_dims, ivec2 p, ivec2 src_a, ivec2 src_b,
+                            SDL_Rect* src_rect, SDL_Rect* dst_rect) {
+  dst_rect->x = p.x;
+  dst_rect->y = p.y;
 
-  CHECK_EQ(SDL_SetTextureBlendMode(src, GetSdlBlendMode(opts.blend)), 0)
-      << "SDL error (SDL_SetTextureBlendMode): " << SDL_GetError();
-  CHECK_EQ(SDL_SetTextureColorMod(src, opts.mod.channel.r, opts.mod.channel.g,
-                                  opts.mod.channel.b),
-           0)
-      << "SDL error (SDL_SetTextureColorMod): " << SDL_GetError();
-  CHECK_EQ(SDL_SetTextureAlphaMod(src, opts.mod.channel.a), 0)
-      << "SDL error (SDL_SetTextureAlphaMod): " << SDL_GetError();
+  if ((src_a.x == -1) || (src_a.y == -1) || (src_b.x == -1) ||
+      (src_b.y == -1)) {
+    *src_rect = {0, 0, src_dims.x, src_dims.y};
+    dst_rect->w = src_dims.x;
+    dst_rect->h = src_dims.y;
+    return false;
+  }
+  if (src_a.x > src_b.x) std::swap(src_a.x, src_b.x);
+  if (src_a.y > src_b.y) std::swap(src_a.y, src_b.y);
+  src_rect->x = src_a.x;
+  src_rect->y = src_a.y;
+  src_rect->w = src_b.x - src_a.x + 1;
+  src_rect->h = src_b.y - src_a.y + 1;
+  dst_rect->w = src_rect->w;
+  dst_rect->h = src_rect->h;
+  return true;
+}
 
+void FbGfx::InternalPut(const FbImg* target, const FbImg& src_img, ivec2 p,
+                        PutOptions opts, ivec2 src_a, ivec2 src_b) {
+  CHECK(!src_img.is_locked()) << "Can't draw a locked image.";
   SDL_Rect dst_rect;
   SDL_Rect src_rect;
+  ComputePutRects({src_img.width(), src_img.height()},
+                  p + DrawOffset(target), src_a, src_b, &src_rect, &dst_rect);
+  if (Culled(target, {dst_rect.x, dst_rect.y},
+             {dst_rect.x + dst_rect.w - 1, dst_rect.y + dst_rect.h - 1})) {
+    return;
+  }
 
-  dst_rect.x = p.x;
-  dst_rect.y = p.y;
-
-  const SDL_Rect* src_rect_target = &src_rect;
-  if ((src_a.x == -1) || (src_a.y == -1) || (src_b.x == -1) ||
-      (src_b.y == -1)) {
-    src_rect_target = nullptr;
-    dst_rect.w = src_dims.x;
-    dst_rect.h = src_dims.y;
-  } else {
-    if (src_a.x > src_b.x) std::swap(src_a.x, src_b.y);
-    if (src_a.y > src_b.y) std::swap(src_a.y, src_b.y);
-    src_rect.x = src_a.x;
-    src_rect.y = src_a.y;
-    src_rect.w = src_b.x - src_a.x + 1;
-    src_rect.h = src_b.y - src_a.y + 1;
-    dst_rect.w = src_rect.w;
-    dst_rect.h = src_rect.h;
+  if (is_software()) {
+    fbsoft::Blit(GetSoftSurface(target), {dst_rect.x, dst_rect.y},
+                 GetSoftSurface(&src_img), {src_rect.x, src_rect.y},
+                 {src_rect.w, src_rect.h}, opts.blend, opts.mod);
+    CountDraw(1);
+    return;
   }
 
-  CHECK_EQ(SDL_RenderCopy(renderer_.get(), src, src_rect_target, &dst_rect), 0)
+  SDL_Texture* src = GetTexture(&src_img);
+  src_rect.x += src_img.origin_.x;
+  src_rect.y += src_img.origin_.y;
+  SetRenderTarget(GetTexture(target));
+
+  SetTextureBlendMode(src, GetSdlBlendMode(opts.blend));
+  SetTextureMod(src, opts.mod);
+
+  CHECK_EQ(SDL_RenderCopy(renderer_.get(), src, &src_rect, &dst_rect),
+           0)
       << "SDL error (SDL_RenderCopy): " << SDL_GetError();
+  CountDraw(1);
 }
 
-// TextLine
+// Text
 
-void FbGfx::TextLine(string_view text, ivec2 p, FbColor32 color,
-                     TextHAlign h_align, TextVAlign v_align) {
-  CheckInit(__func__);
-  InternalTextLine(nullptr, text, p, color, h_align, v_align);
+void FbGfx::SetTextCacheCapacity(size_t capacity) {
+  text_cache_.SetCapacity(capacity);
 }
-void FbGfx::TextLine(const FbImg& target, string_view text, ivec2 p,
-                     FbColor32 color, TextHAlign h_align, TextVAlign v_align) {
-  CheckInit(__func__);
-  target.CheckTarget(__func__);
-  InternalTextLine(target.texture_.get(), text, p, color, h_align, v_align);
+
+size_t FbGfx::HashText(const TextKey& key, string_view text) {
+  size_t hash = std::hash<std::string_view>()(
+      std::string_view(text.data(), text.size()));
+  const uint32_t fields[] = {key.paragraph,
+                             static_cast<uint32_t>(key.h_align),
+                             static_cast<uint32_t>(key.v_align),
+                             static_cast<uint32_t>(key.box_dims.x),
+                             static_cast<uint32_t>(key.box_dims.y),
+                             key.color};
+  for (const uint32_t field : fields) {
+    hash ^= field + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+  }
+  return hash;
 }
 
-void FbGfx::InternalTextLine(SDL_Texture* texture, string_view text, ivec2 p,
-                             FbColor32 color, TextHAlign h_align,
-                             TextVAlign v_align) {
-  SetRenderTarget(texture);
-  CHECK_EQ(
-      SDL_SetTextureColorMod(basic_font_.get()->texture_.get(), color.channel.r,
-                             color.channel.g, color.channel.b),
-      0)
-      << "SDL error (SDL_SetTextureColorMod): " << SDL_GetError();
+FbGfx::GlyphRun* FbGfx::FindCachedText(const TextKey& key, string_view text) {
+  CachedText* cached = text_cache_.Find(HashText(key, text));
+  if ((cached == nullptr) || !(cached->key == key) || (cached->text != text)) {
+    return nullptr;
+  }
+  return &cached->run;
+}
+
+FbGfx::GlyphRun* FbGfx::CacheText(const TextKey& key, string_view text,
+                                  GlyphRun run) {
+  return &text_cache_
+              .Insert(HashText(key, text),
+                      {key, string(text.data(), text.size()), std::move(run)})
+              ->run;
+}
+
+void FbGfx::LayoutTextLine(string_view text, ivec2 p, TextHAlign h_align,
+                           TextVAlign v_align, std::vector<Glyph>* glyphs) {
   const ivec2 box_dims{text.size() * kTextCharacterDims.x,
                        kTextCharacterDims.y};
   switch (h_align) {
@@ -340,22 +1166,43 @@ void FbGfx::InternalTextLine(SDL_Texture* texture, string_view text, ivec2 p,
       p.y -= box_dims.y;
       break;
     default:
-      CHECK(false) << "Invalid vertical text alignment specified: " << h_align;
+      CHECK(false) << "Invalid vertical text alignment specified: " << v_align;
   }
 
-  SDL_Rect src_rect{0, 0, kTextCharacterDims.x, kTextCharacterDims.y};
-  SDL_Rect dst_rect{p.x, p.y, kTextCharacterDims.x, kTextCharacterDims.y};
-  SDL_Texture* font_tex = basic_font_.get()->texture_.get();
   for (const char c : text) {
-    src_rect.x = (c & 0x1f) * kTextCharacterDims.x;
-    src_rect.y = (c >> 5) * kTextCharacterDims.y;
-    CHECK_EQ(SDL_RenderCopy(renderer_.get(), font_tex, &src_rect, &dst_rect), 0)
-        << "SDL error (SDL_RenderCopy): " << SDL_GetError();
-    dst_rect.x += kTextCharacterDims.x;
+    glyphs->push_back({GlyphSource(c), p});
+    p.x += kTextCharacterDims.x;
   }
 }
 
-// TextParagraph
+ivec2 FbGfx::GlyphSource(char c) {
+  return {(c & 0x1f) * kTextCharacterDims.x, (c >> 5) * kTextCharacterDims.y};
+}
+
+void FbGfx::TextLine(string_view text, ivec2 p, FbColor32 color,
+                     TextHAlign h_align, TextVAlign v_align) {
+  CheckInit(__func__);
+  InternalTextLine(nullptr, text, p, color, h_align, v_align);
+}
+void FbGfx::TextLine(const FbImg& target, string_view text, ivec2 p,
+                     FbColor32 color, TextHAlign h_align, TextVAlign v_align) {
+  CheckInit(__func__);
+  target.CheckTarget(__func__);
+  InternalTextLine(&target, text, p, color, h_align, v_align);
+}
+
+void FbGfx::InternalTextLine(const FbImg* target, string_view text, ivec2 p,
+                             FbColor32 color, TextHAlign h_align,
+                             TextVAlign v_align) {
+  const TextKey key{false, h_align, v_align, {0, 0}, color.value};
+  GlyphRun* run = FindCachedText(key, text);
+  if (run == nullptr) {
+    GlyphRun new_run;
+    LayoutTextLine(text, {0, 0}, h_align, v_align, &new_run.glyphs);
+    run = CacheText(key, text, std::move(new_run));
+  }
+  DrawGlyphRun(target, color, p, run);
+}
 
 void FbGfx::TextParagraph(string_view text, ivec2 a, ivec2 b, FbColor32 color,
                           TextHAlign h_align, TextVAlign v_align) {
@@ -367,91 +1214,141 @@ void FbGfx::TextParagraph(const FbImg& target, string_view text, ivec2 a,
                           TextVAlign v_align) {
   CheckInit(__func__);
   target.CheckTarget(__func__);
-  InternalTextParagraph(target.texture_.get(), text, a, b, color, h_align,
+  InternalTextParagraph(&target, text, a, b, color, h_align,
                         v_align);
 }
 
-void FbGfx::InternalTextParagraph(SDL_Texture* texture, string_view text,
+void FbGfx::InternalTextParagraph(const FbImg* target, string_view text,
                                   ivec2 a, ivec2 b, FbColor32 color,
                                   TextHAlign h_align, TextVAlign v_align) {
-  SetRenderTarget(texture);
-  CHECK_EQ(
-      SDL_SetTextureColorMod(basic_font_.get()->texture_.get(), color.channel.r,
-                             color.channel.g, color.channel.b),
-      0)
-      << "SDL error (SDL_SetTextureColorMod): " << SDL_GetError();
-  if (a.x > b.x) std::swap(a.x, b.y);
-  if (a.y > b.y) std::swap(a.y, b.y);
-  const ivec2 box_dims = b - a + ivec2{1, 1};
-
-  if ((box_dims.x < kTextCharacterDims.x) ||
-      (box_dims.y < kTextCharacterDims.y))
-    return;
-
-  const int lines_height =
-      (box_dims.y / kTextCharacterDims.y) * kTextCharacterDims.y;
+  const ivec2 origin = glm::min(a, b);
+  const TextKey key{true, h_align, v_align, glm::max(a, b) - origin,
+                    color.value};
+  GlyphRun* run = FindCachedText(key, text);
+  if (run == nullptr) {
+    FbTextLayout layout(text, {0, 0}, key.box_dims, h_align, v_align);
+    run = CacheText(key, text, std::move(layout.run_));
+  }
+  DrawGlyphRun(target, color, origin, run);
+}
 
-  SDL_Rect dst_rect{0, a.y, kTextCharacterDims.x, kTextCharacterDims.y};
+void FbGfx::Text(const FbTextLayout& layout, FbColor32 color) {
+  CheckInit(__func__);
+  DrawGlyphRun(nullptr, color, {0, 0}, &layout.run_);
+}
+void FbGfx::Text(const FbImg& target, const FbTextLayout& layout,
+                 FbColor32 color) {
+  CheckInit(__func__);
+  target.CheckTarget(__func__);
+  DrawGlyphRun(&target, color, {0, 0}, &layout.run_);
+}
 
-  switch (v_align) {
-    case TEXT_ALIGN_V_TOP:
-      break;
-    case TEXT_ALIGN_V_CENTER:
-      dst_rect.y += (box_dims.y - lines_height) * 0.5;
-      break;
-    case TEXT_ALIGN_V_BOTTOM:
-      dst_rect.y += box_dims.y - lines_height;
-      break;
-    default:
-      CHECK(false) << "Invalid vertical text alignment specified: " << h_align;
+void FbGfx::DrawGlyphRun(const FbImg* target, FbColor32 color, ivec2 origin,
+                         GlyphRun* run) {
+  if (run->glyphs.empty()) return;
+  const ivec2 offset = DrawOffset(target) + origin;
+  ivec2 lo = run->glyphs.front().dst_p;
+  ivec2 hi = lo;
+  for (const Glyph& glyph : run->glyphs) {
+    lo = glm::min(lo, glyph.dst_p);
+    hi = glm::max(hi, glyph.dst_p);
+  }
+  if (Culled(target, lo + offset, hi + offset + kTextCharacterDims - ivec2(1),
+             run->glyphs.size())) {
+    return;
   }
 
-  SDL_Rect src_rect{0, 0, kTextCharacterDims.x, kTextCharacterDims.y};
-  SDL_Texture* font_tex = basic_font_.get()->texture_.get();
-  int cursor = 0;
-  while (cursor < text.size()) {
-    int space_skip = 1;
-    int line_term = cursor;
-    int line_s = cursor;
-    for (line_s = cursor;
-         (line_s < text.size()) &&
-         (((line_s - cursor) * kTextCharacterDims.x) <= box_dims.x);
-         ++line_s) {
-      if (text[line_s] == ' ') line_term = line_s;
-    }
-    if (line_term == cursor) {
-      line_term = line_s;
-      if (text[line_s] != ' ') space_skip = 0;
-    }
-    const int line_width = (line_term - cursor) * kTextCharacterDims.x;
-    switch (v_align) {
-      case TEXT_ALIGN_H_LEFT:
-        dst_rect.x = a.x;
-        break;
-      case TEXT_ALIGN_H_CENTER:
-        dst_rect.x = a.x + (box_dims.x - line_width) * 0.5;
-        break;
-      case TEXT_ALIGN_H_RIGHT:
-        dst_rect.x = a.x + box_dims.x - line_width;
-        break;
-      default:
-        CHECK(false) << "Invalid horizontal text alignment specified: "
-                     << h_align;
+  if (is_software()) {
+    const fbsoft::Surface dst = GetSoftSurface(target);
+    const fbsoft::Surface font = GetSoftSurface(basic_font_.get());
+    color.channel.a = 0xff;
+    for (const Glyph& glyph : run->glyphs) {
+      fbsoft::Blit(dst, glyph.dst_p + offset, font, glyph.src_p,
+                   kTextCharacterDims, PutOptions::BLEND_ALPHA, color);
     }
+    CountDraw(run->glyphs.size(), run->glyphs.size());
+    return;
+  }
 
-    for (int c_i = cursor; c_i < line_term; ++c_i) {
-      const char c = text[c_i];
-      src_rect.x = (c & 0x1f) * kTextCharacterDims.x;
-      src_rect.y = (c >> 5) * kTextCharacterDims.y;
-      CHECK_EQ(SDL_RenderCopy(renderer_.get(), font_tex, &src_rect, &dst_rect),
-               0)
-          << "SDL error (SDL_RenderCopy): " << SDL_GetError();
-      dst_rect.x += kTextCharacterDims.x;
+  // The font's texture may be an atlas page shared with other images, so its
+  // state has to be set up on every use.
+  SDL_Texture* font_tex = GetTexture(basic_font_.get());
+  const ivec2 font_origin = basic_font_->origin_;
+  SetRenderTarget(GetTexture(target));
+  SetTextureBlendMode(font_tex, SDL_BLENDMODE_BLEND);
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+  // The vertex colors carry the text color, so a run drawn in a new color
+  // needs new vertices.
+  color.channel.a = 0xff;
+  if (run->vertex_color != color.value) {
+    run->vertices.clear();
+    run->indices.clear();
+    run->vertex_color = color.value;
+  }
+  if (run->vertex_offset != offset) {
+    const ivec2 delta = offset - run->vertex_offset;
+    for (SDL_Vertex& vertex : run->vertices) {
+      vertex.position.x += delta.x;
+      vertex.position.y += delta.y;
     }
+    run->vertex_offset = offset;
+  }
+  // Glyphs added since the run was last drawn (see FbTextLayout::Append) get
+  // their vertices appended.
+  if (run->vertices.size() < run->glyphs.size() * 4) {
+    const SDL_Color vertex_color{static_cast<Uint8>(color.channel.r),
+                                 static_cast<Uint8>(color.channel.g),
+                                 static_cast<Uint8>(color.channel.b), 255};
+    const float inv_w = 1.0f / basic_font_->root().width();
+    const float inv_h = 1.0f / basic_font_->root().height();
+    run->vertices.reserve(run->glyphs.size() * 4);
+    run->indices.reserve(run->glyphs.size() * 6);
+    for (size_t glyph_i = run->vertices.size() / 4;
+         glyph_i < run->glyphs.size(); ++glyph_i) {
+      const Glyph& glyph = run->glyphs[glyph_i];
+      const ivec2 dst_p = glyph.dst_p + offset;
+      const float x0 = dst_p.x;
+      const float y0 = dst_p.y;
+      const float x1 = dst_p.x + kTextCharacterDims.x;
+      const float y1 = dst_p.y + kTextCharacterDims.y;
+      const ivec2 src_p = glyph.src_p + font_origin;
+      const float u0 = src_p.x * inv_w;
+      const float v0 = src_p.y * inv_h;
+      const float u1 = (src_p.x + kTextCharacterDims.x) * inv_w;
+      const float v1 = (src_p.y + kTextCharacterDims.y) * inv_h;
 
-    cursor = line_term + space_skip;
-    dst_rect.y += kTextCharacterDims.y;
+      const int base = static_cast<int>(run->vertices.size());
+      run->vertices.push_back({{x0, y0}, vertex_color, {u0, v0}});
+      run->vertices.push_back({{x1, y0}, vertex_color, {u1, v0}});
+      run->vertices.push_back({{x1, y1}, vertex_color, {u1, v1}});
+      run->vertices.push_back({{x0, y1}, vertex_color, {u0, v1}});
+      run->indices.insert(run->indices.end(),
+                          {base, base + 1, base + 2, base, base + 2, base + 3});
+    }
+  }
+  SetTextureMod(font_tex, FbColor32::WHITE);
+  CHECK_EQ(SDL_RenderGeometry(renderer_.get(), font_tex, run->vertices.data(),
+                              static_cast<int>(run->vertices.size()),
+                              run->indices.data(),
+                              static_cast<int>(run->indices.size())),
+           0)
+      << "SDL error (SDL_RenderGeometry): " << SDL_GetError();
+  CountDraw(1, run->glyphs.size());
+#else
+  color.channel.a = 0xff;
+  SetTextureMod(font_tex, color);
+  SDL_Rect src_rect{0, 0, kTextCharacterDims.x, kTextCharacterDims.y};
+  SDL_Rect dst_rect{0, 0, kTextCharacterDims.x, kTextCharacterDims.y};
+  for (const Glyph& glyph : run->glyphs) {
+    src_rect.x = glyph.src_p.x + font_origin.x;
+    src_rect.y = glyph.src_p.y + font_origin.y;
+    dst_rect.x = glyph.dst_p.x + offset.x;
+    dst_rect.y = glyph.dst_p.y + offset.y;
+    CHECK_EQ(SDL_RenderCopy(renderer_.get(), font_tex, &src_rect, &dst_rect), 0)
+        << "SDL error (SDL_RenderCopy): " << SDL_GetError();
   }
+  CountDraw(run->glyphs.size(), run->glyphs.size());
+#endif
 }
 
 bool FbGfx::GetKeyPressed(Key key) {
@@ -471,39 +1368,93 @@ bool FbGfx::Close() {
 
 void FbGfx::SyncInputs() {
   CheckInit(__func__);
-  close_pressed_ = false;
-  mouse_button_state_ = {false, false, false};
+  PumpInputs();
+  close_pressed_ = pending_close_pressed_;
+  mouse_button_state_ = pending_mouse_button_state_;
+  pending_close_pressed_ = false;
+  pending_mouse_button_state_ = {false, false, false};
   ++input_cycle_;
+}
+
+void FbGfx::PumpInputs() {
+  CheckInit(__func__);
+  const auto now = std::chrono::steady_clock::now();
+  const uint32_t now_ticks = SDL_GetTicks();
   SDL_Event event;
   while (SDL_PollEvent(&event)) {
+    InputEvent input{InputEvent::QUIT, now, 0, 0, {0, 0}};
     switch (event.type) {
       case SDL_QUIT:
-        close_pressed_ = true;
+        pending_close_pressed_ = true;
+        break;
+      case SDL_KEYDOWN:
+        // Auto-repeats aren't presses.
+        if (event.key.repeat) continue;
+        input.type = InputEvent::KEY_DOWN;
+        input.scancode = event.key.keysym.scancode;
+        break;
+      case SDL_KEYUP:
+        input.type = InputEvent::KEY_UP;
+        input.scancode = event.key.keysym.scancode;
         break;
       case SDL_MOUSEBUTTONDOWN:
-        HandleMouseButtonEvent(event);
+      case SDL_MOUSEBUTTONUP:
+        if (event.type == SDL_MOUSEBUTTONDOWN) HandleMouseButtonEvent(event);
+        input.type = event.type == SDL_MOUSEBUTTONDOWN
+                         ? InputEvent::MOUSE_BUTTON_DOWN
+                         : InputEvent::MOUSE_BUTTON_UP;
+        input.button = event.button.button;
+        input.p = ToLogical(event.button.x, event.button.y);
         break;
       case SDL_MOUSEWHEEL:
         mouse_pointer_position_.z += event.wheel.y;
+        input.type = InputEvent::MOUSE_WHEEL;
+        input.p = {0, event.wheel.y};
         break;
       case SDL_MOUSEMOTION:
-        mouse_pointer_position_.x = event.motion.x;
-        mouse_pointer_position_.y = event.motion.y;
+        input.type = InputEvent::MOUSE_MOTION;
+        input.p = ToLogical(event.motion.x, event.motion.y);
+        mouse_pointer_position_.x = input.p.x;
+        mouse_pointer_position_.y = input.p.y;
         break;
+      default:
+        continue;
     }
+    // SDL stamps events (in milliseconds) when it receives them, which may
+    // be well before now if we haven't pumped for a while.
+    if (event.common.timestamp <= now_ticks) {
+      input.time -=
+          std::chrono::milliseconds(now_ticks - event.common.timestamp);
+    }
+    input_queue_.Push(input);
+  }
+}
+
+bool FbGfx::PollInput(InputEvent* event,
+                      std::chrono::steady_clock::time_point until) {
+  CheckInit(__func__);
+  if (input_queue_.empty() || (input_queue_.front().time >= until)) {
+    return false;
+  }
+  *event = input_queue_.front();
+  input_queue_.Pop();
+  if (!polled_input_ || (event->time < oldest_polled_input_)) {
+    oldest_polled_input_ = event->time;
+    polled_input_ = true;
   }
+  return true;
 }
 
 void FbGfx::HandleMouseButtonEvent(SDL_Event event) {
   switch (event.button.button) {
     case SDL_BUTTON_LEFT:
-      mouse_button_state_.left = true;
+      pending_mouse_button_state_.left = true;
       return;
     case SDL_BUTTON_MIDDLE:
-      mouse_button_state_.center = true;
+      pending_mouse_button_state_.center = true;
       return;
     case SDL_BUTTON_RIGHT:
-      mouse_button_state_.right = true;
+      pending_mouse_button_state_.right = true;
       return;
   }
 }
@@ -1,16 +1,26 @@
 #ifndef RETRO_FBGFX_H_
 #define RETRO_FBGFX_H_
 
+#include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <tuple>
+#include <vector>
 
 #include "SDL.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "glm/vec2.hpp"
 #include "glm/vec3.hpp"
 #include "glog/logging.h"
 #include "retro/fbcore.h"
+#include "retro/fbviewport.h"
 #include "sdl_util/cleanup.h"
 #include "util/deleterptr.h"
+#include "util/lrucache.h"
+#include "util/ringbuffer.h"
 
 // Single context, micro graphics library to mimic the venerable fbgfx.bi of
 // FreeBASIC.
@@ -19,17 +29,188 @@ namespace retro {
 
 constexpr char kSystemFontPath[] = "res/system_font_.png";
 
+namespace fbsoft {
+struct Surface;
+}  // namespace fbsoft
+
+class FbAtlas;
+class FbBatch;
+class FbCapture;
+class FbDrawList;
 class FbImg;
+class FbImgCache;
+class FbImgLoader;
+class FbTargetPool;
+class FbTextLayout;
 class FbGfx final {
+  friend class FbAtlas;
+  friend class FbBatch;
+  friend class FbCapture;
+  friend class FbDrawList;
   friend class FbImg;
+  friend class FbImgLoader;
+  friend class FbTextLayout;
 
  public:
+  enum Backend {
+    // Drawing is done by SDL's (usually GPU accelerated) renderer.
+    BACKEND_ACCELERATED,
+    // Drawing is done on the CPU into aligned RGBA8888 buffers (see
+    // retro/fbsoft.h), and SDL is only used to present the finished frame.
+    // Rendering is deterministic and doesn't depend on the graphics driver.
+    BACKEND_SOFTWARE
+  };
+
+  struct ScreenOptions {
+   public:
+    // How an offscreen frame is scaled up to the window.
+    enum PresentScale {
+      // By the largest whole number that fits (or as with PRESENT_SCALE_FIT
+      // if the window is smaller than the logical resolution), centered.
+      PRESENT_SCALE_INTEGER,
+      // As large as fits while keeping the aspect ratio, centered.
+      PRESENT_SCALE_FIT
+    };
+
+    ScreenOptions()
+        : backend(BACKEND_ACCELERATED),
+          headless(false),
+          offscreen(false),
+          present_scale(PRESENT_SCALE_INTEGER),
+          nearest_filtering(true),
+          image_cache_dir("") {}
+    Backend backend;
+    // Create no visible window, using SDL's dummy video driver and software
+    // renderer. Flip doesn't wait for vsync, so this is suited to tests and
+    // benchmarks; use ReadFrame to inspect what was drawn.
+    bool headless;
+    // Draw the frame into a target at the logical resolution and scale it to
+    // the window with a single copy in Flip, rather than having the renderer
+    // scale every draw to the physical resolution. Drawing then touches
+    // (physical / logical)^2 fewer pixels. The bars around a frame that
+    // doesn't fill the window are black.
+    bool offscreen;
+    PresentScale present_scale;
+    // Scale an offscreen frame up with nearest neighbor rather than linear
+    // filtering.
+    bool nearest_filtering;
+    // If not empty, a directory in which to cache decoded images (see
+    // FbImgCache) so that loading them is cheaper on later runs.
+    std::string image_cache_dir;
+    ScreenOptions& SetBackend(Backend backend) {
+      this->backend = backend;
+      return *this;
+    }
+    ScreenOptions& SetHeadless(bool headless) {
+      this->headless = headless;
+      return *this;
+    }
+    ScreenOptions& SetOffscreen(bool offscreen) {
+      this->offscreen = offscreen;
+      return *this;
+    }
+    ScreenOptions& SetPresentScale(PresentScale present_scale) {
+      this->present_scale = present_scale;
+      return *this;
+    }
+    ScreenOptions& SetNearestFiltering(bool nearest_filtering) {
+      this->nearest_filtering = nearest_filtering;
+      return *this;
+    }
+    ScreenOptions& SetImageCacheDir(const std::string& image_cache_dir) {
+      this->image_cache_dir = image_cache_dir;
+      return *this;
+    }
+  };
+
   // Must be called to use graphics functionality, can only be called once.
   // Resolution is the physical resolution of the drawing area whereas the
   // logical resolution is the resolution at which the pixels are displayed.
   static void Screen(glm::ivec2 res, bool fullscreen = false,
                      const std::string& title = "FB Gfx",
-                     glm::ivec2 physical_res = {-1, -1});
+                     glm::ivec2 physical_res = {-1, -1},
+                     ScreenOptions opts = ScreenOptions());
+
+  static Backend GetBackend();
+
+  // What it took to draw a frame.
+  struct FrameStats {
+    // Calls into the renderer (or, with BACKEND_SOFTWARE, the rasterizer)
+    // that draw something.
+    uint32_t draw_calls = 0;
+    // Points, lines, rectangles, image quads and glyphs drawn.
+    uint32_t primitives = 0;
+    // Render target switches.
+    uint32_t target_changes = 0;
+    // Texture blend mode switches.
+    uint32_t blend_changes = 0;
+    // Texture color/alpha modulation and draw color switches.
+    uint32_t color_changes = 0;
+    // Pixel transfers to textures (image loads, atlas packing and software
+    // frame presentation).
+    uint32_t uploads = 0;
+    // Primitives skipped without being submitted because they'd have landed
+    // entirely outside of their target (or the viewport's clip area).
+    uint32_t culled = 0;
+    // Time spent between the end of the previous Flip and the start of
+    // presenting this frame, i.e. building and submitting it.
+    double submit_seconds = 0;
+    // Time spent presenting, including any wait for vsync.
+    double present_seconds = 0;
+    // Time from the oldest input event taken with PollInput during the frame
+    // happening to the frame being presented (0 if no events were taken). The
+    // end of presenting stands in for the photons.
+    double input_latency_seconds = 0;
+    // Time spent capturing the frame (see StartCapture).
+    double capture_seconds = 0;
+    // Dropped textures recreated when drawn (see SetTextureBudget), and the
+    // time spent doing it. Images without a CPU copy are decoded from their
+    // files on the spot, stalling the frame.
+    uint32_t reloads = 0;
+    double reload_seconds = 0;
+  };
+  // Statistics for the last frame completed by Flip.
+  static const FrameStats& GetFrameStats();
+  // Draw the last frame's statistics in the top left of the screen at the
+  // end of every frame. The overlay's own drawing is counted in the stats.
+  static void SetStatsOverlay(bool enabled);
+
+  // Captures every frame from now on with capture, just before any stats
+  // overlay is drawn in Flip. Replaces any capture in progress.
+  static void StartCapture(std::unique_ptr<FbCapture> capture);
+  // Ends capturing, returning the capture (or nullptr if there wasn't one).
+  // Destroy it to wait for its frames to be written.
+  static std::unique_ptr<FbCapture> StopCapture();
+
+  // The atlas holding the system font, shared so that other images loaded
+  // into it (tilesets, sprites) can batch with text and each other.
+  static FbAtlas& GetAtlas();
+  // An asynchronous loader into GetAtlas(), whose decoded images are uploaded
+  // at the start of every Flip.
+  static FbImgLoader& GetLoader();
+  // A pool of transient render targets, recycled at the end of every Flip.
+  static FbTargetPool& GetTargetPool();
+  static bool IsHeadless();
+
+  // Limit the bytes of texture memory used by images (0, the default, for no
+  // limit). When images use more at the end of a Flip, the textures of the
+  // least recently drawn reloadable images (see FbImg) are dropped until
+  // usage is back within budget or only images drawn in the last frame are
+  // left. Render targets and streaming images are never dropped, but count
+  // toward the budget. Atlas pages only keep the pixels they're reloaded from
+  // if created while a budget is set, so set one before loading images. The
+  // first page, holding the font, is made in Screen before a budget can be
+  // set, so it (and whatever else is packed onto it) is never dropped.
+  static void SetTextureBudget(size_t bytes);
+  static size_t GetTextureBudget();
+  struct TextureMemoryStats {
+    // Texture memory currently used by images.
+    size_t resident_bytes = 0;
+    // Totals since Screen.
+    uint64_t drops = 0;
+    uint64_t reloads = 0;
+  };
+  static TextureMemoryStats GetTextureMemoryStats();
 
   // Clear the screen (optionally to a color)
   static void Cls(FbColor32 col = FbColor32::BLACK);
@@ -37,14 +218,58 @@ class FbGfx final {
 
   static glm::ivec2 GetResolution();
 
+  // Draws to the screen go through a viewport: coordinates are in the world
+  // the viewport's camera looks onto, nothing is drawn outside of its clip
+  // area, and primitives that would land entirely outside of it are culled
+  // before reaching the renderer (counted in FrameStats::culled). Draws to
+  // image targets and Cls are unaffected. The default viewport, restored by
+  // ResetViewport, covers the whole screen with the camera at the origin.
+  static void SetViewport(const FbViewport& viewport);
+  static void ResetViewport();
+  static const FbViewport& GetViewport();
+
   static bool IsFullscreen();
   static void SetFullscreen(bool fullscreen);
 
+  // The refresh rate of the display holding the window in Hz, or 0 if it
+  // isn't known (as is always the case when headless).
+  static int32_t GetRefreshRate();
+
   // Updates the screen after waiting for vsync, clobbering the back buffer
   // in the process (be sure to ClS if you don't plan on overwriting the whole
-  // backbuffer)
+  // backbuffer). Draw lists queued with QueueDrawList are replayed first, and
+  // images decoded by GetLoader() since the last Flip are uploaded. Targets
+  // released to GetTargetPool() become available for reuse afterwards.
   static void Flip();
 
+  // Copy out the pixels drawn to the screen since the last Flip as RGBA8888
+  // words (the layout of FbColor32::value) in row major order. If dims isn't
+  // nullptr, it receives the dimensions of the frame: the logical resolution
+  // with BACKEND_SOFTWARE, otherwise the renderer's output size. This stalls
+  // the renderer, so it's meant for tests and captures rather than every
+  // frame.
+  static std::vector<uint32_t> ReadFrame(glm::ivec2* dims = nullptr);
+
+  // TextLine and TextParagraph cache the layout of the strings they draw
+  // (keyed by text, color, position/box and alignment), so redrawing an
+  // unchanged string every frame skips layout and takes a single draw call.
+  // This sets how many strings are kept, least recently drawn evicted first.
+  // Text that changes between frames is better drawn from an FbTextLayout.
+  static void SetTextCacheCapacity(size_t capacity);
+
+  // Queue a draw list to be replayed during the next call to Flip, after any
+  // drawing done directly through FbGfx. Queued lists are replayed in
+  // ascending order of "order", and lists sharing an order are replayed in
+  // the order they were queued (so give each producer its own order if the
+  // result must be deterministic). The list must not be modified or destroyed
+  // until Flip returns.
+  //
+  // Unlike the rest of FbGfx, this may be called from any thread.
+  static void QueueDrawList(const FbDrawList& list, int32_t order = 0);
+
+  // Replay the commands in a draw list immediately.
+  static void ReplayDrawList(const FbDrawList& list);
+
   static void PSet(glm::ivec2 p, FbColor32 color = FbColor32::WHITE);
   static void PSet(const FbImg& target, glm::ivec2 p, 
                    FbColor32 color = FbColor32::WHITE);
@@ -64,6 +289,36 @@ class FbGfx final {
   static void FillRect(const FbImg& target, glm::ivec2 a, glm::ivec2 b,
                        FbColor32 color = FbColor32::WHITE);
 
+  // Bulk versions of the above for drawing many primitives at once, like
+  // debug visualizations. Primitives are drawn in order, and each run of
+  // consecutive primitives sharing a color costs a single renderer call.
+  struct PointPrim {
+    glm::ivec2 p;
+    FbColor32 color;
+  };
+  struct LinePrim {
+    glm::ivec2 a;
+    glm::ivec2 b;
+    FbColor32 color;
+  };
+  struct RectPrim {
+    glm::ivec2 a;
+    glm::ivec2 b;
+    FbColor32 color;
+  };
+  static void PSetMany(absl::Span<const PointPrim> points);
+  static void PSetMany(const FbImg& target,
+                       absl::Span<const PointPrim> points);
+  // Runs of lines are further broken wherever a line doesn't start at the end
+  // of the one before it, so connected outlines are cheapest.
+  static void LinesMany(absl::Span<const LinePrim> lines);
+  static void LinesMany(const FbImg& target, absl::Span<const LinePrim> lines);
+  static void RectsMany(absl::Span<const RectPrim> rects);
+  static void RectsMany(const FbImg& target, absl::Span<const RectPrim> rects);
+  static void FillRectsMany(absl::Span<const RectPrim> rects);
+  static void FillRectsMany(const FbImg& target,
+                            absl::Span<const RectPrim> rects);
+
   enum TextHAlign {
     TEXT_ALIGN_H_LEFT = 0,
     TEXT_ALIGN_H_CENTER = 1,
@@ -93,6 +348,12 @@ class FbGfx final {
                             TextHAlign h_align = TEXT_ALIGN_H_LEFT,
                             TextVAlign v_align = TEXT_ALIGN_V_TOP);
 
+  // Draw a paragraph laid out ahead of time, as TextParagraph would draw it.
+  static void Text(const FbTextLayout& layout,
+                   FbColor32 color = FbColor32::WHITE);
+  static void Text(const FbImg& target, const FbTextLayout& layout,
+                   FbColor32 color = FbColor32::WHITE);
+
   static void Put(const FbImg& src, glm::ivec2 p, glm::ivec2 src_a = {-1, -1},
                   glm::ivec2 src_b = {-1, -1});
   static void Put(const FbImg& target, const FbImg& src, glm::ivec2 p,
@@ -123,6 +384,43 @@ class FbGfx final {
   // GetKeyPressed.
   static void SyncInputs();
 
+  // A single input, timestamped with when it happened.
+  struct InputEvent {
+    enum Type {
+      KEY_DOWN,
+      KEY_UP,
+      MOUSE_BUTTON_DOWN,
+      MOUSE_BUTTON_UP,
+      MOUSE_MOTION,
+      MOUSE_WHEEL,
+      QUIT
+    };
+    Type type;
+    std::chrono::steady_clock::time_point time;
+    // The key's SDL_Scancode (comparable to Key) for KEY_ events.
+    int32_t scancode;
+    // The SDL_BUTTON_* for MOUSE_BUTTON_ events.
+    int32_t button;
+    // The cursor position for MOUSE_ events, and the scroll amount in y for
+    // MOUSE_WHEEL.
+    glm::ivec2 p;
+  };
+  static constexpr size_t kInputQueueCapacity = 256;
+  // Moves pending SDL events into the input queue (and the state reported by
+  // GetMouse and Close at the next SyncInputs). SyncInputs pumps too, but
+  // pumping more often, e.g. between simulation ticks or just before drawing,
+  // timestamps events more precisely. If the queue fills, the oldest events
+  // are dropped.
+  static void PumpInputs();
+  // Takes the oldest queued event if it happened before until, returning
+  // false if there isn't one. A fixed-tick simulation can take just the
+  // events that happened by the time each tick simulates up to (see
+  // FbLoop::tick_time).
+  static bool PollInput(
+      InputEvent* event,
+      std::chrono::steady_clock::time_point until =
+          std::chrono::steady_clock::time_point::max());
+
   struct MouseButtonPressedState {
     bool left;
     bool right;
@@ -159,34 +457,219 @@ class FbGfx final {
 
   static void PrepareFont();
 
-  // Using SetRender* methods assumes that CheckInit has already been called.
+  // Using SetRender*/SetTexture* methods assumes that CheckInit has already
+  // been called. These skip redundant changes, counting the rest in
+  // frame_stats_.
+  // Switching to the screen restores the viewport's clip rectangle, which SDL
+  // drops when switching render targets.
   static void SetRenderTarget(SDL_Texture* target);
   static void SetRenderColor(FbColor32 col);
+  static void SetTextureBlendMode(SDL_Texture* texture, SDL_BlendMode mode);
+  static void SetTextureMod(SDL_Texture* texture, FbColor32 mod);
 
-  static void InternalCls(SDL_Texture* texture, FbColor32 col);
-  static void InternalPSet(SDL_Texture* texture, glm::ivec2 p, FbColor32 color);
-  static void InternalLine(SDL_Texture* texture, glm::ivec2 a, glm::ivec2 b,
+  static void CountDraw(uint32_t draw_calls, uint32_t primitives = 1) {
+    frame_stats_.draw_calls += draw_calls;
+    frame_stats_.primitives += primitives;
+  }
+  static void DrawStatsOverlay();
+
+  static bool is_software() { return backend_ == BACKEND_SOFTWARE; }
+  // The pixels drawn to for a target (or the screen if target is nullptr)
+  // when using BACKEND_SOFTWARE.
+  static fbsoft::Surface GetSoftSurface(const FbImg* target);
+  // The whole software screen, regardless of the viewport (which
+  // GetSoftSurface(nullptr) is limited to).
+  static fbsoft::Surface GetSoftScreen();
+  // The offset from the coordinates drawn at to those on target: the
+  // viewport's if target is the screen (nullptr), otherwise none.
+  static glm::ivec2 DrawOffset(const FbImg* target);
+  // True if the rectangle with corners a and b (inclusive, already offset by
+  // DrawOffset) lies entirely outside of what can be drawn to on target, in
+  // which case the primitives it bounds are counted as culled.
+  static bool Culled(const FbImg* target, glm::ivec2 a, glm::ivec2 b,
+                     uint32_t primitives = 1);
+  // Sets the accelerated screen's clip rectangle from the viewport.
+  static void ApplyViewportClip();
+  // Copies the finished frame in screen to the window.
+  static void PresentScreen(SDL_Texture* screen);
+  // Fits the logical resolution into the renderer's output per
+  // present_scale_.
+  static void UpdatePresentRect();
+  // Maps a window position to the logical resolution.
+  static glm::ivec2 ToLogical(int32_t x, int32_t y);
+  // The texture of an image (or nullptr for the screen), reloading it if it
+  // was dropped and marking it as drawn this frame.
+  static SDL_Texture* GetTexture(const FbImg* target);
+
+  // Texture budget bookkeeping for images made with a texture.
+  static void TrackTexture(const FbImg* img);
+  static void UntrackTexture(const FbImg* img);
+  // Drops textures until within budget, called at the end of Flip.
+  static void EnforceTextureBudget();
+
+  // Internal drawing methods draw to the screen when target is nullptr.
+  static void InternalCls(const FbImg* target, FbColor32 col);
+  static void InternalPSet(const FbImg* target, glm::ivec2 p, FbColor32 color);
+  static void InternalLine(const FbImg* target, glm::ivec2 a, glm::ivec2 b,
                            FbColor32 color);
-  static void InternalRect(SDL_Texture* texture, glm::ivec2 a, glm::ivec2 b,
+  static void InternalRect(const FbImg* target, glm::ivec2 a, glm::ivec2 b,
                            FbColor32 color);
-  static void InternalFillRect(SDL_Texture* texture, glm::ivec2 a, glm::ivec2 b,
+  static void InternalFillRect(const FbImg* target, glm::ivec2 a, glm::ivec2 b,
                                FbColor32 color);
-  static void InternalPut(SDL_Texture* dest, SDL_Texture* src,
-                          glm::ivec2 src_dims, glm::ivec2 p, PutOptions opts,
-                          glm::ivec2 src_a, glm::ivec2 src_b);
-  static void InternalTextLine(SDL_Texture* texture, absl::string_view text,
+  static void InternalPSetMany(const FbImg* target,
+                               absl::Span<const PointPrim> points);
+  static void InternalLinesMany(const FbImg* target,
+                                absl::Span<const LinePrim> lines);
+  static void InternalRectsMany(const FbImg* target,
+                                absl::Span<const RectPrim> rects, bool fill);
+  static SDL_BlendMode GetSdlBlendMode(PutOptions::BlendMode m);
+
+  // Resolves the source and destination rectangles of a Put. If any of the
+  // src_a/src_b coordinates are -1, the whole source is used and false is
+  // returned (src_rect still covers the whole source in that case).
+  static bool ComputePutRects(glm::ivec2 src_dims, glm::ivec2 p,
+                              glm::ivec2 src_a, glm::ivec2 src_b,
+                              SDL_Rect* src_rect, SDL_Rect* dst_rect);
+  static void InternalPut(const FbImg* target, const FbImg& src, glm::ivec2 p,
+                          PutOptions opts, glm::ivec2 src_a, glm::ivec2 src_b);
+  static void InternalTextLine(const FbImg* target, absl::string_view text,
                                glm::ivec2 p, FbColor32 color,
                                TextHAlign h_align, TextVAlign v_align);
-  static void InternalTextParagraph(SDL_Texture* texture,
+  static void InternalTextParagraph(const FbImg* target,
                                     absl::string_view text, glm::ivec2 a,
                                     glm::ivec2 b, FbColor32 color,
                                     TextHAlign h_align, TextVAlign v_align);
 
+  // A laid out string: where each character's glyph in basic_font_ is drawn.
+  struct Glyph {
+    glm::ivec2 src_p;
+    glm::ivec2 dst_p;
+  };
+  struct GlyphRun {
+    std::vector<Glyph> glyphs;
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    // The glyphs as SDL_RenderGeometry quads in vertex_color, built as glyphs
+    // are first drawn with BACKEND_ACCELERATED.
+    std::vector<SDL_Vertex> vertices;
+    std::vector<int> indices;
+    int32_t vertex_color = 0;
+    // The draw offset the vertices were last positioned for. Drawing the run
+    // somewhere else moves them once rather than copying them every draw.
+    glm::ivec2 vertex_offset{0, 0};
+#endif
+
+    // Drops the glyphs from index glyph_i on.
+    void Truncate(size_t glyph_i) {
+      if (glyph_i >= glyphs.size()) return;
+      glyphs.resize(glyph_i);
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+      if (vertices.size() > glyph_i * 4) {
+        vertices.resize(glyph_i * 4);
+        indices.resize(glyph_i * 6);
+      }
+#endif
+    }
+  };
+  static const glm::ivec2 kTextCharacterDims;
+  static constexpr size_t kDefaultTextCacheCapacity = 256;
+
+  // What a cached run was laid out from, other than its text. Runs are laid
+  // out at the origin and translated when drawn, so text that moves around
+  // still hits the cache.
+  struct TextKey {
+    bool paragraph;
+    TextHAlign h_align;
+    TextVAlign v_align;
+    // The dimensions of a paragraph's box, less one.
+    glm::ivec2 box_dims;
+    uint32_t color;
+
+    bool operator==(const TextKey& rhs) const {
+      return (paragraph == rhs.paragraph) && (h_align == rhs.h_align) &&
+             (v_align == rhs.v_align) && (box_dims == rhs.box_dims) &&
+             (color == rhs.color);
+    }
+  };
+  struct CachedText {
+    TextKey key;
+    std::string text;
+    GlyphRun run;
+  };
+  static size_t HashText(const TextKey& key, absl::string_view text);
+  // Returns the run cached for key and text, or nullptr if there isn't one.
+  static GlyphRun* FindCachedText(const TextKey& key, absl::string_view text);
+  static GlyphRun* CacheText(const TextKey& key, absl::string_view text,
+                             GlyphRun run);
+  static void LayoutTextLine(absl::string_view text, glm::ivec2 p,
+                             TextHAlign h_align, TextVAlign v_align,
+                             std::vector<Glyph>* glyphs);
+  // Top left of a character's glyph in basic_font_.
+  static glm::ivec2 GlyphSource(char c);
+  // Draws run translated by origin.
+  static void DrawGlyphRun(const FbImg* target, FbColor32 color,
+                           glm::ivec2 origin, GlyphRun* run);
+
+  static void ReplayQueuedDrawLists();
+
   static bool is_init() { return window_.get() != nullptr; }
   static util::deleter_ptr<SDL_Window> window_;
   static util::deleter_ptr<SDL_Renderer> renderer_;
 
+  static Backend backend_;
+  static bool headless_;
+  // With BACKEND_SOFTWARE, the screen is drawn into soft_screen_ which is
+  // uploaded to soft_present_texture_ to be presented.
+  static std::unique_ptr<FbImg> soft_screen_;
+  static util::deleter_ptr<SDL_Texture> soft_present_texture_;
+  // With ScreenOptions::offscreen, the screen is drawn at the logical
+  // resolution (into offscreen_screen_ unless using BACKEND_SOFTWARE) and
+  // copied into present_rect_ of the window in Flip.
+  static bool offscreen_;
+  static ScreenOptions::PresentScale present_scale_;
+  static glm::ivec2 logical_res_;
+  static std::unique_ptr<FbImg> offscreen_screen_;
+  static SDL_Rect present_rect_;
+  static FbViewport viewport_;
+  // False while viewport_ is the default.
+  static bool viewport_set_;
+
+  static std::unique_ptr<FbAtlas> atlas_;
+  static std::unique_ptr<FbImgLoader> loader_;
+  static std::unique_ptr<FbTargetPool> target_pool_;
+  // Only set in Screen, so images can be loaded through it from any thread.
+  static std::unique_ptr<FbImgCache> image_cache_;
+  static std::unique_ptr<FbCapture> capture_;
   static std::unique_ptr<FbImg> basic_font_;
+  // Laid out strings keyed by HashText. Lookups compare the full key, so
+  // hashes that collide just miss.
+  static util::LruCache<size_t, CachedText> text_cache_;
+
+  // Stats for the frame being drawn and the last one completed.
+  static FrameStats frame_stats_;
+  static FrameStats last_frame_stats_;
+  static std::chrono::steady_clock::time_point frame_start_;
+  static bool stats_overlay_;
+
+  // Scratch space for the bulk drawing methods.
+  static std::vector<SDL_Point> point_scratch_;
+  static std::vector<SDL_Rect> rect_scratch_;
+
+  // Images with textures, least recently drawn first, and the bytes of
+  // texture memory they use.
+  static std::list<const FbImg*> texture_lru_;
+  static size_t texture_bytes_;
+  static size_t texture_budget_;
+  static TextureMemoryStats texture_stats_;
+  // Frames completed, for judging how recently textures were drawn.
+  static uint64_t frame_count_;
+
+  struct QueuedDrawList {
+    int32_t order;
+    uint32_t sequence;
+    const FbDrawList* list;
+  };
+  static std::mutex draw_list_queue_mutex_;
+  static std::vector<QueuedDrawList> draw_list_queue_;
 
   static uint32_t input_cycle_;
 
@@ -195,6 +678,14 @@ class FbGfx final {
   static MouseButtonPressedState mouse_button_state_;
   static glm::ivec3 mouse_pointer_position_;
   static bool close_pressed_;
+  // Accumulated by PumpInputs until the next SyncInputs.
+  static MouseButtonPressedState pending_mouse_button_state_;
+  static bool pending_close_pressed_;
+
+  static util::RingBuffer<InputEvent> input_queue_;
+  // When the oldest event taken with PollInput this frame happened.
+  static std::chrono::steady_clock::time_point oldest_polled_input_;
+  static bool polled_input_;
 
   struct Cleanup {
     ~Cleanup() { sdl_util::Cleanup::UnregisterModule(); }
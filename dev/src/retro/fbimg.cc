@@ -2,6 +2,8 @@
 
 #include "glog/logging.h"
 #include "retro/fbgfx.h"
+#include "retro/fbimgcache.h"
+#include "retro/fbsoft.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -14,15 +16,106 @@ using std::unique_ptr;
 using util::deleter_ptr;
 
 namespace retro {
+namespace {
+uint32_t TextureFormat(SDL_Texture* texture) {
+  uint32_t format;
+  CHECK_EQ(SDL_QueryTexture(texture, &format, nullptr, nullptr, nullptr), 0)
+      << "SDL error (SDL_QueryTexture): " << SDL_GetError();
+  return format;
+}
+}  // namespace
+
+FbImg::FbImg(deleter_ptr<SDL_Texture> texture, int w, int h, bool is_target,
+             bool is_streaming,
+             unique_ptr<std::vector<uint32_t>> cpu_copy)
+    : texture_(std::move(texture)),
+      buffer_(nullptr),
+      page_(nullptr),
+      origin_(0, 0),
+      w_(w),
+      h_(h),
+      format_(TextureFormat(texture_.get())),
+      is_target_(is_target),
+      is_streaming_(is_streaming),
+      is_locked_(false),
+      cpu_copy_(std::move(cpu_copy)),
+      last_used_frame_(0) {
+  FbGfx::TrackTexture(this);
+}
+
+FbImg::FbImg(unique_ptr<fbsoft::Buffer> buffer, int w, int h, bool is_target,
+             bool is_streaming)
+    : texture_(nullptr),
+      buffer_(std::move(buffer)),
+      page_(nullptr),
+      origin_(0, 0),
+      w_(w),
+      h_(h),
+      format_(SDL_PIXELFORMAT_RGBA8888),
+      is_target_(is_target),
+      is_streaming_(is_streaming),
+      is_locked_(false),
+      cpu_copy_(nullptr),
+      last_used_frame_(0) {}
+
+FbImg::FbImg(std::shared_ptr<const FbImg> page, ivec2 origin, int w, int h)
+    : texture_(nullptr),
+      buffer_(nullptr),
+      page_(std::move(page)),
+      origin_(origin),
+      w_(w),
+      h_(h),
+      format_(page_->format_),
+      is_target_(false),
+      is_streaming_(false),
+      is_locked_(false),
+      cpu_copy_(nullptr),
+      last_used_frame_(0) {}
+
+FbImg::~FbImg() {
+  if (is_locked_) Unlock();
+  // Only images made with a texture are tracked by the budget.
+  if ((buffer_ == nullptr) && (page_ == nullptr)) FbGfx::UntrackTexture(this);
+}
+
+bool FbImg::is_reloadable() const {
+  const FbImg& img = root();
+  return !img.is_target_ && !img.is_streaming_ && (img.buffer_ == nullptr) &&
+         (!img.source_path_.empty() || (img.cpu_copy_ != nullptr));
+}
 
-FbImg::FbImg(deleter_ptr<SDL_Texture> texture, int w, int h, bool is_target)
-    : texture_(std::move(texture)), w_(w), h_(h), is_target_(is_target) {}
+void FbImg::DropTexture() const {
+  CHECK(is_reloadable()) << "Image texture can't be dropped.";
+  texture_.reset();
+}
+
+void FbImg::ReloadTexture() const {
+  CHECK(is_reloadable()) << "Image texture can't be reloaded.";
+  if (cpu_copy_ != nullptr) {
+    texture_ = TextureFromStbImage(
+        reinterpret_cast<const StbImageData*>(cpu_copy_->data()), {w_, h_});
+    return;
+  }
+  ivec2 dims;
+  deleter_ptr<StbImageData> image_data = LoadStbImage(source_path_, &dims);
+  CHECK((dims.x == w_) && (dims.y == h_))
+      << "Image " << source_path_ << " changed size since it was loaded.";
+  texture_ = TextureFromStbImage(image_data.get(), dims);
+}
 
-unique_ptr<FbImg> FbImg::OfSize(ivec2 dimensions) {
+unique_ptr<FbImg> FbImg::OfSize(ivec2 dimensions, uint32_t format) {
   FbGfx::CheckInit(__func__);
 
+  if (FbGfx::is_software()) {
+    CHECK_EQ(format, static_cast<uint32_t>(SDL_PIXELFORMAT_RGBA8888))
+        << "The software backend only supports RGBA8888 images.";
+    return unique_ptr<FbImg>(
+        new FbImg(std::make_unique<fbsoft::Buffer>(dimensions), dimensions.x,
+                  dimensions.y, true));
+  }
+
   deleter_ptr<SDL_Texture> texture(
-      SDL_CreateTexture(FbGfx::renderer_.get(), SDL_PIXELFORMAT_RGBA8888,
+      SDL_CreateTexture(FbGfx::renderer_.get(), format,
                         SDL_TEXTUREACCESS_TARGET, dimensions.x, dimensions.y),
       [](SDL_Texture* t) { SDL_DestroyTexture(t); });
   CHECK_NE(texture.get(), static_cast<SDL_Texture*>(NULL))
@@ -31,36 +124,127 @@ unique_ptr<FbImg> FbImg::OfSize(ivec2 dimensions) {
       new FbImg(std::move(texture), dimensions.x, dimensions.y, true));
 }
 
-deleter_ptr<SDL_Texture> FbImg::TextureFromSurface(SDL_Surface* surface) {
+unique_ptr<FbImg> FbImg::OfSizeStreaming(ivec2 dimensions) {
+  FbGfx::CheckInit(__func__);
+
+  if (FbGfx::is_software()) {
+    return unique_ptr<FbImg>(
+        new FbImg(std::make_unique<fbsoft::Buffer>(dimensions), dimensions.x,
+                  dimensions.y, false, true));
+  }
+
   deleter_ptr<SDL_Texture> texture(
-      SDL_CreateTextureFromSurface(FbGfx::renderer_.get(), surface),
+      SDL_CreateTexture(FbGfx::renderer_.get(), SDL_PIXELFORMAT_RGBA8888,
+                        SDL_TEXTUREACCESS_STREAMING, dimensions.x,
+                        dimensions.y),
       [](SDL_Texture* t) { SDL_DestroyTexture(t); });
   CHECK_NE(texture.get(), static_cast<SDL_Texture*>(NULL))
-      << "SDL error (SDL_CreateTextureFromSurface): " << SDL_GetError();
-  return std::move(texture);
+      << "SDL error (SDL_CreateTexture): " << SDL_GetError();
+  return unique_ptr<FbImg>(
+      new FbImg(std::move(texture), dimensions.x, dimensions.y, false, true));
 }
 
-unique_ptr<FbImg> FbImg::FromFile(const string& filename) {
-  FbGfx::CheckInit(__func__);
+FbImg::PixelSpan FbImg::Lock() {
+  CHECK(is_streaming_) << "Only streaming images can be locked.";
+  CHECK(!is_locked_) << "Image is already locked.";
+  is_locked_ = true;
+
+  if (FbGfx::is_software()) {
+    const fbsoft::Surface surface = buffer_->surface();
+    return {surface.pixels, surface.w, surface.h, surface.pitch};
+  }
+
+  void* pixels;
+  int pitch;
+  CHECK_EQ(SDL_LockTexture(texture_.get(), nullptr, &pixels, &pitch), 0)
+      << "SDL error (SDL_LockTexture): " << SDL_GetError();
+  return {static_cast<uint32_t*>(pixels), w_, h_,
+          pitch / static_cast<int32_t>(sizeof(uint32_t))};
+}
+
+void FbImg::Unlock() {
+  CHECK(is_locked_) << "Image isn't locked.";
+  is_locked_ = false;
+
+  if (FbGfx::is_software()) return;
+  SDL_UnlockTexture(texture_.get());
+  ++FbGfx::frame_stats_.uploads;
+}
+
+deleter_ptr<SDL_Texture> FbImg::TextureFromStbImage(const StbImageData* data,
+                                                     ivec2 dims) {
+  // ABGR8888 is stb_image's byte order read as a little-endian word.
+  deleter_ptr<SDL_Texture> texture(
+      SDL_CreateTexture(FbGfx::renderer_.get(), SDL_PIXELFORMAT_ABGR8888,
+                        SDL_TEXTUREACCESS_STATIC, dims.x, dims.y),
+      [](SDL_Texture* t) { SDL_DestroyTexture(t); });
+  CHECK_NE(texture.get(), static_cast<SDL_Texture*>(NULL))
+      << "SDL error (SDL_CreateTexture): " << SDL_GetError();
+  CHECK_EQ(SDL_UpdateTexture(texture.get(), nullptr, data,
+                             dims.x * sizeof(uint32_t)),
+           0)
+      << "SDL error (SDL_UpdateTexture): " << SDL_GetError();
+  ++FbGfx::frame_stats_.uploads;
+  return texture;
+}
+
+deleter_ptr<uint8_t> FbImg::LoadRgba(const string& filename, ivec2* dims) {
+  return LoadStbImage(filename, dims);
+}
+
+deleter_ptr<FbImg::StbImageData> FbImg::LoadStbImage(const string& filename,
+                                                     ivec2* dims) {
+  FbImgCache* cache = FbGfx::image_cache_.get();
+  if (cache != nullptr) {
+    deleter_ptr<StbImageData> cached = cache->Load(filename, dims);
+    if (cached != nullptr) return cached;
+  }
 
-  int w;
-  int h;
   int orig_format_unused;
   deleter_ptr<StbImageData> image_data(
-      stbi_load(filename.c_str(), &w, &h, &orig_format_unused, STBI_rgb_alpha),
+      stbi_load(filename.c_str(), &dims->x, &dims->y, &orig_format_unused,
+                STBI_rgb_alpha),
       [](StbImageData* d) { stbi_image_free(d); });
   CHECK_NE(static_cast<void*>(image_data.get()), static_cast<void*>(NULL))
       << "stb_image error (stbi_load): " << stbi_failure_reason();
+  if (cache != nullptr) cache->Store(filename, image_data.get(), *dims);
+  return image_data;
+}
 
-   deleter_ptr<SDL_Surface> surface(
-      SDL_CreateRGBSurfaceWithFormatFrom(image_data.get(), w, h, 32, 4 * w,
-                                         SDL_PIXELFORMAT_ABGR8888),
-      [](SDL_Surface* s) { SDL_FreeSurface(s); });
-  CHECK_NE(surface.get(), static_cast<SDL_Surface*>(NULL))
-      << "SDL error (SDL_CreateRGBSurfaceWithFormatFrom): " << SDL_GetError();
+void FbImg::CopyStbImage(const StbImageData* data, ivec2 dims,
+                         const fbsoft::Surface& dst) {
+  // stb_image gives us R, G, B, A bytes, which read as a big-endian word are
+  // exactly RGBA8888.
+  const uint32_t* src = reinterpret_cast<const uint32_t*>(data);
+  for (int y = 0; y < dims.y; ++y) {
+    fbsoft::Pixel* dst_row = dst.row(y);
+    for (int x = 0; x < dims.x; ++x) dst_row[x] = SDL_SwapBE32(*(src++));
+  }
+}
 
-  return unique_ptr<FbImg>(
-      new FbImg(TextureFromSurface(surface.get()), w, h, false));
+unique_ptr<FbImg> FbImg::FromFile(const string& filename) {
+  FbGfx::CheckInit(__func__);
+
+  ivec2 dims;
+  deleter_ptr<StbImageData> image_data = LoadStbImage(filename, &dims);
+  return FromStbImage(image_data.get(), dims, filename);
+}
+
+unique_ptr<FbImg> FbImg::FromStbImage(const StbImageData* data, ivec2 dims,
+                                      const string& source_path) {
+  const int w = dims.x;
+  const int h = dims.y;
+
+  if (FbGfx::is_software()) {
+    auto buffer = std::make_unique<fbsoft::Buffer>(dims);
+    CopyStbImage(data, dims, buffer->surface());
+    return unique_ptr<FbImg>(new FbImg(std::move(buffer), w, h, false));
+  }
+
+  unique_ptr<FbImg> img(
+      new FbImg(TextureFromStbImage(data, dims), w, h, false));
+  img->source_path_ = source_path;
+  return img;
 }
 
 }  // namespace retro
@@ -1,8 +1,11 @@
 #ifndef RETRO_FBIMG_H_
 #define RETRO_FBIMG_H_
 
+#include <stdint.h>
+#include <list>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "SDL.h"
 #include "absl/strings/string_view.h"
@@ -14,41 +17,167 @@
 
 namespace retro {
 
+class FbAtlas;
+class FbBatch;
+class FbDrawList;
 class FbGfx;
+class FbImgLoader;
+class FbPalImg;
+namespace fbsoft {
+class Buffer;
+struct Surface;
+}  // namespace fbsoft
 // Fixed size 32bit image class, basically a wrapper around SDL_Texture and an
-// image loading library.
+// image loading library. With FbGfx::BACKEND_SOFTWARE, images instead hold
+// their pixels in a fbsoft::Buffer.
+//
+// Streaming images (from OfSizeStreaming) are written directly by the CPU
+// instead of drawn to: Lock them, fill in their pixels, then Unlock to upload.
+//
+// Textures count against FbGfx's texture budget (see
+// FbGfx::SetTextureBudget), which may drop the textures of images that can be
+// reloaded (those loaded from files, and atlas pages keeping a CPU copy of
+// their pixels) when they haven't been drawn for a while. Dropped textures are
+// reloaded transparently the next time they're drawn.
+//
+// An image can also be a view of a sub-rectangle of an atlas page (see
+// FbAtlas), in which case it shares the page's texture with the other images
+// on the page.
 class FbImg : public util::NonCopyable {
+  friend class FbAtlas;
+  friend class FbBatch;
+  friend class FbDrawList;
   friend class FbGfx;
+  friend class FbImgLoader;
+  friend class FbPalImg;
+  friend class FbRenderQueue;
 
  public:
-  virtual ~FbImg() {}
+  virtual ~FbImg();
 
   // Load an image from a file.
   static std::unique_ptr<FbImg> FromFile(const std::string& filename);
   // Create an image of the provided dimensions. The contents of the texture
-  // are undefined and should be cleared/filled-entirely before use.
-  static std::unique_ptr<FbImg> OfSize(glm::ivec2 dimensions);
+  // are undefined and should be cleared/filled-entirely before use. format is
+  // the texture's SDL_PixelFormatEnum; the software backend only supports
+  // SDL_PIXELFORMAT_RGBA8888.
+  static std::unique_ptr<FbImg> OfSize(
+      glm::ivec2 dimensions, uint32_t format = SDL_PIXELFORMAT_RGBA8888);
+  // Create an image of the provided dimensions whose pixels are written
+  // through Lock/Unlock. It can be drawn, but not drawn to.
+  static std::unique_ptr<FbImg> OfSizeStreaming(glm::ivec2 dimensions);
+
+  // Decode an image file to RGBA bytes (rows packed), through FbGfx's image
+  // cache if it has one, for code that works on an image's pixels on the CPU.
+  // Images don't keep their pixels once uploaded. Safe to call from any
+  // thread.
+  static util::deleter_ptr<uint8_t> LoadRgba(const std::string& filename,
+                                             glm::ivec2* dims);
+
+  // Locked pixels of a streaming image, as RGBA8888 words (the layout of
+  // FbColor32::value).
+  struct PixelSpan {
+    uint32_t* pixels;
+    int32_t w;
+    int32_t h;
+    // The distance between the starts of consecutive rows in pixels.
+    int32_t pitch;
+
+    uint32_t* row(int32_t y) const { return pixels + y * pitch; }
+  };
+  // Lock a streaming image's pixels for writing. As with SDL streaming
+  // textures, the span is write-only: what it holds on Lock is undefined, so
+  // every pixel that matters must be written before Unlock. The image must not
+  // be drawn while locked.
+  PixelSpan Lock();
+  // Upload the pixels written since Lock.
+  void Unlock();
 
   int width() const { return w_; }
   int height() const { return h_; }
   bool is_render_target() const { return is_target_; }
+  bool is_atlas_view() const { return page_ != nullptr; }
+  bool is_streaming() const { return is_streaming_; }
+  bool is_locked() const { return is_locked_; }
+  // True if the image's texture can be dropped and later reloaded.
+  bool is_reloadable() const;
+  // True unless the image's texture was dropped to stay within budget.
+  bool is_resident() const { return root().texture_ != nullptr; }
 
  private:
   typedef unsigned char StbImageData;
-  FbImg(util::deleter_ptr<SDL_Texture> texture, int w, int h, bool is_target);
+  FbImg(util::deleter_ptr<SDL_Texture> texture, int w, int h, bool is_target,
+        bool is_streaming = false,
+        std::unique_ptr<std::vector<uint32_t>> cpu_copy = nullptr);
+  FbImg(std::unique_ptr<fbsoft::Buffer> buffer, int w, int h, bool is_target,
+        bool is_streaming = false);
+  // A view of the w x h area at origin in page.
+  FbImg(std::shared_ptr<const FbImg> page, glm::ivec2 origin, int w, int h);
 
-  static util::deleter_ptr<SDL_Texture> TextureFromSurface(
-      SDL_Surface* surface);
+  // Loads a file as RGBA bytes, through FbGfx's image cache if it has one.
+  // Safe to call from any thread.
+  static util::deleter_ptr<StbImageData> LoadStbImage(
+      const std::string& filename, glm::ivec2* dims);
+  // Creates a standalone image from RGBA bytes. Must be called from the
+  // render thread.
+  // source_path, if not empty, is the file data came from, which the texture
+  // is reloaded from if dropped.
+  static std::unique_ptr<FbImg> FromStbImage(
+      const StbImageData* data, glm::ivec2 dims,
+      const std::string& source_path = "");
+  // Copies RGBA bytes into the top left of a software surface.
+  static void CopyStbImage(const StbImageData* data, glm::ivec2 dims,
+                           const fbsoft::Surface& dst);
+
+  // Creates a static texture from RGBA bytes (stb_image's byte order).
+  static util::deleter_ptr<SDL_Texture> TextureFromStbImage(
+      const StbImageData* data, glm::ivec2 dims);
+
+  // Texture budget support: the bytes of texture memory the image uses when
+  // resident, and dropping/recreating its texture.
+  size_t texture_bytes() const {
+    return static_cast<size_t>(w_) * h_ * SDL_BYTESPERPIXEL(format_);
+  }
+  void DropTexture() const;
+  // Recreates a dropped texture. This decodes the image from its source file
+  // if it has no CPU copy, synchronously on the render thread in the middle
+  // of whatever draw needed it; FrameStats::reload_seconds shows the cost.
+  void ReloadTexture() const;
 
   void CheckTarget(absl::string_view meth_name) const {
     CHECK(is_target_) << "Image cannot be the target of drawing operation "
                       << meth_name << ".";
   }
 
-  const util::deleter_ptr<SDL_Texture> texture_;
+  // The image holding this image's pixels: its page if this is an atlas view,
+  // otherwise itself.
+  const FbImg& root() const { return page_ != nullptr ? *page_ : *this; }
+
+  // Exactly one of texture_ and buffer_ is set (depending on the backend)
+  // unless this is an atlas view, in which case page_ is set instead, or
+  // texture_ was dropped by the texture budget.
+  mutable util::deleter_ptr<SDL_Texture> texture_;
+  const std::unique_ptr<fbsoft::Buffer> buffer_;
+  const std::shared_ptr<const FbImg> page_;
+  // Top left of this image in root().
+  const glm::ivec2 origin_;
   const int w_;
   const int h_;
+  // The SDL_PixelFormatEnum of the pixels.
+  const uint32_t format_;
   const bool is_target_;
+  const bool is_streaming_;
+  bool is_locked_;
+
+  // Where a dropped texture is reloaded from: the file it was loaded from,
+  // or a copy of its pixels as RGBA bytes (kept by atlas pages).
+  std::string source_path_;
+  const std::unique_ptr<std::vector<uint32_t>> cpu_copy_;
+
+  // This image's entry in FbGfx's least recently used list of textures, and
+  // the frame it was last drawn in.
+  mutable std::list<const FbImg*>::iterator lru_entry_;
+  mutable uint64_t last_used_frame_;
 };
 
 }  // namespace retro
@@ -0,0 +1,160 @@
+#include "retro/fbimgcache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <system_error>
+#include <thread>
+
+#include "absl/strings/str_cat.h"
+#include "glog/logging.h"
+#include "util/mappedfile.h"
+
+using glm::ivec2;
+using std::string;
+using util::deleter_ptr;
+
+namespace fs = std::filesystem;
+
+namespace retro {
+namespace {
+
+constexpr char kMagic[8] = {'F', 'B', 'I', 'M', 'G', 'C', '0', '1'};
+
+// Precedes the image's path (padded to a multiple of 4 bytes) and then its
+// pixels in an entry.
+struct EntryHeader {
+  char magic[8];
+  // The image file's size and modification time when it was decoded.
+  uint64_t source_size;
+  int64_t source_mtime;
+  int32_t w;
+  int32_t h;
+  uint32_t path_size;
+  uint32_t reserved;
+};
+
+size_t PaddedPathSize(size_t path_size) { return (path_size + 3) & ~3; }
+
+// Reads the size and modification time of the file at path.
+bool StatSource(const string& path, uint64_t* size, int64_t* mtime) {
+  std::error_code error;
+  *size = fs::file_size(path, error);
+  if (error) return false;
+  *mtime = fs::last_write_time(path, error).time_since_epoch().count();
+  return !error;
+}
+
+// 64-bit FNV-1a, stable across runs and platforms unlike std::hash.
+uint64_t HashPath(const string& path) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (const char c : path) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+}  // namespace
+
+FbImgCache::FbImgCache(string dir) : dir_(std::move(dir)) {
+  std::error_code error;
+  fs::create_directories(dir_, error);
+  if (error) {
+    LOG(WARNING) << "Couldn't create image cache directory " << dir_ << ": "
+                 << error.message();
+  }
+}
+
+string FbImgCache::EntryPath(const string& filename) const {
+  return (fs::path(dir_) / absl::StrCat(absl::Hex(HashPath(filename),
+                                                  absl::kZeroPad16),
+                                        ".rgba"))
+      .string();
+}
+
+deleter_ptr<uint8_t> FbImgCache::Load(const string& filename,
+                                      ivec2* dims) const {
+  uint64_t source_size;
+  int64_t source_mtime;
+  if (!StatSource(filename, &source_size, &source_mtime)) return nullptr;
+
+  auto entry_or = util::MappedFile::Open(EntryPath(filename));
+  // Not cached.
+  if (!entry_or.ok()) return nullptr;
+  std::shared_ptr<util::MappedFile> entry(entry_or.ConsumeValue());
+
+  EntryHeader header;
+  if (entry->size() < sizeof(header)) return nullptr;
+  memcpy(&header, entry->data(), sizeof(header));
+  if ((memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) ||
+      (header.source_size != source_size) ||
+      (header.source_mtime != source_mtime) || (header.w <= 0) ||
+      (header.h <= 0)) {
+    return nullptr;
+  }
+  const size_t pixels_offset =
+      sizeof(header) + PaddedPathSize(header.path_size);
+  const size_t pixels_size = static_cast<size_t>(header.w) * header.h * 4;
+  // A different path with the same hash, or a truncated entry.
+  if ((entry->size() != pixels_offset + pixels_size) ||
+      (filename.compare(0, string::npos,
+                        reinterpret_cast<const char*>(entry->data()) +
+                            sizeof(header),
+                        header.path_size) != 0)) {
+    return nullptr;
+  }
+
+  *dims = {header.w, header.h};
+  // The pixels are a view into the mapping, which lives as long as they do.
+  return deleter_ptr<uint8_t>(
+      const_cast<uint8_t*>(entry->data() + pixels_offset),
+      [entry](uint8_t*) {});
+}
+
+void FbImgCache::Store(const string& filename, const uint8_t* data,
+                       ivec2 dims) const {
+  EntryHeader header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  if (!StatSource(filename, &header.source_size, &header.source_mtime)) {
+    return;
+  }
+  header.w = dims.x;
+  header.h = dims.y;
+  header.path_size = static_cast<uint32_t>(filename.size());
+  header.reserved = 0;
+
+  const string entry_path = EntryPath(filename);
+  // Unique per thread, so concurrent stores of the same image don't
+  // interleave their writes.
+  const string temp_path = absl::StrCat(
+      entry_path, ".",
+      absl::Hex(std::hash<std::thread::id>()(std::this_thread::get_id())),
+      ".tmp");
+
+  FILE* file = fopen(temp_path.c_str(), "wb");
+  if (file == nullptr) {
+    LOG(WARNING) << "Couldn't write image cache entry " << temp_path;
+    return;
+  }
+  const char padding[4] = {0, 0, 0, 0};
+  const size_t pixels_size = static_cast<size_t>(dims.x) * dims.y * 4;
+  const size_t padding_size = PaddedPathSize(filename.size()) - filename.size();
+  const bool written =
+      (fwrite(&header, sizeof(header), 1, file) == 1) &&
+      (fwrite(filename.data(), 1, filename.size(), file) == filename.size()) &&
+      (fwrite(padding, 1, padding_size, file) == padding_size) &&
+      (fwrite(data, 1, pixels_size, file) == pixels_size);
+  const bool closed = fclose(file) == 0;
+
+  std::error_code error;
+  if (written && closed) fs::rename(temp_path, entry_path, error);
+  if (!written || !closed || error) {
+    LOG(WARNING) << "Couldn't write image cache entry " << entry_path;
+    fs::remove(temp_path, error);
+  }
+}
+
+}  // namespace retro
@@ -0,0 +1,48 @@
+#ifndef RETRO_FBIMGCACHE_H_
+#define RETRO_FBIMGCACHE_H_
+
+#include <stdint.h>
+#include <string>
+
+#include "glm/vec2.hpp"
+#include "util/deleterptr.h"
+#include "util/noncopyable.h"
+
+namespace retro {
+
+// An on-disk cache of decoded images, so that images don't have to be
+// decompressed again on every launch. Each image's RGBA bytes are stored raw
+// in a file of dir named for a hash of its path, along with the size and
+// modification time the image file had when decoded; an entry is only used
+// if they still match. Cached images are read by memory mapping, so loading
+// one costs about as much as reading it off disk.
+//
+// Entries are written through a temporary file and renamed into place, so
+// the cache can be used from any number of threads (and processes) at once.
+// Nothing is ever evicted: clear dir to reclaim the space.
+class FbImgCache : public util::NonCopyable {
+ public:
+  // dir is created if it doesn't exist.
+  explicit FbImgCache(std::string dir);
+
+  // Returns the cached RGBA bytes of the image at filename, and its
+  // dimensions in dims, or nullptr if there's no fresh entry for it.
+  util::deleter_ptr<uint8_t> Load(const std::string& filename,
+                                  glm::ivec2* dims) const;
+  // Caches the RGBA bytes of the image at filename. Failing to write the
+  // entry is logged but otherwise ignored.
+  void Store(const std::string& filename, const uint8_t* data,
+             glm::ivec2 dims) const;
+
+  const std::string& dir() const { return dir_; }
+
+ private:
+  // Where filename's entry lives.
+  std::string EntryPath(const std::string& filename) const;
+
+  const std::string dir_;
+};
+
+}  // namespace retro
+
+#endif  // RETRO_FBIMGCACHE_H_
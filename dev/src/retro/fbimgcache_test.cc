@@ -0,0 +1,99 @@
+#include "retro/fbimgcache.h"
+
+#include <stdio.h>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace retro {
+namespace {
+
+namespace fs = std::filesystem;
+
+class FbImgCacheTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    dir_ = testing::TempDir() + "fbimgcache_test";
+    fs::remove_all(dir_);
+    source_ = testing::TempDir() + "fbimgcache_test_source.png";
+    WriteSource("not really a png");
+  }
+  void TearDown() override {
+    fs::remove_all(dir_);
+    fs::remove(source_);
+  }
+
+  void WriteSource(const std::string& contents) {
+    FILE* file = fopen(source_.c_str(), "wb");
+    fwrite(contents.data(), 1, contents.size(), file);
+    fclose(file);
+  }
+
+  std::string dir_;
+  std::string source_;
+};
+
+const std::vector<uint8_t> kPixels = {1, 2,  3,  4,  5,  6,  7,  8,
+                                      9, 10, 11, 12, 13, 14, 15, 16,
+                                      17, 18, 19, 20, 21, 22, 23, 24};
+
+}  // namespace
+
+TEST_F(FbImgCacheTest, load_missesUncached) {
+  FbImgCache cache(dir_);
+  glm::ivec2 dims;
+  EXPECT_EQ(cache.Load(source_, &dims), nullptr);
+}
+
+TEST_F(FbImgCacheTest, store_load_roundTrips) {
+  FbImgCache cache(dir_);
+  cache.Store(source_, kPixels.data(), {3, 2});
+
+  glm::ivec2 dims;
+  auto pixels = cache.Load(source_, &dims);
+  ASSERT_NE(pixels, nullptr);
+  EXPECT_EQ(dims, glm::ivec2(3, 2));
+  EXPECT_EQ(std::vector<uint8_t>(pixels.get(), pixels.get() + kPixels.size()),
+            kPixels);
+}
+
+TEST_F(FbImgCacheTest, load_survivesNewCache) {
+  FbImgCache(dir_).Store(source_, kPixels.data(), {2, 3});
+
+  glm::ivec2 dims;
+  EXPECT_NE(FbImgCache(dir_).Load(source_, &dims), nullptr);
+  EXPECT_EQ(dims, glm::ivec2(2, 3));
+}
+
+TEST_F(FbImgCacheTest, load_missesChangedSource) {
+  FbImgCache cache(dir_);
+  cache.Store(source_, kPixels.data(), {3, 2});
+  WriteSource("a longer not really a png");
+
+  glm::ivec2 dims;
+  EXPECT_EQ(cache.Load(source_, &dims), nullptr);
+}
+
+TEST_F(FbImgCacheTest, load_missesTouchedSource) {
+  FbImgCache cache(dir_);
+  cache.Store(source_, kPixels.data(), {3, 2});
+  fs::last_write_time(source_,
+                      fs::last_write_time(source_) + std::chrono::hours(1));
+
+  glm::ivec2 dims;
+  EXPECT_EQ(cache.Load(source_, &dims), nullptr);
+}
+
+TEST_F(FbImgCacheTest, load_missesMissingSource) {
+  FbImgCache cache(dir_);
+  cache.Store(source_, kPixels.data(), {3, 2});
+  fs::remove(source_);
+
+  glm::ivec2 dims;
+  EXPECT_EQ(cache.Load(source_, &dims), nullptr);
+}
+
+}  // namespace retro
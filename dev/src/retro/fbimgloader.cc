@@ -0,0 +1,81 @@
+#include "retro/fbimgloader.h"
+
+#include "glog/logging.h"
+#include "retro/fbatlas.h"
+#include "retro/fbgfx.h"
+
+using glm::ivec2;
+using std::string;
+
+namespace retro {
+
+FbImgLoader::FbImgLoader(FbAtlas* atlas, uint32_t worker_count)
+    : atlas_(atlas), pending_(0), next_worker_(0) {
+  CHECK_GT(worker_count, 0) << "FbImgLoader needs at least one worker.";
+  for (uint32_t i = 0; i < worker_count; ++i) {
+    workers_.push_back(std::make_unique<thread::WorkQueue>(kWorkerQueueLength));
+  }
+}
+
+FbImgLoader::~FbImgLoader() {
+  // Join the workers first, as their work refers to the decoded queue.
+  workers_.clear();
+}
+
+std::shared_ptr<FbImgLoader::Handle> FbImgLoader::Load(const string& filename,
+                                                      DecodedFunc on_decoded) {
+  std::shared_ptr<Handle> handle(new Handle(filename));
+  pending_.fetch_add(1, std::memory_order_relaxed);
+  const uint32_t worker =
+      next_worker_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+  workers_[worker]->AddWork([this, handle, on_decoded]() {
+    Decoded decoded{handle, nullptr, {0, 0}};
+    decoded.data = FbImg::LoadStbImage(handle->filename(), &decoded.dims);
+    if (on_decoded) on_decoded(decoded.data.get(), decoded.dims);
+    {
+      std::lock_guard<std::mutex> lock(decoded_mutex_);
+      decoded_.push_back(std::move(decoded));
+    }
+    decoded_cv_.notify_all();
+  });
+  return handle;
+}
+
+int32_t FbImgLoader::Upload(int32_t max_uploads) {
+  FbGfx::CheckInit(__func__);
+  std::vector<Decoded> uploads;
+  {
+    std::lock_guard<std::mutex> lock(decoded_mutex_);
+    if ((max_uploads < 0) || (max_uploads >= decoded_.size())) {
+      uploads.swap(decoded_);
+    } else {
+      uploads.insert(uploads.end(), std::make_move_iterator(decoded_.begin()),
+                     std::make_move_iterator(decoded_.begin() + max_uploads));
+      decoded_.erase(decoded_.begin(), decoded_.begin() + max_uploads);
+    }
+  }
+
+  for (Decoded& decoded : uploads) {
+    Handle& handle = *decoded.handle;
+    handle.img_ = atlas_ != nullptr
+                      ? atlas_->FromStbImage(decoded.data.get(), decoded.dims,
+                                             handle.filename())
+                      : FbImg::FromStbImage(decoded.data.get(), decoded.dims,
+                                            handle.filename());
+    handle.ready_.store(true, std::memory_order_release);
+  }
+  pending_.fetch_sub(uploads.size(), std::memory_order_relaxed);
+  return static_cast<int32_t>(uploads.size());
+}
+
+void FbImgLoader::Wait(const Handle& handle) {
+  while (!handle.ready()) {
+    {
+      std::unique_lock<std::mutex> lock(decoded_mutex_);
+      decoded_cv_.wait(lock, [this]() { return !decoded_.empty(); });
+    }
+    Upload();
+  }
+}
+
+}  // namespace retro
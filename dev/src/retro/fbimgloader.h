@@ -0,0 +1,122 @@
+#ifndef RETRO_FBIMGLOADER_H_
+#define RETRO_FBIMGLOADER_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "glm/vec2.hpp"
+#include "retro/fbimg.h"
+#include "thread/workqueue.h"
+#include "util/deleterptr.h"
+#include "util/noncopyable.h"
+
+namespace retro {
+
+class FbAtlas;
+// Loads images without stalling the render thread: files are read and decoded
+// on worker threads, and only the final texture upload is left for the render
+// thread (in Upload, which FbGfx::Flip calls for FbGfx::GetLoader()).
+//
+//   auto handle = FbGfx::GetLoader().Load("res/sprites.png");
+//   ...
+//   if (handle->ready()) FbGfx::Put(handle->img(), p);
+//
+// Load may be called from any thread, everything else only from the thread
+// that called FbGfx::Screen.
+class FbImgLoader : public util::NonCopyable {
+ public:
+  static constexpr uint32_t kDefaultWorkerCount = 2;
+
+  // The state of a single load.
+  class Handle : public util::NonCopyable {
+    friend class FbImgLoader;
+
+   public:
+    // True once the image has been uploaded.
+    bool ready() const { return ready_.load(std::memory_order_acquire); }
+
+    // Only valid once ready.
+    const FbImg& img() const {
+      CHECK(ready()) << "Image " << filename_ << " isn't loaded yet.";
+      CHECK(img_) << "Image " << filename_ << " was released.";
+      return *img_;
+    }
+    // Take ownership of the image. Only valid once ready.
+    std::unique_ptr<FbImg> Release() {
+      img();
+      return std::move(img_);
+    }
+
+    const std::string& filename() const { return filename_; }
+
+   private:
+    explicit Handle(const std::string& filename)
+        : filename_(filename), ready_(false) {}
+
+    const std::string filename_;
+    std::unique_ptr<FbImg> img_;
+    std::atomic_bool ready_;
+  };
+
+  // Images are packed into atlas, unless it's nullptr, in which case they're
+  // loaded as standalone images. The atlas must outlive the loader.
+  explicit FbImgLoader(FbAtlas* atlas = nullptr,
+                       uint32_t worker_count = kDefaultWorkerCount);
+  // Blocks until in flight decodes finish. Images not yet uploaded are
+  // dropped.
+  ~FbImgLoader();
+
+  // Called on a worker thread with an image's decoded RGBA bytes (in
+  // stb_image's byte order, rows packed) before it's queued for upload, for
+  // deriving data from its pixels without reading them back from the texture.
+  // Anything it writes is visible to the render thread once the handle is
+  // ready.
+  typedef std::function<void(const uint8_t* rgba, glm::ivec2 dims)>
+      DecodedFunc;
+
+  // Starts loading an image file.
+  std::shared_ptr<Handle> Load(const std::string& filename,
+                               DecodedFunc on_decoded = nullptr);
+
+  // Uploads up to max_uploads (or all, if -1) decoded images, returning the
+  // number uploaded.
+  int32_t Upload(int32_t max_uploads = -1);
+
+  // Blocks until handle (which must come from this loader) is ready,
+  // uploading images as they're decoded.
+  void Wait(const Handle& handle);
+
+  // Number of loads started but not yet uploaded.
+  uint32_t pending() const { return pending_.load(std::memory_order_relaxed); }
+
+ private:
+  static constexpr uint32_t kWorkerQueueLength = 64;
+
+  struct Decoded {
+    std::shared_ptr<Handle> handle;
+    util::deleter_ptr<FbImg::StbImageData> data;
+    glm::ivec2 dims;
+  };
+
+  FbAtlas* const atlas_;
+
+  std::atomic_uint32_t pending_;
+
+  std::mutex decoded_mutex_;
+  std::condition_variable decoded_cv_;
+  std::vector<Decoded> decoded_;
+
+  std::atomic_uint32_t next_worker_;
+  // Declared last so that workers finish before the rest is destroyed.
+  std::vector<std::unique_ptr<thread::WorkQueue>> workers_;
+};
+
+}  // namespace retro
+
+#endif  // RETRO_FBIMGLOADER_H_
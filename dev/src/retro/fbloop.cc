@@ -0,0 +1,107 @@
+#include "retro/fbloop.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <utility>
+
+#include "glog/logging.h"
+#include "retro/fbgfx.h"
+
+namespace retro {
+
+FbLoop::FbLoop(const Options& options)
+    : options_(options),
+      tick_seconds_(1.0 / options.tick_rate),
+      refresh_rate_(options.refresh_rate < 0 ? 0 : options.refresh_rate),
+      stopped_(false),
+      accumulator_(0),
+      ticks_(0),
+      dropped_ticks_(0) {
+  CHECK_GT(options_.tick_rate, 0) << "Tick rate must be positive.";
+  CHECK_GT(options_.max_ticks_per_frame, 0u)
+      << "At least one tick must be allowed per frame.";
+  CHECK_GT(options_.sync_interval_ticks, 0u)
+      << "Sync interval must be at least one tick.";
+}
+
+FbLoop& FbLoop::SetTick(TickFunc tick) {
+  tick_ = std::move(tick);
+  return *this;
+}
+
+FbLoop& FbLoop::SetDraw(DrawFunc draw) {
+  draw_ = std::move(draw);
+  return *this;
+}
+
+FbLoop& FbLoop::SetSync(SyncFunc sync) {
+  sync_ = std::move(sync);
+  return *this;
+}
+
+void FbLoop::Stop() { stopped_ = true; }
+
+double FbLoop::SnapToVsync(double elapsed_seconds) const {
+  if (refresh_rate_ <= 0) return elapsed_seconds;
+  const double refresh_seconds = 1.0 / refresh_rate_;
+  const double refreshes = std::round(elapsed_seconds / refresh_seconds);
+  if (refreshes < 1) return elapsed_seconds;
+  const double snapped = refreshes * refresh_seconds;
+  return std::abs(elapsed_seconds - snapped) <= options_.vsync_tolerance_seconds
+             ? snapped
+             : elapsed_seconds;
+}
+
+uint32_t FbLoop::Advance(double elapsed_seconds,
+                         std::chrono::steady_clock::time_point now) {
+  elapsed_seconds = SnapToVsync(
+      std::min(std::max(elapsed_seconds, 0.0), options_.max_frame_seconds));
+  accumulator_ += elapsed_seconds;
+
+  uint32_t ran = 0;
+  while ((accumulator_ >= tick_seconds_) && !stopped_) {
+    if (ran == options_.max_ticks_per_frame) {
+      // Spiral of death averted: give up on catching up.
+      const double dropped = std::floor(accumulator_ / tick_seconds_);
+      dropped_ticks_ += static_cast<uint64_t>(dropped);
+      accumulator_ -= dropped * tick_seconds_;
+      break;
+    }
+    accumulator_ -= tick_seconds_;
+    // Ticks lag real time by whatever is left in the accumulator.
+    tick_time_ = now - std::chrono::duration_cast<
+                           std::chrono::steady_clock::duration>(
+                           std::chrono::duration<double>(accumulator_));
+    if (tick_) tick_(tick_seconds_);
+    ++ran;
+    ++ticks_;
+    if (sync_ && ((ticks_ % options_.sync_interval_ticks) == 0)) sync_();
+  }
+  return ran;
+}
+
+void FbLoop::Run() {
+  if (options_.refresh_rate < 0) refresh_rate_ = FbGfx::GetRefreshRate();
+  stopped_ = false;
+
+  auto last = std::chrono::steady_clock::now();
+  while (!stopped_) {
+    const auto now = std::chrono::steady_clock::now();
+    const std::chrono::duration<double> elapsed = now - last;
+    last = now;
+
+    FbGfx::SyncInputs();
+    if (FbGfx::Close()) break;
+
+    Advance(elapsed.count(), now);
+    if (stopped_) break;
+
+    // Catch input that arrived while ticking, so drawing reflects it.
+    FbGfx::PumpInputs();
+    if (draw_) draw_(alpha());
+    FbGfx::Flip();
+  }
+}
+
+}  // namespace retro
@@ -0,0 +1,151 @@
+#ifndef RETRO_FBLOOP_H_
+#define RETRO_FBLOOP_H_
+
+#include <stdint.h>
+#include <chrono>
+#include <functional>
+
+#include "util/noncopyable.h"
+
+namespace retro {
+
+// A main loop that advances simulation in fixed size ticks and draws once per
+// displayed frame:
+//
+//   FbLoop loop;
+//   loop.SetTick([&](double dt) { world.Step(dt); })
+//       .SetDraw([&](double alpha) { world.Draw(alpha); })
+//       .SetSync([&]() { audio.Sync(); });
+//   loop.Run();
+//
+// Ticks should take input with FbGfx::PollInput(&event, loop.tick_time()) so
+// that each tick sees just the input that happened by the time it simulates
+// up to, in order, instead of everything since the last frame.
+//
+// Real time elapsed between frames is accumulated and spent in ticks of
+// 1 / tick_rate seconds; whatever is left over is passed to the draw function
+// as alpha, the fraction of a tick that has elapsed since the last one, so
+// that it can interpolate between the last two simulated states.
+//
+// Frame times within vsync_tolerance_seconds of a whole number of display
+// refreshes are snapped to it, so that timer jitter doesn't cause ticks to
+// sometimes run twice and sometimes not at all in a frame when the tick rate
+// matches the refresh rate, and a missed vsync simply counts as two
+// refreshes. To keep a slow frame from causing more slow frames, at most
+// max_ticks_per_frame ticks are run per frame and time beyond that is
+// dropped.
+//
+// Like FbGfx, this can only be used from the thread that called
+// FbGfx::Screen.
+class FbLoop : public util::NonCopyable {
+ public:
+  struct Options {
+   public:
+    Options()
+        : tick_rate(60),
+          max_ticks_per_frame(5),
+          max_frame_seconds(0.25),
+          refresh_rate(-1),
+          vsync_tolerance_seconds(0.002),
+          sync_interval_ticks(1) {}
+    // Ticks per second.
+    double tick_rate;
+    uint32_t max_ticks_per_frame;
+    // Frames longer than this (a breakpoint, the window being dragged) are
+    // treated as being this long.
+    double max_frame_seconds;
+    // The display's refresh rate in Hz used when snapping frame times, or 0
+    // to disable snapping. If -1, FbGfx::GetRefreshRate() is used.
+    int32_t refresh_rate;
+    double vsync_tolerance_seconds;
+    // The sync function is called after every this many ticks.
+    uint32_t sync_interval_ticks;
+
+    Options& SetTickRate(double tick_rate) {
+      this->tick_rate = tick_rate;
+      return *this;
+    }
+    Options& SetMaxTicksPerFrame(uint32_t max_ticks_per_frame) {
+      this->max_ticks_per_frame = max_ticks_per_frame;
+      return *this;
+    }
+    Options& SetMaxFrameSeconds(double max_frame_seconds) {
+      this->max_frame_seconds = max_frame_seconds;
+      return *this;
+    }
+    Options& SetRefreshRate(int32_t refresh_rate) {
+      this->refresh_rate = refresh_rate;
+      return *this;
+    }
+    Options& SetVsyncToleranceSeconds(double vsync_tolerance_seconds) {
+      this->vsync_tolerance_seconds = vsync_tolerance_seconds;
+      return *this;
+    }
+    Options& SetSyncIntervalTicks(uint32_t sync_interval_ticks) {
+      this->sync_interval_ticks = sync_interval_ticks;
+      return *this;
+    }
+  };
+
+  // Advances simulation by dt seconds (always 1 / tick_rate).
+  typedef std::function<void(double dt)> TickFunc;
+  // Draws the frame, alpha in [0, 1) of the way from the previous tick's
+  // state to the current tick's.
+  typedef std::function<void(double alpha)> DrawFunc;
+  // Called on a steady cadence of simulated (not real) time, for consumers
+  // like audio::AudioSystem::Sync that need to be fed regularly.
+  typedef std::function<void()> SyncFunc;
+
+  explicit FbLoop(const Options& options = Options());
+
+  FbLoop& SetTick(TickFunc tick);
+  FbLoop& SetDraw(DrawFunc draw);
+  FbLoop& SetSync(SyncFunc sync);
+
+  // Runs frames of: FbGfx::SyncInputs, ticks, FbGfx::PumpInputs, draw,
+  // FbGfx::Flip until the window is closed or Stop is called.
+  void Run();
+  // Ends Run after the current tick or draw returns, without running any more.
+  void Stop();
+
+  // Spends elapsed_seconds of real time running ticks (as Run does every
+  // frame), returning the number run. Useful for driving the loop from an
+  // external clock. now is the real time at the end of elapsed_seconds.
+  uint32_t Advance(double elapsed_seconds,
+                   std::chrono::steady_clock::time_point now =
+                       std::chrono::steady_clock::now());
+
+  double alpha() const { return accumulator_ * options_.tick_rate; }
+  // Total ticks run.
+  uint64_t ticks() const { return ticks_; }
+  // During a tick, the real time that the tick simulates up to.
+  std::chrono::steady_clock::time_point tick_time() const {
+    return tick_time_;
+  }
+  // Total ticks' worth of time dropped because frames ran too long.
+  uint64_t dropped_ticks() const { return dropped_ticks_; }
+  // The refresh rate frame times are being snapped to.
+  int32_t refresh_rate() const { return refresh_rate_; }
+
+ private:
+  // Rounds a frame time to a whole number of refreshes if it's close to one.
+  double SnapToVsync(double elapsed_seconds) const;
+
+  const Options options_;
+  const double tick_seconds_;
+  int32_t refresh_rate_;
+
+  TickFunc tick_;
+  DrawFunc draw_;
+  SyncFunc sync_;
+
+  bool stopped_;
+  double accumulator_;
+  uint64_t ticks_;
+  std::chrono::steady_clock::time_point tick_time_;
+  uint64_t dropped_ticks_;
+};
+
+}  // namespace retro
+
+#endif  // RETRO_FBLOOP_H_
@@ -0,0 +1,108 @@
+#include "retro/fbloop.h"
+
+#include <chrono>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace retro {
+namespace {
+FbLoop::Options NoSnap() {
+  return FbLoop::Options().SetTickRate(100).SetRefreshRate(0);
+}
+}  // namespace
+
+TEST(FbLoopTest, advance_runsWholeTicks_andKeepsRemainderAsAlpha) {
+  uint32_t ticks = 0;
+  double tick_dt = 0;
+  FbLoop loop(NoSnap());
+  loop.SetTick([&](double dt) {
+    ++ticks;
+    tick_dt = dt;
+  });
+
+  EXPECT_EQ(loop.Advance(0.025), 2u);
+  EXPECT_EQ(ticks, 2u);
+  EXPECT_DOUBLE_EQ(tick_dt, 0.01);
+  EXPECT_NEAR(loop.alpha(), 0.5, 1e-9);
+
+  EXPECT_EQ(loop.Advance(0.005), 1u);
+  EXPECT_NEAR(loop.alpha(), 0.0, 1e-9);
+  EXPECT_EQ(loop.ticks(), 3u);
+}
+
+TEST(FbLoopTest, advance_dropsTimeBeyondMaxTicksPerFrame) {
+  FbLoop loop(NoSnap().SetMaxTicksPerFrame(3).SetMaxFrameSeconds(1.0));
+  EXPECT_EQ(loop.Advance(0.105), 3u);
+  EXPECT_EQ(loop.dropped_ticks(), 7u);
+  EXPECT_NEAR(loop.alpha(), 0.5, 1e-9);
+
+  // Back to normal the next frame.
+  EXPECT_EQ(loop.Advance(0.01), 1u);
+}
+
+TEST(FbLoopTest, advance_clampsLongFrames) {
+  FbLoop loop(
+      NoSnap().SetMaxTicksPerFrame(1000).SetMaxFrameSeconds(0.055));
+  EXPECT_EQ(loop.Advance(10.0), 5u);
+  EXPECT_EQ(loop.dropped_ticks(), 0u);
+}
+
+TEST(FbLoopTest, advance_snapsJitterToRefreshes) {
+  FbLoop loop(FbLoop::Options().SetTickRate(60).SetRefreshRate(60));
+  uint32_t ticks = 0;
+  for (int i = 0; i < 60; ++i) {
+    // Alternately a little short of and a little over a refresh.
+    const uint32_t ran =
+        loop.Advance(1.0 / 60.0 + ((i & 1) ? 0.0005 : -0.0005));
+    EXPECT_EQ(ran, 1u) << "frame " << i;
+    ticks += ran;
+  }
+  EXPECT_EQ(ticks, 60u);
+
+  // A missed vsync is two refreshes, so two ticks.
+  EXPECT_EQ(loop.Advance(2.0 / 60.0 + 0.001), 2u);
+}
+
+TEST(FbLoopTest, advance_doesntSnapFarFromRefreshes) {
+  FbLoop loop(FbLoop::Options()
+                  .SetTickRate(100)
+                  .SetRefreshRate(60)
+                  .SetVsyncToleranceSeconds(0.001));
+  loop.Advance(0.025);
+  EXPECT_NEAR(loop.alpha(), 0.5, 1e-9);
+}
+
+TEST(FbLoopTest, advance_callsSyncOnTickCadence) {
+  uint32_t syncs = 0;
+  FbLoop loop(NoSnap().SetSyncIntervalTicks(2));
+  loop.SetSync([&]() { ++syncs; });
+  loop.Advance(0.035);
+  EXPECT_EQ(syncs, 1u);
+  loop.Advance(0.005);
+  EXPECT_EQ(syncs, 2u);
+}
+
+TEST(FbLoopTest, tickTime_lagsFrameTimeByRemainingTicks) {
+  typedef std::chrono::duration<double, std::milli> Millis;
+  const auto now = std::chrono::steady_clock::now();
+  std::vector<std::chrono::steady_clock::time_point> tick_times;
+  FbLoop loop(NoSnap());
+  loop.SetTick([&](double) { tick_times.push_back(loop.tick_time()); });
+
+  loop.Advance(0.025, now);
+  ASSERT_EQ(tick_times.size(), 2u);
+  EXPECT_NEAR(Millis(now - tick_times[0]).count(), 15, 1e-3);
+  EXPECT_NEAR(Millis(now - tick_times[1]).count(), 5, 1e-3);
+}
+
+TEST(FbLoopTest, stop_endsAdvance) {
+  uint32_t ticks = 0;
+  FbLoop loop(NoSnap());
+  loop.SetTick([&](double) {
+    if (++ticks == 2) loop.Stop();
+  });
+  EXPECT_EQ(loop.Advance(0.05), 2u);
+}
+
+}  // namespace retro
@@ -0,0 +1,60 @@
+#include "retro/fbpalette.h"
+
+#include <algorithm>
+
+#include "glog/logging.h"
+
+namespace retro {
+namespace {
+// Mixes each 8 bit channel of a and b, t256 / 256 of the way toward b.
+uint32_t LerpWord(uint32_t a, uint32_t b, uint32_t t256) {
+  uint32_t out = 0;
+  for (int shift = 0; shift < 32; shift += 8) {
+    const int32_t ca = (a >> shift) & 0xff;
+    const int32_t cb = (b >> shift) & 0xff;
+    const int32_t c = ca + (((cb - ca) * static_cast<int32_t>(t256)) >> 8);
+    out |= static_cast<uint32_t>(c) << shift;
+  }
+  return out;
+}
+
+uint32_t ToT256(double t) {
+  return static_cast<uint32_t>(std::min(std::max(t, 0.0), 1.0) * 256.0);
+}
+}  // namespace
+
+FbPalette::FbPalette() { std::fill_n(colors_, kSize, 0); }
+
+void FbPalette::Rotate(uint8_t first, int32_t count, int32_t steps) {
+  CHECK_GE(count, 0) << "Bad rotation count: " << count;
+  CHECK_LE(first + count, kSize)
+      << "Rotation range [" << static_cast<int32_t>(first) << ", "
+      << first + count << ") exceeds the palette.";
+  if (count == 0) return;
+  steps %= count;
+  if (steps < 0) steps += count;
+  // Rotating toward higher indices by steps is rotating left by count - steps.
+  std::rotate(colors_ + first, colors_ + first + (count - steps),
+              colors_ + first + count);
+}
+
+void FbPalette::Lerp(const FbPalette& a, const FbPalette& b, double t) {
+  const uint32_t t256 = ToT256(t);
+  for (int32_t i = 0; i < kSize; ++i) {
+    colors_[i] = LerpWord(a.colors_[i], b.colors_[i], t256);
+  }
+}
+
+void FbPalette::Fade(const FbPalette& from, FbColor32 color, double t) {
+  const uint32_t t256 = ToT256(t);
+  const uint32_t to = color.value;
+  for (int32_t i = 0; i < kSize; ++i) {
+    colors_[i] = LerpWord(from.colors_[i], to, t256);
+  }
+}
+
+bool FbPalette::operator==(const FbPalette& other) const {
+  return std::equal(colors_, colors_ + kSize, other.colors_);
+}
+
+}  // namespace retro
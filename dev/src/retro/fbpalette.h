@@ -0,0 +1,47 @@
+#ifndef RETRO_FBPALETTE_H_
+#define RETRO_FBPALETTE_H_
+
+#include <stdint.h>
+
+#include "retro/fbcore.h"
+
+namespace retro {
+
+// A 256 entry color table for palette indexed images (see FbPalImg). Colors
+// are held as RGBA8888 words (the layout of FbColor32::value), so the table
+// can be used directly as a lookup when expanding indices to pixels.
+class FbPalette {
+ public:
+  static constexpr int32_t kSize = 256;
+
+  // All entries start transparent black.
+  FbPalette();
+
+  FbColor32 operator[](uint8_t i) const {
+    return static_cast<int32_t>(colors_[i]);
+  }
+  void Set(uint8_t i, FbColor32 color) { colors_[i] = color.value; }
+
+  // Color cycling: rotates entries [first, first + count) by steps toward
+  // higher indices (wrapping within the range). Negative steps rotate the
+  // other way.
+  void Rotate(uint8_t first, int32_t count, int32_t steps);
+
+  // Sets every entry to a's color mixed t of the way toward b's, t in [0, 1].
+  // All four channels, including alpha, are mixed.
+  void Lerp(const FbPalette& a, const FbPalette& b, double t);
+  // Sets every entry to from's color mixed t of the way toward color.
+  void Fade(const FbPalette& from, FbColor32 color, double t);
+
+  const uint32_t* data() const { return colors_; }
+
+  bool operator==(const FbPalette& other) const;
+  bool operator!=(const FbPalette& other) const { return !(*this == other); }
+
+ private:
+  uint32_t colors_[kSize];
+};
+
+}  // namespace retro
+
+#endif  // RETRO_FBPALETTE_H_
@@ -0,0 +1,82 @@
+#include "retro/fbpalette.h"
+
+#include "gtest/gtest.h"
+
+namespace retro {
+
+TEST(FbPaletteTest, startsTransparentBlack) {
+  FbPalette palette;
+  for (int32_t i = 0; i < FbPalette::kSize; ++i) {
+    EXPECT_EQ(palette.data()[i], FbColor32::TRANSPARENT_BLACK);
+  }
+}
+
+TEST(FbPaletteTest, set_updatesEntry) {
+  FbPalette palette;
+  palette.Set(7, FbColor32::RED);
+  EXPECT_EQ(static_cast<uint32_t>(palette[7].value), FbColor32::RED);
+  EXPECT_EQ(palette.data()[7], FbColor32::RED);
+}
+
+TEST(FbPaletteTest, rotate_cyclesRangeOnly) {
+  FbPalette palette;
+  for (int32_t i = 0; i < 6; ++i) palette.Set(i, i + 1);
+
+  palette.Rotate(1, 4, 1);
+  // Entries 1..4 held 2, 3, 4, 5.
+  EXPECT_EQ(palette[0].value, 1);
+  EXPECT_EQ(palette[1].value, 5);
+  EXPECT_EQ(palette[2].value, 2);
+  EXPECT_EQ(palette[3].value, 3);
+  EXPECT_EQ(palette[4].value, 4);
+  EXPECT_EQ(palette[5].value, 6);
+
+  palette.Rotate(1, 4, -1);
+  for (int32_t i = 0; i < 6; ++i) EXPECT_EQ(palette[i].value, i + 1);
+
+  palette.Rotate(1, 4, 9);
+  EXPECT_EQ(palette[1].value, 5);
+}
+
+TEST(FbPaletteTest, rotate_wholePalette) {
+  FbPalette palette;
+  palette.Set(255, FbColor32::GREEN);
+  palette.Rotate(0, FbPalette::kSize, 1);
+  EXPECT_EQ(static_cast<uint32_t>(palette[0].value), FbColor32::GREEN);
+}
+
+TEST(FbPaletteTest, lerp_mixesChannels) {
+  FbPalette a;
+  FbPalette b;
+  a.Set(0, FbColor32(0, 100, 200, 255));
+  b.Set(0, FbColor32(200, 100, 0, 55));
+
+  FbPalette mixed;
+  mixed.Lerp(a, b, 0.5);
+  EXPECT_EQ(mixed[0].channel.r, 100u);
+  EXPECT_EQ(mixed[0].channel.g, 100u);
+  EXPECT_EQ(mixed[0].channel.b, 100u);
+  EXPECT_EQ(mixed[0].channel.a, 155u);
+
+  mixed.Lerp(a, b, 0);
+  EXPECT_EQ(mixed, a);
+  mixed.Lerp(a, b, 1);
+  EXPECT_EQ(mixed, b);
+}
+
+TEST(FbPaletteTest, fade_towardColor) {
+  FbPalette from;
+  for (int32_t i = 0; i < FbPalette::kSize; ++i) {
+    from.Set(i, FbColor32::WHITE);
+  }
+
+  FbPalette faded;
+  faded.Fade(from, FbColor32::BLACK, 1.0);
+  for (int32_t i = 0; i < FbPalette::kSize; ++i) {
+    EXPECT_EQ(faded.data()[i], FbColor32::BLACK);
+  }
+  faded.Fade(from, FbColor32::BLACK, 0.0);
+  EXPECT_EQ(faded, from);
+}
+
+}  // namespace retro
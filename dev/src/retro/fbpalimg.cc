@@ -0,0 +1,72 @@
+#include "retro/fbpalimg.h"
+
+#include <unordered_map>
+
+#include "SDL.h"
+#include "glog/logging.h"
+#include "retro/fbsoft.h"
+
+using glm::ivec2;
+using std::string;
+using std::unique_ptr;
+
+namespace retro {
+
+FbPalImg::FbPalImg(ivec2 dims, std::vector<uint8_t> indices,
+                   const FbPalette& palette)
+    : w_(dims.x),
+      h_(dims.y),
+      indices_(std::move(indices)),
+      palette_(palette),
+      img_(nullptr),
+      dirty_(true) {}
+
+unique_ptr<FbPalImg> FbPalImg::OfSize(ivec2 dims) {
+  CHECK_GT(dims.x, 0) << "Bad image width: " << dims.x;
+  CHECK_GT(dims.y, 0) << "Bad image height: " << dims.y;
+  return unique_ptr<FbPalImg>(
+      new FbPalImg(dims, std::vector<uint8_t>(dims.x * dims.y, 0),
+                   FbPalette()));
+}
+
+unique_ptr<FbPalImg> FbPalImg::FromFile(const string& filename) {
+  ivec2 dims;
+  auto image_data = FbImg::LoadStbImage(filename, &dims);
+  // stb_image gives us R, G, B, A bytes, which read as a big-endian word are
+  // exactly RGBA8888.
+  const uint32_t* src = reinterpret_cast<const uint32_t*>(image_data.get());
+
+  std::vector<uint8_t> indices(dims.x * dims.y);
+  FbPalette palette;
+  std::unordered_map<uint32_t, uint8_t> palette_indices;
+  for (size_t i = 0; i < indices.size(); ++i) {
+    const uint32_t color = SDL_SwapBE32(src[i]);
+    auto [entry, added] = palette_indices.emplace(
+        color, static_cast<uint8_t>(palette_indices.size()));
+    if (added) {
+      CHECK_LE(palette_indices.size(), static_cast<size_t>(FbPalette::kSize))
+          << "Image " << filename << " has more than " << FbPalette::kSize
+          << " colors.";
+      palette.Set(entry->second, static_cast<int32_t>(color));
+    }
+    indices[i] = entry->second;
+  }
+  return unique_ptr<FbPalImg>(
+      new FbPalImg(dims, std::move(indices), palette));
+}
+
+const FbImg& FbPalImg::img() {
+  if (img_ == nullptr) img_ = FbImg::OfSizeStreaming({w_, h_});
+  if (dirty_) {
+    const FbImg::PixelSpan span = img_->Lock();
+    for (int32_t y = 0; y < h_; ++y) {
+      fbsoft::ExpandIndexed(span.row(y), indices_.data() + y * w_, w_,
+                            palette_.data());
+    }
+    img_->Unlock();
+    dirty_ = false;
+  }
+  return *img_;
+}
+
+}  // namespace retro
@@ -0,0 +1,83 @@
+#ifndef RETRO_FBPALIMG_H_
+#define RETRO_FBPALIMG_H_
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "glm/vec2.hpp"
+#include "retro/fbimg.h"
+#include "retro/fbpalette.h"
+#include "util/noncopyable.h"
+
+namespace retro {
+
+// A palette indexed image: 8bit pixels that index a 256 color FbPalette. The
+// indices are a quarter the size of the equivalent RGBA pixels, and swapping,
+// fading or cycling the palette recolors the whole image without redrawing
+// it.
+//
+// To draw, use img(), which expands the indices through the palette into a
+// streaming FbImg. The expansion (a SIMD table lookup) and upload only happen
+// when the indices or palette changed since the last call.
+//
+//   auto sky = FbPalImg::FromFile("res/img/sky.png");
+//   sky->mutable_palette()->Rotate(16, 8, 1);
+//   FbGfx::Put(sky->img(), {0, 0});
+//
+// Like FbGfx, img() can only be used from the thread that called
+// FbGfx::Screen.
+class FbPalImg : public util::NonCopyable {
+ public:
+  // Load an image with at most 256 distinct colors. Colors are assigned
+  // palette entries in the order they're first seen, in row major order.
+  static std::unique_ptr<FbPalImg> FromFile(const std::string& filename);
+  // Create an image of the provided dimensions with every index 0 and a
+  // transparent black palette.
+  static std::unique_ptr<FbPalImg> OfSize(glm::ivec2 dims);
+
+  int width() const { return w_; }
+  int height() const { return h_; }
+
+  uint8_t index(glm::ivec2 p) const { return indices_[p.y * w_ + p.x]; }
+  void SetIndex(glm::ivec2 p, uint8_t index) {
+    indices_[p.y * w_ + p.x] = index;
+    dirty_ = true;
+  }
+  // Row major indices, width() per row.
+  const uint8_t* indices() const { return indices_.data(); }
+  uint8_t* mutable_indices() {
+    dirty_ = true;
+    return indices_.data();
+  }
+
+  const FbPalette& palette() const { return palette_; }
+  FbPalette* mutable_palette() {
+    dirty_ = true;
+    return &palette_;
+  }
+  void SetPalette(const FbPalette& palette) {
+    palette_ = palette;
+    dirty_ = true;
+  }
+
+  // The image expanded through the current palette.
+  const FbImg& img();
+
+ private:
+  FbPalImg(glm::ivec2 dims, std::vector<uint8_t> indices,
+           const FbPalette& palette);
+
+  const int w_;
+  const int h_;
+  std::vector<uint8_t> indices_;
+  FbPalette palette_;
+  // Created on first use.
+  std::unique_ptr<FbImg> img_;
+  bool dirty_;
+};
+
+}  // namespace retro
+
+#endif  // RETRO_FBPALIMG_H_
@@ -0,0 +1,65 @@
+#include "retro/fbrenderqueue.h"
+
+#include "glog/logging.h"
+#include "retro/fbimg.h"
+#include "util/radixsort.h"
+
+using glm::ivec2;
+
+namespace retro {
+
+FbRenderQueue::FbRenderQueue() {}
+
+void FbRenderQueue::Put(uint32_t layer, uint32_t depth, const FbImg& src,
+                        ivec2 p, ivec2 src_a, ivec2 src_b) {
+  PutEx(layer, depth, src, p, FbGfx::PutOptions(), src_a, src_b);
+}
+
+void FbRenderQueue::PutEx(uint32_t layer, uint32_t depth, const FbImg& src,
+                          ivec2 p, FbGfx::PutOptions opts, ivec2 src_a,
+                          ivec2 src_b) {
+  CHECK_LT(layer, uint32_t{1} << kLayerBits) << "Layer out of range.";
+  CHECK_LT(depth, uint32_t{1} << kDepthBits) << "Depth out of range.";
+  const uint32_t texture =
+      texture_order_.emplace(&src.root(), texture_order_.size())
+          .first->second;
+  CHECK_LT(texture, uint32_t{1} << kTextureBits)
+      << "Too many textures in one FbRenderQueue.";
+
+  entries_.push_back(
+      {MakeKey(layer, depth, texture, static_cast<uint32_t>(opts.blend)),
+       static_cast<uint32_t>(items_.size())});
+  items_.push_back({&src, p, opts, src_a, src_b});
+}
+
+// FbBatch checks FbGfx's state and the target.
+void FbRenderQueue::Submit() { InternalSubmit(nullptr); }
+void FbRenderQueue::Submit(const FbImg& target) { InternalSubmit(&target); }
+
+void FbRenderQueue::InternalSubmit(const FbImg* target) {
+  util::RadixSort(&entries_, &scratch_,
+                  [](const Entry& entry) { return entry.key; });
+
+  // The sort has already grouped draws by texture and blend mode as far as
+  // draw order allows, so the batch only has to merge neighbours.
+  batch_.Begin(FbBatch::SORT_DEFERRED);
+  for (const Entry& entry : entries_) {
+    const Item& item = items_[entry.item];
+    if (target != nullptr) {
+      batch_.PutEx(*target, *item.src, item.p, item.opts, item.src_a,
+                   item.src_b);
+    } else {
+      batch_.PutEx(*item.src, item.p, item.opts, item.src_a, item.src_b);
+    }
+  }
+  batch_.End();
+  Clear();
+}
+
+void FbRenderQueue::Clear() {
+  items_.clear();
+  entries_.clear();
+  texture_order_.clear();
+}
+
+}  // namespace retro
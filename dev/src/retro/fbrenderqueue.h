@@ -0,0 +1,104 @@
+#ifndef RETRO_FBRENDERQUEUE_H_
+#define RETRO_FBRENDERQUEUE_H_
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include "glm/vec2.hpp"
+#include "retro/fbbatch.h"
+#include "retro/fbgfx.h"
+#include "util/noncopyable.h"
+
+namespace retro {
+
+class FbImg;
+// Collects a frame's worth of FbGfx::Put/PutEx style draws, each tagged with
+// where it belongs in draw order, then sorts and submits them all at once:
+//
+//   FbRenderQueue queue;
+//   queue.Put(kLayerTiles, 0, tiles, p, src_a, src_b);
+//   for (const Sprite& sprite : sprites) {
+//     queue.Put(kLayerSprites, sprite.p.y, *sprite.img, sprite.p);
+//   }
+//   queue.Submit();
+//
+// Every draw gets a 64-bit key packing (from most to least significant) its
+// layer, its depth within the layer, its source texture and its blend mode.
+// Submit radix sorts the keys and draws in key order through an FbBatch, so
+// draws are ordered by layer and then depth, and draws sharing a layer and
+// depth are grouped by texture and blend mode into as few draw calls as
+// possible. Draws with equal keys are drawn in the order they were queued.
+//
+// Images passed to Put/PutEx must outlive the call to Submit. Like FbGfx,
+// this can only be used from the thread that called FbGfx::Screen.
+class FbRenderQueue : public util::NonCopyable {
+  friend class FbRenderQueueTest;
+
+ public:
+  static constexpr uint32_t kLayerBits = 8;
+  static constexpr uint32_t kDepthBits = 24;
+  static constexpr uint32_t kTextureBits = 24;
+  static constexpr uint32_t kBlendBits = 8;
+
+  FbRenderQueue();
+
+  // Queue src to be drawn at p, behind anything on a later layer or at a
+  // greater depth on the same layer. layer must be less than 2^kLayerBits and
+  // depth less than 2^kDepthBits. Otherwise these mirror FbGfx::Put and
+  // FbGfx::PutEx.
+  void Put(uint32_t layer, uint32_t depth, const FbImg& src, glm::ivec2 p,
+           glm::ivec2 src_a = {-1, -1}, glm::ivec2 src_b = {-1, -1});
+  void PutEx(uint32_t layer, uint32_t depth, const FbImg& src, glm::ivec2 p,
+             FbGfx::PutOptions opts, glm::ivec2 src_a = {-1, -1},
+             glm::ivec2 src_b = {-1, -1});
+
+  // Sorts and draws everything queued (to the screen or target), emptying
+  // the queue.
+  void Submit();
+  void Submit(const FbImg& target);
+
+  // Discards everything queued without drawing it.
+  void Clear();
+
+  size_t size() const { return items_.size(); }
+  bool empty() const { return items_.empty(); }
+
+  static uint64_t MakeKey(uint32_t layer, uint32_t depth, uint32_t texture,
+                          uint32_t blend) {
+    return (static_cast<uint64_t>(layer)
+            << (kDepthBits + kTextureBits + kBlendBits)) |
+           (static_cast<uint64_t>(depth) << (kTextureBits + kBlendBits)) |
+           (static_cast<uint64_t>(texture) << kBlendBits) | blend;
+  }
+
+ private:
+  struct Item {
+    const FbImg* src;
+    glm::ivec2 p;
+    FbGfx::PutOptions opts;
+    glm::ivec2 src_a;
+    glm::ivec2 src_b;
+  };
+  struct Entry {
+    uint64_t key;
+    // Index into items_.
+    uint32_t item;
+  };
+
+  void InternalSubmit(const FbImg* target);
+
+  std::vector<Item> items_;
+  std::vector<Entry> entries_;
+  // Order of first use of an image (by its root) since the last Submit, which
+  // is its key's texture field.
+  std::unordered_map<const FbImg*, uint32_t> texture_order_;
+
+  // Re-used between calls to Submit.
+  std::vector<Entry> scratch_;
+  FbBatch batch_;
+};
+
+}  // namespace retro
+
+#endif  // RETRO_FBRENDERQUEUE_H_
@@ -0,0 +1,201 @@
+#include "retro/fbrenderqueue.h"
+
+#include <memory>
+
+#include "SDL.h"
+#include "glm/vec2.hpp"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "retro/fbcore.h"
+#include "retro/fbgfx.h"
+#include "retro/fbimg.h"
+#include "retro/fbtestscreen.h"
+
+namespace retro {
+using fbtest::DrawCalls;
+using fbtest::ScreenRow;
+using ::testing::ElementsAre;
+typedef FbGfx::PutOptions Opts;
+
+namespace {
+constexpr uint32_t kRed = FbColor32::RED;
+constexpr uint32_t kGreen = FbColor32::GREEN;
+constexpr uint32_t kBlue = FbColor32::BLUE;
+constexpr uint32_t kYellow = FbColor32::YELLOW;
+constexpr uint32_t kBlack = FbColor32::BLACK;
+}  // namespace
+
+// A friend of FbRenderQueue so that tests can check its texture order. Queues
+// are submitted through FbBatch, so like FbBatchTest these use the
+// accelerated backend. Draws are single pixels, so that each pixel of the one
+// row screen shows which of the draws covering it was submitted last.
+class FbRenderQueueTest : public ::testing::Test {
+ protected:
+  static void SetUpTestSuite() { fbtest::OpenHeadlessScreen({4, 1}); }
+
+  void SetUp() override {
+    red_ = Solid(FbColor32::RED);
+    green_ = Solid(FbColor32::GREEN);
+    blue_ = Solid(FbColor32::BLUE);
+    white_ = Solid(FbColor32::WHITE);
+    FbGfx::Flip();
+  }
+
+  static std::unique_ptr<FbImg> Solid(FbColor32 color) {
+    std::unique_ptr<FbImg> img = FbImg::OfSize({1, 1});
+    FbGfx::Cls(*img, color);
+    return img;
+  }
+
+  static size_t TextureCount(const FbRenderQueue& queue) {
+    return queue.texture_order_.size();
+  }
+
+  std::unique_ptr<FbImg> red_;
+  std::unique_ptr<FbImg> green_;
+  std::unique_ptr<FbImg> blue_;
+  std::unique_ptr<FbImg> white_;
+};
+
+TEST_F(FbRenderQueueTest, makeKey_ordersByLayerDepthTextureThenBlend) {
+  constexpr uint32_t kMaxDepth = (1 << FbRenderQueue::kDepthBits) - 1;
+  constexpr uint32_t kMaxTexture = (1 << FbRenderQueue::kTextureBits) - 1;
+  constexpr uint32_t kMaxBlend = (1 << FbRenderQueue::kBlendBits) - 1;
+  // Each field outweighs every less significant field at its maximum.
+  EXPECT_GT(FbRenderQueue::MakeKey(1, 0, 0, 0),
+            FbRenderQueue::MakeKey(0, kMaxDepth, kMaxTexture, kMaxBlend));
+  EXPECT_GT(FbRenderQueue::MakeKey(0, 1, 0, 0),
+            FbRenderQueue::MakeKey(0, 0, kMaxTexture, kMaxBlend));
+  EXPECT_GT(FbRenderQueue::MakeKey(0, 0, 1, 0),
+            FbRenderQueue::MakeKey(0, 0, 0, kMaxBlend));
+  EXPECT_GT(FbRenderQueue::MakeKey(0, 0, 0, 1),
+            FbRenderQueue::MakeKey(0, 0, 0, 0));
+  // And fields don't overlap.
+  EXPECT_EQ(FbRenderQueue::MakeKey(255, kMaxDepth, kMaxTexture, kMaxBlend),
+            ~uint64_t{0});
+}
+
+TEST_F(FbRenderQueueTest, submit_drawsByLayerThenDepth) {
+  FbRenderQueue queue;
+  // A later layer is drawn over an earlier one at any depth...
+  queue.Put(1, 0, *red_, {0, 0});
+  queue.Put(0, 9, *green_, {0, 0});
+  // ...and a greater depth over a lesser one.
+  queue.Put(0, 2, *green_, {1, 0});
+  queue.Put(0, 1, *red_, {1, 0});
+  queue.Put(2, 0, *blue_, {2, 0});
+  queue.Put(1, 7, *red_, {2, 0});
+
+  FbGfx::Cls();
+  queue.Submit();
+  EXPECT_THAT(ScreenRow(0), ElementsAre(kRed, kGreen, kBlue, kBlack));
+  FbGfx::Flip();
+}
+
+TEST_F(FbRenderQueueTest, submit_groupsByTextureThenBlend) {
+  FbRenderQueue queue;
+  // Red is the first texture used, so it's drawn before green at the same
+  // layer and depth even though it was queued after.
+  queue.Put(0, 0, *red_, {0, 0});
+  queue.Put(0, 0, *green_, {1, 0});
+  queue.Put(0, 0, *red_, {1, 0});
+  // Alpha blended draws of a texture come before added ones.
+  queue.PutEx(0, 0, *white_, {2, 0},
+              Opts().SetBlend(Opts::BLEND_ADD).SetMod(FbColor32::RED));
+  queue.PutEx(0, 0, *white_, {2, 0},
+              Opts().SetBlend(Opts::BLEND_ALPHA).SetMod(FbColor32::GREEN));
+
+  FbGfx::Cls();
+  queue.Submit();
+  EXPECT_THAT(ScreenRow(0), ElementsAre(kRed, kGreen, kYellow, kBlack));
+  FbGfx::Flip();
+}
+
+TEST_F(FbRenderQueueTest, submit_keepsQueueOrderOfEqualKeys) {
+  FbRenderQueue queue;
+  queue.PutEx(0, 0, *white_, {0, 0}, Opts().SetMod(FbColor32::RED));
+  queue.PutEx(0, 0, *white_, {0, 0}, Opts().SetMod(FbColor32::GREEN));
+  queue.PutEx(0, 0, *white_, {1, 0}, Opts().SetMod(FbColor32::GREEN));
+  queue.PutEx(0, 0, *white_, {1, 0}, Opts().SetMod(FbColor32::BLUE));
+  queue.PutEx(0, 0, *white_, {1, 0}, Opts().SetMod(FbColor32::RED));
+
+  FbGfx::Cls();
+  queue.Submit();
+  EXPECT_THAT(ScreenRow(0), ElementsAre(kGreen, kRed, kBlack, kBlack));
+  FbGfx::Flip();
+}
+
+TEST_F(FbRenderQueueTest, submit_emptiesQueueAndTextureOrder) {
+  FbRenderQueue queue;
+  queue.Put(0, 0, *red_, {0, 0});
+  queue.Put(0, 0, *green_, {0, 0});
+  EXPECT_EQ(queue.size(), 2u);
+  EXPECT_EQ(TextureCount(queue), 2u);
+
+  FbGfx::Cls();
+  queue.Submit();
+  EXPECT_TRUE(queue.empty());
+  EXPECT_EQ(TextureCount(queue), 0u);
+  EXPECT_THAT(ScreenRow(0), ElementsAre(kGreen, kBlack, kBlack, kBlack));
+
+  // Green is now the first texture used, so red goes on top.
+  queue.Put(0, 0, *green_, {0, 0});
+  queue.Put(0, 0, *red_, {0, 0});
+  queue.Submit();
+  EXPECT_THAT(ScreenRow(0), ElementsAre(kRed, kBlack, kBlack, kBlack));
+  FbGfx::Flip();
+
+  // Nothing is left to draw.
+  EXPECT_EQ(DrawCalls([&queue] { queue.Submit(); }), 0u);
+}
+
+TEST_F(FbRenderQueueTest, clear_discardsQueuedDraws) {
+  FbRenderQueue queue;
+  queue.Put(0, 0, *red_, {0, 0});
+  queue.Clear();
+  EXPECT_TRUE(queue.empty());
+  EXPECT_EQ(TextureCount(queue), 0u);
+  EXPECT_EQ(DrawCalls([&queue] { queue.Submit(); }), 0u);
+}
+
+TEST_F(FbRenderQueueTest, submit_mergesDrawsSharingLayerDepthAndTexture) {
+  const uint32_t calls = DrawCalls([this] {
+    FbRenderQueue queue;
+    for (int32_t x = 0; x < 4; ++x) {
+      queue.Put(0, 0, (x % 2 == 0) ? *red_ : *green_, {x, 0});
+    }
+    queue.Submit();
+  });
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+  EXPECT_EQ(calls, 2u);
+#else
+  EXPECT_EQ(calls, 4u);
+#endif
+
+  // Layers keep the same draws apart.
+  EXPECT_EQ(DrawCalls([this] {
+              FbRenderQueue queue;
+              queue.Put(0, 0, *red_, {0, 0});
+              queue.Put(1, 0, *green_, {1, 0});
+              queue.Put(2, 0, *red_, {2, 0});
+              queue.Submit();
+            }),
+            3u);
+}
+
+TEST_F(FbRenderQueueTest, submit_toTarget) {
+  std::unique_ptr<FbImg> target = FbImg::OfSize({4, 1});
+  FbGfx::Cls(*target, FbColor32::BLUE);
+  FbRenderQueue queue;
+  queue.Put(1, 0, *red_, {1, 0});
+  queue.Put(0, 0, *green_, {1, 0});
+  queue.Submit(*target);
+  EXPECT_TRUE(queue.empty());
+
+  FbGfx::Cls();
+  FbGfx::Put(*target, {0, 0});
+  EXPECT_THAT(ScreenRow(0), ElementsAre(kBlue, kRed, kBlue, kBlue));
+  FbGfx::Flip();
+}
+
+}  // namespace retro
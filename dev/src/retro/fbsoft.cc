@@ -0,0 +1,394 @@
+#include "retro/fbsoft.h"
+
+#include <stdlib.h>
+#include <algorithm>
+#include <new>
+#include <vector>
+
+#include "base/platform.h"
+#include "glog/logging.h"
+
+#if defined(__AVX2__)
+#define FBSOFT_AVX2
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(__amd64__)
+#define FBSOFT_SSE2
+#include <emmintrin.h>
+#endif
+
+using glm::ivec2;
+
+namespace retro {
+namespace fbsoft {
+namespace {
+typedef FbGfx::PutOptions Opts;
+
+// Round to nearest x / 255 for x in [0, 255 * 255].
+inline uint32_t Div255(uint32_t x) {
+  x += 128;
+  return (x + (x >> 8)) >> 8;
+}
+
+struct Channels {
+  uint32_t r;
+  uint32_t g;
+  uint32_t b;
+  uint32_t a;
+};
+
+inline Channels Unpack(Pixel p) {
+  return {p >> 24, (p >> 16) & 0xff, (p >> 8) & 0xff, p & 0xff};
+}
+
+inline Pixel Pack(uint32_t r, uint32_t g, uint32_t b, uint32_t a) {
+  return (r << 24) | (g << 16) | (b << 8) | a;
+}
+
+template <BlendMode M>
+inline Pixel BlendPixel(Pixel dst, Pixel src, const Channels& mod) {
+  Channels s = Unpack(src);
+  s.r = Div255(s.r * mod.r);
+  s.g = Div255(s.g * mod.g);
+  s.b = Div255(s.b * mod.b);
+  s.a = Div255(s.a * mod.a);
+  if (M == Opts::BLEND_NONE) return Pack(s.r, s.g, s.b, s.a);
+
+  const Channels d = Unpack(dst);
+  switch (M) {
+    case Opts::BLEND_ALPHA: {
+      const uint32_t inv_a = 255 - s.a;
+      return Pack(Div255(s.r * s.a + d.r * inv_a),
+                  Div255(s.g * s.a + d.g * inv_a),
+                  Div255(s.b * s.a + d.b * inv_a),
+                  Div255(s.a * 255 + d.a * inv_a));
+    }
+    case Opts::BLEND_ADD:
+      return Pack(std::min(d.r + Div255(s.r * s.a), 255u),
+                  std::min(d.g + Div255(s.g * s.a), 255u),
+                  std::min(d.b + Div255(s.b * s.a), 255u), d.a);
+    case Opts::BLEND_MOD:
+      return Pack(Div255(s.r * d.r), Div255(s.g * d.g), Div255(s.b * d.b),
+                  d.a);
+    default:
+      return dst;
+  }
+}
+
+// The vector kernels work on 16 bit lanes holding one channel each, four
+// lanes per pixel in memory order: a, b, g, r. Ops wraps the handful of
+// instructions that differ between SSE2 and AVX2 so the kernel can be shared.
+#if defined(FBSOFT_SSE2)
+struct Sse2Ops {
+  typedef __m128i V;
+  static constexpr int32_t kPixels = 4;
+  static V Load(const Pixel* p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  }
+  static void Store(Pixel* p, V v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+  }
+  static V Zero() { return _mm_setzero_si128(); }
+  static V Set1(int16_t x) { return _mm_set1_epi16(x); }
+  static V SetChannels(int16_t r, int16_t g, int16_t b, int16_t a) {
+    return _mm_set_epi16(r, g, b, a, r, g, b, a);
+  }
+  static V UnpackLo(V v) { return _mm_unpacklo_epi8(v, Zero()); }
+  static V UnpackHi(V v) { return _mm_unpackhi_epi8(v, Zero()); }
+  static V Pack(V lo, V hi) { return _mm_packus_epi16(lo, hi); }
+  static V Add16(V a, V b) { return _mm_add_epi16(a, b); }
+  static V Sub16(V a, V b) { return _mm_sub_epi16(a, b); }
+  static V Mul16(V a, V b) { return _mm_mullo_epi16(a, b); }
+  static V Shr16(V a) { return _mm_srli_epi16(a, 8); }
+  static V AddSat8(V a, V b) { return _mm_adds_epu8(a, b); }
+  static V And(V a, V b) { return _mm_and_si128(a, b); }
+  static V AndNot(V a, V b) { return _mm_andnot_si128(a, b); }
+  static V Or(V a, V b) { return _mm_or_si128(a, b); }
+  static V BroadcastAlpha(V v) {
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0), 0);
+  }
+};
+#endif  // FBSOFT_SSE2
+
+#if defined(FBSOFT_AVX2)
+struct Avx2Ops {
+  typedef __m256i V;
+  static constexpr int32_t kPixels = 8;
+  static V Load(const Pixel* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  }
+  static void Store(Pixel* p, V v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+  }
+  static V Zero() { return _mm256_setzero_si256(); }
+  static V Set1(int16_t x) { return _mm256_set1_epi16(x); }
+  static V SetChannels(int16_t r, int16_t g, int16_t b, int16_t a) {
+    return _mm256_set_epi16(r, g, b, a, r, g, b, a, r, g, b, a, r, g, b, a);
+  }
+  // Unpacking and packing both work within 128 bit halves, so pixels come
+  // back out in the order they went in.
+  static V UnpackLo(V v) { return _mm256_unpacklo_epi8(v, Zero()); }
+  static V UnpackHi(V v) { return _mm256_unpackhi_epi8(v, Zero()); }
+  static V Pack(V lo, V hi) { return _mm256_packus_epi16(lo, hi); }
+  static V Add16(V a, V b) { return _mm256_add_epi16(a, b); }
+  static V Sub16(V a, V b) { return _mm256_sub_epi16(a, b); }
+  static V Mul16(V a, V b) { return _mm256_mullo_epi16(a, b); }
+  static V Shr16(V a) { return _mm256_srli_epi16(a, 8); }
+  static V AddSat8(V a, V b) { return _mm256_adds_epu8(a, b); }
+  static V And(V a, V b) { return _mm256_and_si256(a, b); }
+  static V AndNot(V a, V b) { return _mm256_andnot_si256(a, b); }
+  static V Or(V a, V b) { return _mm256_or_si256(a, b); }
+  static V BroadcastAlpha(V v) {
+    return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(v, 0), 0);
+  }
+};
+#endif  // FBSOFT_AVX2
+
+#if defined(FBSOFT_SSE2) || defined(FBSOFT_AVX2)
+// Vector version of Div255 on products of two 16 bit lanes (or sums that
+// stay within [0, 255 * 255]).
+template <class Ops>
+inline typename Ops::V VecDiv255(typename Ops::V x) {
+  x = Ops::Add16(x, Ops::Set1(128));
+  return Ops::Shr16(Ops::Add16(x, Ops::Shr16(x)));
+}
+
+// Blends one half (unpacked to 16 bit lanes) of a vector of pixels. s must
+// already be modulated.
+template <class Ops, BlendMode M>
+inline typename Ops::V BlendHalf(typename Ops::V d, typename Ops::V s) {
+  typedef typename Ops::V V;
+  const V c255 = Ops::Set1(255);
+  const V alpha_lanes = Ops::SetChannels(0, 0, 0, -1);
+  switch (M) {
+    case Opts::BLEND_ALPHA: {
+      const V sa = Ops::BroadcastAlpha(s);
+      // The alpha lane uses a factor of 255 so that out.a = s.a + d.a(1 - s.a)
+      const V s_f = Ops::Or(Ops::AndNot(alpha_lanes, sa),
+                            Ops::And(alpha_lanes, c255));
+      const V d_f = Ops::Sub16(c255, sa);
+      return VecDiv255<Ops>(
+          Ops::Add16(Ops::Mul16(s, s_f), Ops::Mul16(d, d_f)));
+    }
+    case Opts::BLEND_ADD: {
+      // The alpha lane gets a factor of 0 so the saturating add that follows
+      // leaves d.a alone.
+      const V s_f = Ops::AndNot(alpha_lanes, Ops::BroadcastAlpha(s));
+      return VecDiv255<Ops>(Ops::Mul16(s, s_f));
+    }
+    case Opts::BLEND_MOD:
+      // Setting s.a to 255 makes the product keep d.a.
+      return VecDiv255<Ops>(
+          Ops::Mul16(Ops::Or(s, Ops::And(alpha_lanes, c255)), d));
+    default:
+      return s;
+  }
+}
+
+template <class Ops, BlendMode M>
+inline int32_t BlendSpanVec(Pixel* dst, const Pixel* src, int32_t n,
+                            const Channels& mod) {
+  typedef typename Ops::V V;
+  const V mod16 = Ops::SetChannels(mod.r, mod.g, mod.b, mod.a);
+  int32_t i = 0;
+  for (; i + Ops::kPixels <= n; i += Ops::kPixels) {
+    const V s = Ops::Load(src + i);
+    const V s_lo = VecDiv255<Ops>(Ops::Mul16(Ops::UnpackLo(s), mod16));
+    const V s_hi = VecDiv255<Ops>(Ops::Mul16(Ops::UnpackHi(s), mod16));
+    if (M == Opts::BLEND_NONE) {
+      Ops::Store(dst + i, Ops::Pack(s_lo, s_hi));
+      continue;
+    }
+    const V d = Ops::Load(dst + i);
+    const V out = Ops::Pack(BlendHalf<Ops, M>(Ops::UnpackLo(d), s_lo),
+                            BlendHalf<Ops, M>(Ops::UnpackHi(d), s_hi));
+    Ops::Store(dst + i, M == Opts::BLEND_ADD ? Ops::AddSat8(d, out) : out);
+  }
+  return i;
+}
+#endif  // FBSOFT_SSE2 || FBSOFT_AVX2
+
+template <BlendMode M>
+void BlendSpanT(Pixel* dst, const Pixel* src, int32_t n, FbColor32 mod) {
+  const Channels mod_c = Unpack(mod.value);
+  int32_t i = 0;
+#if defined(FBSOFT_AVX2)
+  i += BlendSpanVec<Avx2Ops, M>(dst + i, src + i, n - i, mod_c);
+#endif
+#if defined(FBSOFT_SSE2)
+  i += BlendSpanVec<Sse2Ops, M>(dst + i, src + i, n - i, mod_c);
+#endif
+  for (; i < n; ++i) dst[i] = BlendPixel<M>(dst[i], src[i], mod_c);
+}
+
+// Clip [p, p + dims) to [0, bounds) updating src_p to match.
+bool ClipRect(ivec2 bounds, ivec2* p, ivec2* dims, ivec2* src_p) {
+  for (int i = 0; i < 2; ++i) {
+    if ((*p)[i] < 0) {
+      (*dims)[i] += (*p)[i];
+      (*src_p)[i] -= (*p)[i];
+      (*p)[i] = 0;
+    }
+    (*dims)[i] = std::min((*dims)[i], bounds[i] - (*p)[i]);
+    if ((*dims)[i] <= 0) return false;
+  }
+  return true;
+}
+
+// A row of a single color to use as the source of a blend.
+const Pixel* SolidRow(FbColor32 color, int32_t n) {
+  static thread_local std::vector<Pixel> row;
+  if (row.size() < static_cast<size_t>(n)) row.resize(n);
+  std::fill_n(row.begin(), n, static_cast<Pixel>(color.value));
+  return row.data();
+}
+
+inline bool InBounds(const Surface& s, ivec2 p) {
+  return (p.x >= 0) && (p.y >= 0) && (p.x < s.w) && (p.y < s.h);
+}
+}  // namespace
+
+Buffer::Buffer(ivec2 dims)
+    : pixels_(static_cast<Pixel*>(::operator new[](
+          std::max(1, dims.y * ((dims.x * 4 + kAlignment - 1) / kAlignment) *
+                          kAlignment),
+          std::align_val_t(kAlignment)))),
+      w_(dims.x),
+      h_(dims.y),
+      pitch_(((dims.x * 4 + kAlignment - 1) / kAlignment) * kAlignment / 4) {
+  CHECK_GT(dims.x, 0) << "Bad buffer width: " << dims.x;
+  CHECK_GT(dims.y, 0) << "Bad buffer height: " << dims.y;
+  std::fill_n(pixels_, pitch_ * h_, 0);
+}
+
+Buffer::~Buffer() { ::operator delete[](pixels_, std::align_val_t(kAlignment)); }
+
+void BlendSpan(Pixel* dst, const Pixel* src, int32_t n, BlendMode mode,
+               FbColor32 mod) {
+  switch (mode) {
+    case Opts::BLEND_NONE:
+      if (static_cast<uint32_t>(mod.value) == FbColor32::WHITE) {
+        std::copy_n(src, n, dst);
+        return;
+      }
+      BlendSpanT<Opts::BLEND_NONE>(dst, src, n, mod);
+      return;
+    case Opts::BLEND_ALPHA:
+      BlendSpanT<Opts::BLEND_ALPHA>(dst, src, n, mod);
+      return;
+    case Opts::BLEND_ADD:
+      BlendSpanT<Opts::BLEND_ADD>(dst, src, n, mod);
+      return;
+    case Opts::BLEND_MOD:
+      BlendSpanT<Opts::BLEND_MOD>(dst, src, n, mod);
+      return;
+    default:
+      CHECK(false) << "Not a real blend mode: " << mode;
+  }
+}
+
+void ExpandIndexed(Pixel* dst, const uint8_t* src, int32_t n,
+                   const Pixel* palette) {
+  int32_t i = 0;
+#ifdef FBSOFT_AVX2
+  for (; i + 8 <= n; i += 8) {
+    const __m256i indices = _mm256_cvtepu8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i)));
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i*>(dst + i),
+        _mm256_i32gather_epi32(reinterpret_cast<const int*>(palette), indices,
+                               4));
+  }
+#endif
+  for (; i < n; ++i) dst[i] = palette[src[i]];
+}
+
+void Clear(const Surface& dst, FbColor32 color) {
+  for (int32_t y = 0; y < dst.h; ++y) {
+    std::fill_n(dst.row(y), dst.w, static_cast<Pixel>(color.value));
+  }
+}
+
+void PSet(const Surface& dst, ivec2 p, FbColor32 color) {
+  if (!InBounds(dst, p)) return;
+  Pixel* pixel = dst.row(p.y) + p.x;
+  const Pixel src = color.value;
+  *pixel = BlendPixel<Opts::BLEND_ALPHA>(*pixel, src, {255, 255, 255, 255});
+}
+
+void Line(const Surface& dst, ivec2 a, ivec2 b, FbColor32 color) {
+  // Trivially reject lines entirely to one side of the surface.
+  if (((a.x < 0) && (b.x < 0)) || ((a.y < 0) && (b.y < 0)) ||
+      ((a.x >= dst.w) && (b.x >= dst.w)) ||
+      ((a.y >= dst.h) && (b.y >= dst.h))) {
+    return;
+  }
+  if (a.y == b.y) {
+    if (a.x > b.x) std::swap(a, b);
+    FillRect(dst, a, {b.x - a.x + 1, 1}, color);
+    return;
+  }
+  if (a.x == b.x) {
+    if (a.y > b.y) std::swap(a, b);
+    FillRect(dst, a, {1, b.y - a.y + 1}, color);
+    return;
+  }
+
+  // Bresenham
+  const ivec2 delta{std::abs(b.x - a.x), -std::abs(b.y - a.y)};
+  const ivec2 step{a.x < b.x ? 1 : -1, a.y < b.y ? 1 : -1};
+  int32_t err = delta.x + delta.y;
+  ivec2 p = a;
+  for (;;) {
+    PSet(dst, p, color);
+    if (p == b) break;
+    const int32_t err2 = 2 * err;
+    if (err2 >= delta.y) {
+      err += delta.y;
+      p.x += step.x;
+    }
+    if (err2 <= delta.x) {
+      err += delta.x;
+      p.y += step.y;
+    }
+  }
+}
+
+void Rect(const Surface& dst, ivec2 p, ivec2 dims, FbColor32 color) {
+  if ((dims.x <= 0) || (dims.y <= 0)) return;
+  FillRect(dst, p, {dims.x, 1}, color);
+  if (dims.y == 1) return;
+  FillRect(dst, {p.x, p.y + dims.y - 1}, {dims.x, 1}, color);
+  if (dims.y == 2) return;
+  FillRect(dst, {p.x, p.y + 1}, {1, dims.y - 2}, color);
+  if (dims.x == 1) return;
+  FillRect(dst, {p.x + dims.x - 1, p.y + 1}, {1, dims.y - 2}, color);
+}
+
+void FillRect(const Surface& dst, ivec2 p, ivec2 dims, FbColor32 color) {
+  ivec2 unused_src_p{0, 0};
+  if (!ClipRect({dst.w, dst.h}, &p, &dims, &unused_src_p)) return;
+  const Pixel* src = SolidRow(color, dims.x);
+  for (int32_t y = p.y; y < p.y + dims.y; ++y) {
+    BlendSpan(dst.row(y) + p.x, src, dims.x, Opts::BLEND_ALPHA,
+              FbColor32::WHITE);
+  }
+}
+
+void Blit(const Surface& dst, ivec2 p, const Surface& src, ivec2 src_p,
+          ivec2 dims, BlendMode mode, FbColor32 mod) {
+  // Clip against the source first, then the destination.
+  ivec2 dst_p_in_src = src_p;
+  ivec2 offset{0, 0};
+  if (!ClipRect({src.w, src.h}, &dst_p_in_src, &dims, &offset)) return;
+  p += offset;
+  src_p = dst_p_in_src;
+  if (!ClipRect({dst.w, dst.h}, &p, &dims, &src_p)) return;
+  for (int32_t y = 0; y < dims.y; ++y) {
+    BlendSpan(dst.row(p.y + y) + p.x, src.row(src_p.y + y) + src_p.x, dims.x,
+              mode, mod);
+  }
+}
+
+}  // namespace fbsoft
+}  // namespace retro
@@ -0,0 +1,83 @@
+#ifndef RETRO_FBSOFT_H_
+#define RETRO_FBSOFT_H_
+
+#include <stdint.h>
+
+#include "glm/vec2.hpp"
+#include "retro/fbcore.h"
+#include "retro/fbgfx.h"
+#include "util/noncopyable.h"
+
+// CPU rasterization routines backing FbGfx::BACKEND_SOFTWARE. Blending follows
+// the same equations SDL uses for the matching SDL_BlendMode so that both
+// backends produce the same pictures. Span blending is vectorized with AVX2
+// and/or SSE2 when the compiler targets them, falling back to scalar code.
+
+namespace retro {
+namespace fbsoft {
+
+// Pixels are 32bit RGBA8888 words (the same layout as FbColor32::value).
+typedef uint32_t Pixel;
+
+typedef FbGfx::PutOptions::BlendMode BlendMode;
+
+// Buffers start on, and have rows padded out to, multiples of this many
+// bytes.
+constexpr int32_t kAlignment = 32;
+
+// A non-owning view of a block of pixels.
+struct Surface {
+  Pixel* pixels;
+  int32_t w;
+  int32_t h;
+  // The distance between the starts of consecutive rows in pixels.
+  int32_t pitch;
+
+  Pixel* row(int32_t y) const { return pixels + y * pitch; }
+};
+
+// An owned, aligned block of pixels, initially cleared to transparent black.
+class Buffer : public util::NonCopyable {
+ public:
+  explicit Buffer(glm::ivec2 dims);
+  ~Buffer();
+
+  Surface surface() const { return {pixels_, w_, h_, pitch_}; }
+
+ private:
+  Pixel* const pixels_;
+  const int32_t w_;
+  const int32_t h_;
+  const int32_t pitch_;
+};
+
+// Fill the whole surface with a color (without blending).
+void Clear(const Surface& dst, FbColor32 color);
+
+// Primitives are alpha blended, as FbGfx's accelerated primitives are.
+void PSet(const Surface& dst, glm::ivec2 p, FbColor32 color);
+void Line(const Surface& dst, glm::ivec2 a, glm::ivec2 b, FbColor32 color);
+// The rectangle at p with dimensions dims.
+void Rect(const Surface& dst, glm::ivec2 p, glm::ivec2 dims, FbColor32 color);
+void FillRect(const Surface& dst, glm::ivec2 p, glm::ivec2 dims,
+              FbColor32 color);
+
+// Copy the dims sized block of src at src_p to p in dst, blending by mode
+// after modulating src by mod. Both rectangles are clipped to their surfaces.
+void Blit(const Surface& dst, glm::ivec2 p, const Surface& src,
+          glm::ivec2 src_p, glm::ivec2 dims, BlendMode mode, FbColor32 mod);
+
+// Blend n pixels of src modulated by mod onto dst. This is the kernel behind
+// Blit and FillRect.
+void BlendSpan(Pixel* dst, const Pixel* src, int32_t n, BlendMode mode,
+               FbColor32 mod);
+
+// Expand n palette indices to the pixels they index in a 256 entry palette.
+// Lookups are gathered 8 at a time with AVX2.
+void ExpandIndexed(Pixel* dst, const uint8_t* src, int32_t n,
+                   const Pixel* palette);
+
+}  // namespace fbsoft
+}  // namespace retro
+
+#endif  // RETRO_FBSOFT_H_
@@ -0,0 +1,196 @@
+#include "retro/fbsoft.h"
+
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "glm/vec2.hpp"
+#include "gtest/gtest.h"
+#include "retro/fbcore.h"
+
+namespace retro {
+namespace fbsoft {
+namespace {
+using glm::ivec2;
+typedef FbGfx::PutOptions Opts;
+
+constexpr BlendMode kModes[] = {Opts::BLEND_NONE, Opts::BLEND_ALPHA,
+                                Opts::BLEND_ADD, Opts::BLEND_MOD};
+
+uint32_t Channel(Pixel p, int i) { return (p >> (24 - i * 8)) & 0xff; }
+
+// A pixel blended the way SDL documents for each SDL_BlendMode, in floating
+// point, after modulating src by mod (SDL's color and alpha mod).
+void SdlBlend(Pixel dst, Pixel src, BlendMode mode, Pixel mod, double out[4]) {
+  double s[4];
+  double d[4];
+  for (int i = 0; i < 4; ++i) {
+    s[i] = Channel(src, i) * Channel(mod, i) / 255.0;
+    d[i] = Channel(dst, i);
+  }
+  const double s_a = s[3] / 255.0;
+  for (int i = 0; i < 4; ++i) {
+    switch (mode) {
+      case Opts::BLEND_NONE:
+        out[i] = s[i];
+        break;
+      case Opts::BLEND_ALPHA:
+        // dstRGB = srcRGB * srcA + dstRGB * (1 - srcA)
+        // dstA = srcA + dstA * (1 - srcA)
+        out[i] = (i == 3 ? s[i] : s[i] * s_a) + d[i] * (1.0 - s_a);
+        break;
+      case Opts::BLEND_ADD:
+        // dstRGB = srcRGB * srcA + dstRGB, dstA = dstA
+        out[i] = i == 3 ? d[i] : std::min(s[i] * s_a + d[i], 255.0);
+        break;
+      case Opts::BLEND_MOD:
+        // dstRGB = srcRGB * dstRGB, dstA = dstA
+        out[i] = i == 3 ? d[i] : s[i] * d[i] / 255.0;
+        break;
+    }
+  }
+}
+
+std::vector<Pixel> RandomPixels(std::mt19937* rng, int32_t n) {
+  std::vector<Pixel> pixels(n);
+  for (Pixel& p : pixels) p = (*rng)();
+  // Make sure the edge cases of alpha turn up.
+  if (n > 0) pixels[0] &= 0xffffff00;
+  if (n > 1) pixels[1] |= 0x000000ff;
+  return pixels;
+}
+
+// Fill a surface with pixels numbered from 1 in row-major order.
+void Number(const Surface& s) {
+  for (int32_t y = 0; y < s.h; ++y) {
+    for (int32_t x = 0; x < s.w; ++x) s.row(y)[x] = y * s.w + x + 1;
+  }
+}
+}  // namespace
+
+TEST(FbSoftTest, blendSpan_vectorMatchesScalar) {
+  std::mt19937 rng(7);
+  const Pixel mods[] = {FbColor32::WHITE, 0x80c0ff40, 0xff00ff7f};
+  for (BlendMode mode : kModes) {
+    for (Pixel mod : mods) {
+      // Lengths that aren't multiples of the 4 and 8 pixel vectors leave
+      // tails for the scalar loop.
+      for (int32_t n = 1; n <= 37; ++n) {
+        const std::vector<Pixel> src = RandomPixels(&rng, n);
+        const std::vector<Pixel> dst = RandomPixels(&rng, n);
+
+        std::vector<Pixel> span = dst;
+        BlendSpan(span.data(), src.data(), n, mode, mod);
+        // Spans of one pixel never reach the vector kernels.
+        std::vector<Pixel> scalar = dst;
+        for (int32_t i = 0; i < n; ++i) {
+          BlendSpan(&scalar[i], &src[i], 1, mode, mod);
+        }
+        ASSERT_EQ(span, scalar) << "Mode " << mode << ", mod " << std::hex
+                                << mod << std::dec << ", length " << n;
+      }
+    }
+  }
+}
+
+TEST(FbSoftTest, blendSpan_matchesSdlEquations) {
+  std::mt19937 rng(13);
+  const Pixel mods[] = {FbColor32::WHITE, 0x80c0ff40};
+  for (BlendMode mode : kModes) {
+    for (Pixel mod : mods) {
+      constexpr int32_t kN = 1021;
+      const std::vector<Pixel> src = RandomPixels(&rng, kN);
+      const std::vector<Pixel> dst = RandomPixels(&rng, kN);
+      std::vector<Pixel> out = dst;
+      BlendSpan(out.data(), src.data(), kN, mode, mod);
+
+      for (int32_t i = 0; i < kN; ++i) {
+        double expected[4];
+        SdlBlend(dst[i], src[i], mode, mod, expected);
+        for (int c = 0; c < 4; ++c) {
+          // Each product is rounded to 8 bits, so allow for one step of error.
+          ASSERT_LE(std::fabs(Channel(out[i], c) - expected[c]), 1.0)
+              << "Mode " << mode << ", mod " << std::hex << mod << ", dst "
+              << dst[i] << ", src " << src[i] << ", out " << out[i]
+              << std::dec << ", channel " << c;
+        }
+      }
+    }
+  }
+}
+
+TEST(FbSoftTest, blendSpan_exactAtAlphaExtremes) {
+  constexpr Pixel kDst = 0x20406080;
+  const auto blend = [](Pixel src, BlendMode mode) {
+    Pixel out = kDst;
+    BlendSpan(&out, &src, 1, mode, FbColor32::WHITE);
+    return out;
+  };
+  EXPECT_EQ(blend(0x11223300, Opts::BLEND_ALPHA), kDst);
+  EXPECT_EQ(blend(0x112233ff, Opts::BLEND_ALPHA), 0x112233ffu);
+  EXPECT_EQ(blend(0xffffffff, Opts::BLEND_MOD), kDst);
+  EXPECT_EQ(blend(0xf0f0f0ff, Opts::BLEND_ADD), 0xffffff80u);
+}
+
+TEST(FbSoftTest, blit_clipsAtEveryEdge) {
+  const Buffer src_buffer({4, 3});
+  const Surface src = src_buffer.surface();
+  Number(src);
+  const Buffer dst_buffer({5, 4});
+  const Surface dst = dst_buffer.surface();
+
+  // Every placement of every size of block, including those hanging off any
+  // combination of edges of either surface.
+  for (int32_t p_y = -4; p_y <= 5; ++p_y) {
+    for (int32_t p_x = -5; p_x <= 6; ++p_x) {
+      for (int32_t src_y = -2; src_y <= 3; ++src_y) {
+        for (int32_t src_x = -2; src_x <= 4; ++src_x) {
+          for (ivec2 dims : {ivec2(1, 1), ivec2(2, 3), ivec2(4, 3),
+                             ivec2(6, 5), ivec2(0, 2)}) {
+            const ivec2 p(p_x, p_y);
+            const ivec2 src_p(src_x, src_y);
+            Clear(dst, FbColor32(0));
+            Blit(dst, p, src, src_p, dims, Opts::BLEND_NONE,
+                 FbColor32::WHITE);
+
+            for (int32_t y = 0; y < dst.h; ++y) {
+              for (int32_t x = 0; x < dst.w; ++x) {
+                const ivec2 offset = ivec2(x, y) - p;
+                const ivec2 from = src_p + offset;
+                const bool covered =
+                    (offset.x >= 0) && (offset.y >= 0) &&
+                    (offset.x < dims.x) && (offset.y < dims.y) &&
+                    (from.x >= 0) && (from.y >= 0) && (from.x < src.w) &&
+                    (from.y < src.h);
+                const Pixel expected = covered ? src.row(from.y)[from.x] : 0;
+                ASSERT_EQ(dst.row(y)[x], expected)
+                    << "At (" << x << ", " << y << ") blitting (" << src_x
+                    << ", " << src_y << ") " << dims.x << "x" << dims.y
+                    << " to (" << p_x << ", " << p_y << ")";
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(FbSoftTest, blit_blendsWithMode) {
+  const Buffer src_buffer({2, 1});
+  const Surface src = src_buffer.surface();
+  src.row(0)[0] = 0xff000080;
+  src.row(0)[1] = 0x00ff00ff;
+  const Buffer dst_buffer({2, 1});
+  const Surface dst = dst_buffer.surface();
+  Clear(dst, FbColor32::BLUE);
+
+  Blit(dst, {0, 0}, src, {0, 0}, {2, 1}, Opts::BLEND_ALPHA, FbColor32::WHITE);
+  EXPECT_EQ(dst.row(0)[0], 0x80007fffu);
+  EXPECT_EQ(dst.row(0)[1], 0x00ff00ffu);
+}
+
+}  // namespace fbsoft
+}  // namespace retro
@@ -0,0 +1,73 @@
+#include "retro/fbtargetpool.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "glog/logging.h"
+
+using glm::ivec2;
+using std::unique_ptr;
+
+namespace retro {
+
+FbTargetPool::Handle& FbTargetPool::Handle::operator=(Handle&& other) {
+  if (this != &other) {
+    if (img_ != nullptr) pool_->Release(format_, std::move(img_));
+    pool_ = other.pool_;
+    format_ = other.format_;
+    img_ = std::move(other.img_);
+  }
+  return *this;
+}
+
+FbTargetPool::Handle::~Handle() {
+  if (img_ != nullptr) pool_->Release(format_, std::move(img_));
+}
+
+FbTargetPool::FbTargetPool() : created_count_(0) {}
+
+FbTargetPool::Handle FbTargetPool::Acquire(ivec2 dims, uint32_t format) {
+  CHECK_GT(dims.x, 0) << "Bad target width: " << dims.x;
+  CHECK_GT(dims.y, 0) << "Bad target height: " << dims.y;
+
+  auto free_iter = free_.find({dims.x, dims.y, format});
+  if ((free_iter != free_.end()) && !free_iter->second.empty()) {
+    // Take the most recently released, leaving the idlest to age out.
+    unique_ptr<FbImg> img = std::move(free_iter->second.back().img);
+    free_iter->second.pop_back();
+    return Handle(this, format, std::move(img));
+  }
+  ++created_count_;
+  return Handle(this, format, FbImg::OfSize(dims, format));
+}
+
+void FbTargetPool::Release(uint32_t format, unique_ptr<FbImg> img) {
+  released_.emplace_back(Key{img->width(), img->height(), format},
+                         std::move(img));
+}
+
+void FbTargetPool::Recycle() {
+  for (auto free_iter = free_.begin(); free_iter != free_.end();) {
+    std::vector<Pooled>& pooled = free_iter->second;
+    for (Pooled& target : pooled) ++target.idle_recycles;
+    pooled.erase(std::remove_if(pooled.begin(), pooled.end(),
+                                [](const Pooled& target) {
+                                  return target.idle_recycles >
+                                         kMaxIdleRecycles;
+                                }),
+                 pooled.end());
+    free_iter = pooled.empty() ? free_.erase(free_iter) : std::next(free_iter);
+  }
+  for (auto& [key, img] : released_) {
+    free_[key].push_back({std::move(img), 0});
+  }
+  released_.clear();
+}
+
+size_t FbTargetPool::free_count() const {
+  size_t count = 0;
+  for (const auto& [key, pooled] : free_) count += pooled.size();
+  return count;
+}
+
+}  // namespace retro
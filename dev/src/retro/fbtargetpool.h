@@ -0,0 +1,110 @@
+#ifndef RETRO_FBTARGETPOOL_H_
+#define RETRO_FBTARGETPOOL_H_
+
+#include <stdint.h>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "SDL.h"
+#include "glm/vec2.hpp"
+#include "retro/fbimg.h"
+#include "util/noncopyable.h"
+
+namespace retro {
+
+// Recycles render targets for transient uses like intermediate passes of an
+// effect, so that steady state frames create no textures:
+//
+//   FbTargetPool::Handle scratch = FbGfx::GetTargetPool().Acquire({320, 240});
+//   FbGfx::Cls(*scratch);
+//   ...
+//   FbGfx::Put(*scratch, {0, 0});
+//
+// Targets are returned to the pool when their handle is destroyed, but only
+// become available again at the next Recycle (which FbGfx::Flip calls for
+// FbGfx::GetTargetPool()), so the renderer is never handed a target that's
+// still in use by queued drawing this frame. Targets that go unused for
+// kMaxIdleRecycles recycles are freed.
+//
+// The contents of an acquired target are undefined. The pool must outlive
+// its handles. Like FbGfx, this can only be used from the thread that called
+// FbGfx::Screen.
+class FbTargetPool : public util::NonCopyable {
+ public:
+  static constexpr uint32_t kMaxIdleRecycles = 120;
+
+  // A pooled target, returned to its pool on destruction.
+  class Handle : public util::NonCopyable {
+    friend class FbTargetPool;
+
+   public:
+    Handle(Handle&& other)
+        : pool_(other.pool_),
+          format_(other.format_),
+          img_(std::move(other.img_)) {}
+    Handle& operator=(Handle&& other);
+    ~Handle();
+
+    const FbImg& img() const { return *img_; }
+    const FbImg& operator*() const { return *img_; }
+    const FbImg* operator->() const { return img_.get(); }
+
+   private:
+    Handle(FbTargetPool* pool, uint32_t format, std::unique_ptr<FbImg> img)
+        : pool_(pool), format_(format), img_(std::move(img)) {}
+
+    FbTargetPool* pool_;
+    uint32_t format_;
+    std::unique_ptr<FbImg> img_;
+  };
+
+  FbTargetPool();
+
+  // Acquire a render target of the given dimensions and SDL_PixelFormatEnum,
+  // creating one if none are free.
+  Handle Acquire(glm::ivec2 dims, uint32_t format = SDL_PIXELFORMAT_RGBA8888);
+
+  // Makes targets released since the last call available again, and frees
+  // any that have gone unused for too long.
+  void Recycle();
+
+  // Targets currently free for Acquire.
+  size_t free_count() const;
+  // Targets created by the pool, in total.
+  uint64_t created_count() const { return created_count_; }
+
+ private:
+  struct Key {
+    int32_t w;
+    int32_t h;
+    uint32_t format;
+    bool operator==(const Key& other) const {
+      return (w == other.w) && (h == other.h) && (format == other.format);
+    }
+  };
+  struct KeyHash {
+    size_t operator()(const Key& key) const {
+      return (static_cast<size_t>(key.w) * 73856093) ^
+             (static_cast<size_t>(key.h) * 19349663) ^
+             (static_cast<size_t>(key.format) * 83492791);
+    }
+  };
+  struct Pooled {
+    std::unique_ptr<FbImg> img;
+    // Recycles since the target was last released.
+    uint32_t idle_recycles;
+  };
+
+  void Release(uint32_t format, std::unique_ptr<FbImg> img);
+
+  std::unordered_map<Key, std::vector<Pooled>, KeyHash> free_;
+  // Released since the last Recycle.
+  std::vector<std::pair<Key, std::unique_ptr<FbImg>>> released_;
+  uint64_t created_count_;
+};
+
+}  // namespace retro
+
+#endif  // RETRO_FBTARGETPOOL_H_
@@ -0,0 +1,46 @@
+#include "retro/fbtestscreen.h"
+
+#include "glog/logging.h"
+
+using glm::ivec2;
+
+namespace retro {
+namespace fbtest {
+namespace {
+bool screen_open = false;
+}  // namespace
+
+void OpenHeadlessScreen(ivec2 res, FbGfx::Backend backend) {
+  if (screen_open) {
+    CHECK(FbGfx::GetResolution() == res)
+        << "The test screen is already open at another resolution.";
+    CHECK_EQ(FbGfx::GetBackend(), backend)
+        << "The test screen is already open with another backend.";
+    return;
+  }
+  FbGfx::Screen(
+      res, false, "FbTestScreen", {-1, -1},
+      FbGfx::ScreenOptions().SetHeadless(true).SetBackend(backend));
+  screen_open = true;
+}
+
+std::vector<uint32_t> ScreenRow(int32_t y) {
+  ivec2 dims;
+  const std::vector<uint32_t> frame = FbGfx::ReadFrame(&dims);
+  CHECK((y >= 0) && (y < dims.y)) << "Row out of range: " << y;
+  return std::vector<uint32_t>(frame.begin() + y * dims.x,
+                               frame.begin() + (y + 1) * dims.x);
+}
+
+uint32_t DrawCalls(const std::function<void()>& draw) {
+  FbGfx::Cls();
+  FbGfx::Flip();
+  const uint32_t empty_calls = FbGfx::GetFrameStats().draw_calls;
+  FbGfx::Cls();
+  draw();
+  FbGfx::Flip();
+  return FbGfx::GetFrameStats().draw_calls - empty_calls;
+}
+
+}  // namespace fbtest
+}  // namespace retro
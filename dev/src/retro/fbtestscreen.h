@@ -0,0 +1,36 @@
+#ifndef RETRO_FBTESTSCREEN_H_
+#define RETRO_FBTESTSCREEN_H_
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+#include "glm/vec2.hpp"
+#include "retro/fbgfx.h"
+
+// Support for tests that draw through FbGfx on a headless screen.
+//
+// Screen loads the system font from kSystemFontPath, which is relative to the
+// dev directory, so tests using this have to run from there (their add_test
+// sets WORKING_DIRECTORY to ${CMAKE_SOURCE_DIR}).
+
+namespace retro {
+namespace fbtest {
+
+// Opens a headless screen with the given resolution and backend. FbGfx can
+// only be initialized once per process, so later calls (from other suites in
+// the same test binary) reuse the screen, which must match.
+void OpenHeadlessScreen(glm::ivec2 res,
+                        FbGfx::Backend backend = FbGfx::BACKEND_ACCELERATED);
+
+// A row of the screen as drawn so far this frame, as RGBA8888 words.
+std::vector<uint32_t> ScreenRow(int32_t y);
+
+// The draw calls a frame drawn by draw takes beyond those of an empty one.
+// Flips twice.
+uint32_t DrawCalls(const std::function<void()>& draw);
+
+}  // namespace fbtest
+}  // namespace retro
+
+#endif  // RETRO_FBTESTSCREEN_H_
@@ -0,0 +1,114 @@
+#include "retro/fbtextlayout.h"
+
+#include <algorithm>
+
+#include "glm/common.hpp"
+#include "glog/logging.h"
+
+using absl::string_view;
+using glm::ivec2;
+
+namespace retro {
+namespace {
+size_t Columns(ivec2 box_dims, ivec2 character_dims) {
+  if ((box_dims.x < character_dims.x) || (box_dims.y < character_dims.y)) {
+    return 0;
+  }
+  return box_dims.x / character_dims.x;
+}
+
+int32_t Top(int32_t a_y, int32_t box_h, int32_t character_h,
+            FbGfx::TextVAlign v_align) {
+  const int32_t lines_height = (box_h / character_h) * character_h;
+  switch (v_align) {
+    case FbGfx::TEXT_ALIGN_V_TOP:
+      return a_y;
+    case FbGfx::TEXT_ALIGN_V_CENTER:
+      return a_y + (box_h - lines_height) / 2;
+    case FbGfx::TEXT_ALIGN_V_BOTTOM:
+      return a_y + box_h - lines_height;
+    default:
+      CHECK(false) << "Invalid vertical text alignment specified: " << v_align;
+  }
+}
+}  // namespace
+
+FbTextLayout::FbTextLayout(string_view text, ivec2 a, ivec2 b,
+                           FbGfx::TextHAlign h_align,
+                           FbGfx::TextVAlign v_align)
+    : a_(glm::min(a, b)),
+      box_dims_(glm::max(a, b) - glm::min(a, b) + ivec2(1)),
+      h_align_(h_align),
+      columns_(Columns(box_dims_, FbGfx::kTextCharacterDims)),
+      top_(Top(a_.y, box_dims_.y, FbGfx::kTextCharacterDims.y, v_align)) {
+  SetText(text);
+}
+
+void FbTextLayout::Append(string_view text) {
+  text_.append(text.data(), text.size());
+  LayoutLastLines();
+}
+
+void FbTextLayout::SetText(string_view text) {
+  text_.assign(text.data(), text.size());
+  line_cursor_ = 0;
+  line_glyph_ = 0;
+  line_i_ = 0;
+  line_y_ = top_;
+  LayoutLastLines();
+}
+
+void FbTextLayout::LayoutLastLines() {
+  // Lines before the last ended because the next character didn't fit, which
+  // appending can't change.
+  run_.Truncate(line_glyph_);
+  if (columns_ == 0) return;
+
+  const ivec2 character_dims = FbGfx::kTextCharacterDims;
+  for (;;) {
+    line_glyph_ = run_.glyphs.size();
+    size_t line_end = text_.size();
+    size_t next_cursor = text_.size();
+    const bool last = (text_.size() - line_cursor_) <= columns_;
+    if (!last) {
+      // A space right after a full line is as good a place to break as any.
+      line_end = line_cursor_ + columns_;
+      next_cursor = line_end;
+      for (size_t i = line_cursor_ + columns_; i > line_cursor_; --i) {
+        if (text_[i] == ' ') {
+          line_end = i;
+          next_cursor = i + 1;
+          break;
+        }
+      }
+    }
+
+    const int32_t line_width =
+        static_cast<int32_t>(line_end - line_cursor_) * character_dims.x;
+    ivec2 dst_p{a_.x, line_y_};
+    switch (h_align_) {
+      case FbGfx::TEXT_ALIGN_H_LEFT:
+        break;
+      case FbGfx::TEXT_ALIGN_H_CENTER:
+        dst_p.x += (box_dims_.x - line_width) / 2;
+        break;
+      case FbGfx::TEXT_ALIGN_H_RIGHT:
+        dst_p.x += box_dims_.x - line_width;
+        break;
+      default:
+        CHECK(false) << "Invalid horizontal text alignment specified: "
+                     << h_align_;
+    }
+    for (size_t c_i = line_cursor_; c_i < line_end; ++c_i) {
+      run_.glyphs.push_back({FbGfx::GlyphSource(text_[c_i]), dst_p});
+      dst_p.x += character_dims.x;
+    }
+
+    if (last) return;
+    line_cursor_ = next_cursor;
+    ++line_i_;
+    line_y_ += character_dims.y;
+  }
+}
+
+}  // namespace retro
@@ -0,0 +1,85 @@
+#ifndef RETRO_FBTEXTLAYOUT_H_
+#define RETRO_FBTEXTLAYOUT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "glm/vec2.hpp"
+#include "retro/fbgfx.h"
+
+namespace retro {
+
+// A string word wrapped into the box with corners a and b (inclusive) as
+// FbGfx::TextParagraph draws it, kept so that it can be drawn any number of
+// times with FbGfx::Text without being laid out again:
+//
+//   FbTextLayout dialog("", {8, 160}, {311, 231});
+//   ...
+//   // Every few frames, reveal another character.
+//   dialog.Append(line.substr(revealed++, 1));
+//   FbGfx::Text(dialog, FbColor32::WHITE);
+//
+// Lines break at the last space that fits (the space itself isn't drawn), or
+// mid-word if a word is longer than a line. Each line is aligned horizontally
+// within the box, and the rows of text the box can hold are aligned
+// vertically within it, so appending text never moves what's already laid
+// out. Lines past the bottom of the box are still laid out. If the box can't
+// hold a single character, nothing is.
+//
+// Like FbGfx, this can only be used from the thread that called
+// FbGfx::Screen.
+class FbTextLayout {
+  friend class FbGfx;
+
+ public:
+  FbTextLayout(absl::string_view text, glm::ivec2 a, glm::ivec2 b,
+               FbGfx::TextHAlign h_align = FbGfx::TEXT_ALIGN_H_LEFT,
+               FbGfx::TextVAlign v_align = FbGfx::TEXT_ALIGN_V_TOP);
+
+  // Adds text to the end of the string, only laying out the last line again.
+  void Append(absl::string_view text);
+  // Replaces the string, laying it all out again.
+  void SetText(absl::string_view text);
+
+  const std::string& text() const { return text_; }
+
+  // Laid out glyphs, in order of the characters they draw (characters that
+  // lines break at don't get one).
+  size_t glyph_count() const { return run_.glyphs.size(); }
+  // Top left of a glyph.
+  glm::ivec2 glyph_p(size_t glyph_i) const {
+    return run_.glyphs[glyph_i].dst_p;
+  }
+
+  int32_t line_count() const {
+    return line_i_ + ((line_cursor_ < text_.size()) ? 1 : 0);
+  }
+
+ private:
+  // Lays out text_ from the start of the last line on.
+  void LayoutLastLines();
+
+  const glm::ivec2 a_;
+  const glm::ivec2 box_dims_;
+  const FbGfx::TextHAlign h_align_;
+  // Characters per line, or 0 if the box can't fit one.
+  const size_t columns_;
+  // Top of the first line.
+  const int32_t top_;
+
+  std::string text_;
+  // The last line's first character, first glyph, index and top.
+  size_t line_cursor_;
+  size_t line_glyph_;
+  int32_t line_i_;
+  int32_t line_y_;
+
+  // Drawing builds the glyphs' vertices lazily.
+  mutable FbGfx::GlyphRun run_;
+};
+
+}  // namespace retro
+
+#endif  // RETRO_FBTEXTLAYOUT_H_
@@ -0,0 +1,83 @@
+#include "retro/fbtextlayout.h"
+
+#include <vector>
+
+#include "glm/vec2.hpp"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace retro {
+namespace {
+using glm::ivec2;
+using ::testing::ElementsAre;
+
+std::vector<ivec2> GlyphPositions(const FbTextLayout& layout) {
+  std::vector<ivec2> positions;
+  for (size_t i = 0; i < layout.glyph_count(); ++i) {
+    positions.push_back(layout.glyph_p(i));
+  }
+  return positions;
+}
+}  // namespace
+
+TEST(FbTextLayoutTest, fitsOnOneLine) {
+  FbTextLayout layout("hi all", {0, 0}, {79, 15});
+  EXPECT_EQ(layout.line_count(), 1);
+  EXPECT_EQ(layout.glyph_count(), 6);
+  EXPECT_EQ(layout.glyph_p(5), ivec2(40, 0));
+}
+
+TEST(FbTextLayoutTest, wrapsAtSpaces) {
+  // Four characters to a line.
+  FbTextLayout layout("ab cd efg", {0, 0}, {31, 31});
+  EXPECT_EQ(layout.line_count(), 3);
+  EXPECT_THAT(GlyphPositions(layout),
+              ElementsAre(ivec2(0, 0), ivec2(8, 0), ivec2(0, 8), ivec2(8, 8),
+                          ivec2(0, 16), ivec2(8, 16), ivec2(16, 16)));
+}
+
+TEST(FbTextLayoutTest, breaksLongWords) {
+  FbTextLayout layout("abcdef", {0, 0}, {31, 31});
+  EXPECT_EQ(layout.line_count(), 2);
+  EXPECT_THAT(GlyphPositions(layout),
+              ElementsAre(ivec2(0, 0), ivec2(8, 0), ivec2(16, 0), ivec2(24, 0),
+                          ivec2(0, 8), ivec2(8, 8)));
+}
+
+TEST(FbTextLayoutTest, alignsLines) {
+  FbTextLayout right("ab", {0, 0}, {31, 19}, FbGfx::TEXT_ALIGN_H_RIGHT,
+                     FbGfx::TEXT_ALIGN_V_BOTTOM);
+  EXPECT_THAT(GlyphPositions(right), ElementsAre(ivec2(16, 4), ivec2(24, 4)));
+
+  FbTextLayout center("ab", {0, 0}, {31, 19}, FbGfx::TEXT_ALIGN_H_CENTER,
+                      FbGfx::TEXT_ALIGN_V_CENTER);
+  EXPECT_THAT(GlyphPositions(center), ElementsAre(ivec2(8, 2), ivec2(16, 2)));
+}
+
+TEST(FbTextLayoutTest, boxTooSmall) {
+  FbTextLayout layout("abc", {0, 0}, {6, 6});
+  EXPECT_EQ(layout.glyph_count(), 0);
+}
+
+TEST(FbTextLayoutTest, append_matchesLayingOutAtOnce) {
+  const std::string text = "the quick brown fox jumps over the lazy dog ";
+  FbTextLayout appended("", {3, 5}, {60, 90}, FbGfx::TEXT_ALIGN_H_CENTER);
+  for (const char c : text) {
+    appended.Append(std::string(1, c));
+    const FbTextLayout whole(appended.text(), {3, 5}, {60, 90},
+                             FbGfx::TEXT_ALIGN_H_CENTER);
+    ASSERT_EQ(GlyphPositions(appended), GlyphPositions(whole))
+        << "After \"" << appended.text() << "\"";
+    ASSERT_EQ(appended.line_count(), whole.line_count());
+  }
+}
+
+TEST(FbTextLayoutTest, setText_replaces) {
+  FbTextLayout layout("abcdefgh", {0, 0}, {31, 31});
+  layout.SetText("ab");
+  EXPECT_EQ(layout.text(), "ab");
+  EXPECT_EQ(layout.line_count(), 1);
+  EXPECT_THAT(GlyphPositions(layout), ElementsAre(ivec2(0, 0), ivec2(8, 0)));
+}
+
+}  // namespace retro
@@ -0,0 +1,54 @@
+#ifndef RETRO_FBVIEWPORT_H_
+#define RETRO_FBVIEWPORT_H_
+
+#include "glm/vec2.hpp"
+
+namespace retro {
+
+// A camera onto a world drawn to the screen: the clip_dims sized area of the
+// world at camera is shown in the clip_dims sized area of the screen at
+// clip_p, and nothing is drawn outside of it. See FbGfx::SetViewport.
+class FbViewport {
+ public:
+  FbViewport(glm::ivec2 camera, glm::ivec2 clip_p, glm::ivec2 clip_dims)
+      : camera_(camera), clip_p_(clip_p), clip_dims_(clip_dims) {}
+
+  const glm::ivec2& camera() const { return camera_; }
+  void SetCamera(glm::ivec2 camera) { camera_ = camera; }
+  const glm::ivec2& clip_p() const { return clip_p_; }
+  const glm::ivec2& clip_dims() const { return clip_dims_; }
+
+  glm::ivec2 ToScreen(glm::ivec2 world_p) const {
+    return world_p - camera_ + clip_p_;
+  }
+  glm::ivec2 ToWorld(glm::ivec2 screen_p) const {
+    return screen_p - clip_p_ + camera_;
+  }
+
+  // Corners (inclusive) of the visible area of the world.
+  glm::ivec2 world_a() const { return camera_; }
+  glm::ivec2 world_b() const { return camera_ + clip_dims_ - glm::ivec2(1); }
+
+  // True if any of the world rectangle with corners a and b (inclusive, with
+  // a <= b) is visible.
+  bool IsVisible(glm::ivec2 a, glm::ivec2 b) const {
+    const glm::ivec2 visible_b = world_b();
+    return (b.x >= camera_.x) && (b.y >= camera_.y) && (a.x <= visible_b.x) &&
+           (a.y <= visible_b.y);
+  }
+
+  bool operator==(const FbViewport& other) const {
+    return (camera_ == other.camera_) && (clip_p_ == other.clip_p_) &&
+           (clip_dims_ == other.clip_dims_);
+  }
+  bool operator!=(const FbViewport& other) const { return !(*this == other); }
+
+ private:
+  glm::ivec2 camera_;
+  glm::ivec2 clip_p_;
+  glm::ivec2 clip_dims_;
+};
+
+}  // namespace retro
+
+#endif  // RETRO_FBVIEWPORT_H_
@@ -0,0 +1,42 @@
+#include "retro/fbviewport.h"
+
+#include "gtest/gtest.h"
+
+namespace retro {
+
+using glm::ivec2;
+
+TEST(FbViewportTest, toScreen_toWorld_roundTrip) {
+  const FbViewport viewport({100, 50}, {10, 20}, {64, 48});
+  EXPECT_EQ(viewport.ToScreen({100, 50}), ivec2(10, 20));
+  EXPECT_EQ(viewport.ToScreen({0, 0}), ivec2(-90, -30));
+  EXPECT_EQ(viewport.ToWorld(viewport.ToScreen({7, -3})), ivec2(7, -3));
+}
+
+TEST(FbViewportTest, worldBounds) {
+  const FbViewport viewport({100, 50}, {10, 20}, {64, 48});
+  EXPECT_EQ(viewport.world_a(), ivec2(100, 50));
+  EXPECT_EQ(viewport.world_b(), ivec2(163, 97));
+}
+
+TEST(FbViewportTest, isVisible_overlapsAndEdges) {
+  const FbViewport viewport({0, 0}, {0, 0}, {10, 10});
+  EXPECT_TRUE(viewport.IsVisible({2, 2}, {4, 4}));
+  // Partially visible.
+  EXPECT_TRUE(viewport.IsVisible({-5, -5}, {0, 0}));
+  EXPECT_TRUE(viewport.IsVisible({9, 9}, {20, 20}));
+  // Just outside each edge.
+  EXPECT_FALSE(viewport.IsVisible({-5, 0}, {-1, 9}));
+  EXPECT_FALSE(viewport.IsVisible({0, -5}, {9, -1}));
+  EXPECT_FALSE(viewport.IsVisible({10, 0}, {15, 9}));
+  EXPECT_FALSE(viewport.IsVisible({0, 10}, {9, 15}));
+}
+
+TEST(FbViewportTest, setCamera_movesVisibleArea) {
+  FbViewport viewport({0, 0}, {0, 0}, {10, 10});
+  viewport.SetCamera({100, 0});
+  EXPECT_FALSE(viewport.IsVisible({0, 0}, {9, 9}));
+  EXPECT_TRUE(viewport.IsVisible({105, 5}, {105, 5}));
+}
+
+}  // namespace retro
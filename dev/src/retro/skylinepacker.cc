@@ -0,0 +1,81 @@
+#include "retro/skylinepacker.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "glog/logging.h"
+
+using glm::ivec2;
+
+namespace retro {
+
+SkylinePacker::SkylinePacker(ivec2 dims)
+    : dims_(dims), skyline_{{0, 0, dims.x}}, used_area_(0) {
+  CHECK((dims.x > 0) && (dims.y > 0))
+      << "Bad packing bin dimensions: " << dims.x << "x" << dims.y;
+}
+
+bool SkylinePacker::Pack(ivec2 dims, ivec2* p) {
+  CHECK((dims.x > 0) && (dims.y > 0))
+      << "Bad packed rectangle dimensions: " << dims.x << "x" << dims.y;
+  int32_t best_top = std::numeric_limits<int32_t>::max();
+  size_t best_i = 0;
+  ivec2 best_p;
+  for (size_t i = 0; i < skyline_.size(); ++i) {
+    const int32_t y = Fit(i, dims);
+    if ((y >= 0) && (y + dims.y < best_top)) {
+      best_top = y + dims.y;
+      best_i = i;
+      best_p = {skyline_[i].x, y};
+    }
+  }
+  if (best_top == std::numeric_limits<int32_t>::max()) return false;
+
+  AddLevel(best_i, best_p, dims);
+  used_area_ += static_cast<int64_t>(dims.x) * dims.y;
+  *p = best_p;
+  return true;
+}
+
+int32_t SkylinePacker::Fit(size_t i, ivec2 dims) const {
+  if (skyline_[i].x + dims.x > dims_.x) return -1;
+  int32_t y = 0;
+  int32_t width_left = dims.x;
+  for (; width_left > 0; ++i) {
+    y = std::max(y, skyline_[i].y);
+    if (y + dims.y > dims_.y) return -1;
+    width_left -= skyline_[i].w;
+  }
+  return y;
+}
+
+void SkylinePacker::AddLevel(size_t i, ivec2 p, ivec2 dims) {
+  skyline_.insert(skyline_.begin() + i, {p.x, p.y + dims.y, dims.x});
+
+  // Trim (or remove) the segments now under the new one.
+  const int32_t right = p.x + dims.x;
+  for (size_t j = i + 1; j < skyline_.size();) {
+    Segment& segment = skyline_[j];
+    if (segment.x >= right) break;
+    const int32_t shrink = right - segment.x;
+    if (segment.w <= shrink) {
+      skyline_.erase(skyline_.begin() + j);
+      continue;
+    }
+    segment.x += shrink;
+    segment.w -= shrink;
+    break;
+  }
+
+  // Merge neighbors at the same height.
+  for (size_t j = 1; j < skyline_.size();) {
+    if (skyline_[j - 1].y == skyline_[j].y) {
+      skyline_[j - 1].w += skyline_[j].w;
+      skyline_.erase(skyline_.begin() + j);
+    } else {
+      ++j;
+    }
+  }
+}
+
+}  // namespace retro
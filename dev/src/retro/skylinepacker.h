@@ -0,0 +1,52 @@
+#ifndef RETRO_SKYLINEPACKER_H_
+#define RETRO_SKYLINEPACKER_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "glm/vec2.hpp"
+
+namespace retro {
+
+// Packs rectangles into a fixed size bin, one at a time, using the skyline
+// bottom-left heuristic: the bin's used area is tracked as a "skyline" of
+// horizontal segments, and each rectangle is placed where its top edge ends
+// up lowest (leftmost on ties). Fast, and good enough for the similarly sized
+// sprite sheets and tilesets we pack.
+class SkylinePacker {
+ public:
+  explicit SkylinePacker(glm::ivec2 dims);
+
+  // Finds room for a rectangle of dims, writing its top left to p. Returns
+  // false (leaving p alone) if it doesn't fit anywhere.
+  bool Pack(glm::ivec2 dims, glm::ivec2* p);
+
+  const glm::ivec2& dims() const { return dims_; }
+  // The fraction of the bin covered by packed rectangles.
+  double occupancy() const {
+    return static_cast<double>(used_area_) / (dims_.x * dims_.y);
+  }
+
+ private:
+  // The bin is used up to y over [x, x + w).
+  struct Segment {
+    int32_t x;
+    int32_t y;
+    int32_t w;
+  };
+
+  // Returns the y a rectangle of dims would rest at if its left edge was at
+  // the start of skyline_[i], or -1 if it doesn't fit there.
+  int32_t Fit(size_t i, glm::ivec2 dims) const;
+  // Raises the skyline over a rectangle placed at p on skyline_[i].
+  void AddLevel(size_t i, glm::ivec2 p, glm::ivec2 dims);
+
+  const glm::ivec2 dims_;
+  // Ordered by x, spanning the width of the bin.
+  std::vector<Segment> skyline_;
+  int64_t used_area_;
+};
+
+}  // namespace retro
+
+#endif  // RETRO_SKYLINEPACKER_H_
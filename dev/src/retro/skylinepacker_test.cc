@@ -0,0 +1,75 @@
+#include "retro/skylinepacker.h"
+
+#include <vector>
+
+#include "glm/vec2.hpp"
+#include "gtest/gtest.h"
+
+using glm::ivec2;
+
+namespace retro {
+namespace {
+struct Placed {
+  ivec2 p;
+  ivec2 dims;
+};
+
+bool Overlaps(const Placed& a, const Placed& b) {
+  return (a.p.x < b.p.x + b.dims.x) && (b.p.x < a.p.x + a.dims.x) &&
+         (a.p.y < b.p.y + b.dims.y) && (b.p.y < a.p.y + a.dims.y);
+}
+}  // namespace
+
+TEST(SkylinePackerTest, pack_placesAtOrigin_whenEmpty) {
+  SkylinePacker packer({64, 64});
+  ivec2 p(-1, -1);
+  ASSERT_TRUE(packer.Pack({10, 20}, &p));
+  EXPECT_EQ(p, ivec2(0, 0));
+}
+
+TEST(SkylinePackerTest, pack_fillsRowBeforeStacking) {
+  SkylinePacker packer({64, 64});
+  ivec2 p;
+  ASSERT_TRUE(packer.Pack({32, 16}, &p));
+  ASSERT_TRUE(packer.Pack({32, 16}, &p));
+  EXPECT_EQ(p, ivec2(32, 0));
+  ASSERT_TRUE(packer.Pack({32, 16}, &p));
+  EXPECT_EQ(p, ivec2(0, 16));
+}
+
+TEST(SkylinePackerTest, pack_returnsFalse_whenTooLarge) {
+  SkylinePacker packer({64, 64});
+  ivec2 p(-1, -1);
+  EXPECT_FALSE(packer.Pack({65, 1}, &p));
+  EXPECT_FALSE(packer.Pack({1, 65}, &p));
+  EXPECT_EQ(p, ivec2(-1, -1));
+}
+
+TEST(SkylinePackerTest, pack_returnsFalse_whenFull) {
+  SkylinePacker packer({64, 64});
+  ivec2 p;
+  for (int32_t i = 0; i < 16; ++i) ASSERT_TRUE(packer.Pack({16, 16}, &p));
+  EXPECT_FALSE(packer.Pack({16, 16}, &p));
+  EXPECT_DOUBLE_EQ(packer.occupancy(), 1.0);
+}
+
+TEST(SkylinePackerTest, pack_neverOverlaps_whenMixedSizes) {
+  SkylinePacker packer({256, 256});
+  std::vector<Placed> placed;
+  for (int32_t i = 0; i < 200; ++i) {
+    const ivec2 dims(1 + (i * 37) % 29, 1 + (i * 53) % 23);
+    ivec2 p;
+    if (!packer.Pack(dims, &p)) continue;
+    EXPECT_GE(p.x, 0);
+    EXPECT_GE(p.y, 0);
+    EXPECT_LE(p.x + dims.x, 256);
+    EXPECT_LE(p.y + dims.y, 256);
+    for (const Placed& other : placed) {
+      EXPECT_FALSE(Overlaps({p, dims}, other));
+    }
+    placed.push_back({p, dims});
+  }
+  EXPECT_GT(placed.size(), 100);
+}
+
+}  // namespace retro
@@ -0,0 +1,347 @@
+#include "tlg_lib/mode7renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+#include "glog/logging.h"
+#include "util/deleterptr.h"
+
+#if defined(__AVX2__)
+#define MODE7_AVX2
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(__amd64__)
+#define MODE7_SSE2
+#include <emmintrin.h>
+#endif
+
+using glm::ivec2;
+using glm::vec2;
+using retro::FbImg;
+
+namespace tlg_lib {
+namespace {
+// Largest stage coordinate (in pixels) a row can reach in 16.16 fixed point.
+constexpr float kMaxCoordinate = 32767.0f;
+
+bool IsPowerOfTwo(int32_t x) { return (x > 0) && ((x & (x - 1)) == 0); }
+
+int32_t Log2(int32_t x) {
+  int32_t log = 0;
+  while ((1 << log) < x) ++log;
+  return log;
+}
+
+// Everything a row needs to sample the layer.
+struct Sampler {
+  const uint32_t* map;
+  const uint32_t* texels;
+  int32_t tile_shift;
+  int32_t tile_mask;
+  int32_t map_pitch_shift;
+  // The layer's dimensions in pixels.
+  int32_t w;
+  int32_t h;
+  bool repeat;
+  uint32_t backdrop;
+
+  uint32_t Sample(int32_t u, int32_t v) const {
+    int32_t x = u >> 16;
+    int32_t y = v >> 16;
+    if (repeat) {
+      x &= w - 1;
+      y &= h - 1;
+    } else if ((static_cast<uint32_t>(x) >= static_cast<uint32_t>(w)) ||
+               (static_cast<uint32_t>(y) >= static_cast<uint32_t>(h))) {
+      return backdrop;
+    }
+    const uint32_t cell =
+        ((y >> tile_shift) << map_pitch_shift) | (x >> tile_shift);
+    return texels[map[cell] + (((y & tile_mask) << tile_shift) |
+                               (x & tile_mask))];
+  }
+};
+
+#if defined(MODE7_SSE2)
+// Renders pixels of a row 4 at a time, returning how many were rendered.
+// Coordinates are computed in vector registers and the texels are fetched one
+// lane at a time (SSE2 has no gather).
+int32_t RowSse2(const Sampler& s, int32_t u, int32_t v, int32_t du,
+                int32_t dv, int32_t n, uint32_t* out) {
+  __m128i u4 = _mm_set_epi32(u + 3 * du, u + 2 * du, u + du, u);
+  __m128i v4 = _mm_set_epi32(v + 3 * dv, v + 2 * dv, v + dv, v);
+  const __m128i du4 = _mm_set1_epi32(4 * du);
+  const __m128i dv4 = _mm_set1_epi32(4 * dv);
+  const __m128i tile_shift = _mm_cvtsi32_si128(s.tile_shift);
+  const __m128i pitch_shift = _mm_cvtsi32_si128(s.map_pitch_shift);
+  const __m128i tile_mask = _mm_set1_epi32(s.tile_mask);
+  const __m128i w_mask = _mm_set1_epi32(s.w - 1);
+  const __m128i h_mask = _mm_set1_epi32(s.h - 1);
+  const __m128i minus_one = _mm_set1_epi32(-1);
+  const __m128i w = _mm_set1_epi32(s.w);
+  const __m128i h = _mm_set1_epi32(s.h);
+  const __m128i backdrop = _mm_set1_epi32(static_cast<int32_t>(s.backdrop));
+
+  alignas(16) int32_t cells[4];
+  alignas(16) int32_t inners[4];
+  int32_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128i x = _mm_srai_epi32(u4, 16);
+    __m128i y = _mm_srai_epi32(v4, 16);
+    __m128i inside = minus_one;
+    if (s.repeat) {
+      x = _mm_and_si128(x, w_mask);
+      y = _mm_and_si128(y, h_mask);
+    } else {
+      inside = _mm_and_si128(
+          _mm_and_si128(_mm_cmpgt_epi32(x, minus_one), _mm_cmplt_epi32(x, w)),
+          _mm_and_si128(_mm_cmpgt_epi32(y, minus_one), _mm_cmplt_epi32(y, h)));
+      // Outside lanes fetch from (0, 0) to stay in bounds.
+      x = _mm_and_si128(x, inside);
+      y = _mm_and_si128(y, inside);
+    }
+    const __m128i cell = _mm_or_si128(
+        _mm_sll_epi32(_mm_sra_epi32(y, tile_shift), pitch_shift),
+        _mm_sra_epi32(x, tile_shift));
+    const __m128i inner =
+        _mm_or_si128(_mm_sll_epi32(_mm_and_si128(y, tile_mask), tile_shift),
+                     _mm_and_si128(x, tile_mask));
+    _mm_store_si128(reinterpret_cast<__m128i*>(cells), cell);
+    _mm_store_si128(reinterpret_cast<__m128i*>(inners), inner);
+    const __m128i texel = _mm_set_epi32(
+        s.texels[s.map[cells[3]] + inners[3]],
+        s.texels[s.map[cells[2]] + inners[2]],
+        s.texels[s.map[cells[1]] + inners[1]],
+        s.texels[s.map[cells[0]] + inners[0]]);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                     _mm_or_si128(_mm_and_si128(inside, texel),
+                                  _mm_andnot_si128(inside, backdrop)));
+    u4 = _mm_add_epi32(u4, du4);
+    v4 = _mm_add_epi32(v4, dv4);
+  }
+  return i;
+}
+#endif  // MODE7_SSE2
+
+#if defined(MODE7_AVX2)
+// As RowSse2, 8 pixels at a time with the map and texel fetches gathered.
+int32_t RowAvx2(const Sampler& s, int32_t u, int32_t v, int32_t du,
+                int32_t dv, int32_t n, uint32_t* out) {
+  const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  __m256i u8 = _mm256_add_epi32(
+      _mm256_set1_epi32(u), _mm256_mullo_epi32(lane, _mm256_set1_epi32(du)));
+  __m256i v8 = _mm256_add_epi32(
+      _mm256_set1_epi32(v), _mm256_mullo_epi32(lane, _mm256_set1_epi32(dv)));
+  const __m256i du8 = _mm256_set1_epi32(8 * du);
+  const __m256i dv8 = _mm256_set1_epi32(8 * dv);
+  const __m128i tile_shift = _mm_cvtsi32_si128(s.tile_shift);
+  const __m128i pitch_shift = _mm_cvtsi32_si128(s.map_pitch_shift);
+  const __m256i tile_mask = _mm256_set1_epi32(s.tile_mask);
+  const __m256i w_mask = _mm256_set1_epi32(s.w - 1);
+  const __m256i h_mask = _mm256_set1_epi32(s.h - 1);
+  const __m256i minus_one = _mm256_set1_epi32(-1);
+  const __m256i w = _mm256_set1_epi32(s.w);
+  const __m256i h = _mm256_set1_epi32(s.h);
+  const __m256i backdrop =
+      _mm256_set1_epi32(static_cast<int32_t>(s.backdrop));
+  const int* map = reinterpret_cast<const int*>(s.map);
+  const int* texels = reinterpret_cast<const int*>(s.texels);
+
+  int32_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i x = _mm256_srai_epi32(u8, 16);
+    __m256i y = _mm256_srai_epi32(v8, 16);
+    __m256i inside = minus_one;
+    if (s.repeat) {
+      x = _mm256_and_si256(x, w_mask);
+      y = _mm256_and_si256(y, h_mask);
+    } else {
+      inside = _mm256_and_si256(
+          _mm256_and_si256(_mm256_cmpgt_epi32(x, minus_one),
+                           _mm256_cmpgt_epi32(w, x)),
+          _mm256_and_si256(_mm256_cmpgt_epi32(y, minus_one),
+                           _mm256_cmpgt_epi32(h, y)));
+      x = _mm256_and_si256(x, inside);
+      y = _mm256_and_si256(y, inside);
+    }
+    const __m256i cell = _mm256_or_si256(
+        _mm256_sll_epi32(_mm256_sra_epi32(y, tile_shift), pitch_shift),
+        _mm256_sra_epi32(x, tile_shift));
+    const __m256i inner = _mm256_or_si256(
+        _mm256_sll_epi32(_mm256_and_si256(y, tile_mask), tile_shift),
+        _mm256_and_si256(x, tile_mask));
+    const __m256i offset = _mm256_i32gather_epi32(map, cell, 4);
+    const __m256i texel =
+        _mm256_i32gather_epi32(texels, _mm256_add_epi32(offset, inner), 4);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                        _mm256_blendv_epi8(backdrop, texel, inside));
+    u8 = _mm256_add_epi32(u8, du8);
+    v8 = _mm256_add_epi32(v8, dv8);
+  }
+  return i;
+}
+#endif  // MODE7_AVX2
+
+int32_t ToFixed(float x) {
+  return static_cast<int32_t>(std::lround(x * 65536.0f));
+}
+
+bool InRange(vec2 p) {
+  return (std::abs(p.x) <= kMaxCoordinate) && (std::abs(p.y) <= kMaxCoordinate);
+}
+}  // namespace
+
+Mode7Renderer::Mode7Renderer(const StageContent* content, uint32_t layer_i,
+                             const Options& options)
+    : content_(content), layer_i_(layer_i), options_(options), dirty_(true) {
+  CHECK_LT(layer_i, content->layer_count()) << "Layer index out of range.";
+  CHECK(IsPowerOfTwo(content->tile_size()))
+      << "Mode7Renderer needs power of two tile sizes, not "
+      << content->tile_size();
+  if (options.repeat) {
+    const ivec2 dims = content->dims() * content->tile_size();
+    CHECK(IsPowerOfTwo(dims.x) && IsPowerOfTwo(dims.y))
+        << "A repeating layer must have power of two dimensions.";
+  }
+}
+
+void Mode7Renderer::Draw(FbImg* target, absl::Span<const Scanline> scanlines) {
+  CHECK(target->is_streaming()) << "Mode7Renderer draws to streaming images.";
+  CHECK_EQ(scanlines.size(), static_cast<size_t>(target->height()))
+      << "Need one scanline per row of the target.";
+  if (dirty_) Flatten();
+  Render(texels_, options_, target->Lock(), scanlines);
+  target->Unlock();
+}
+
+void Mode7Renderer::Flatten() {
+  dirty_ = false;
+  const int32_t tile_size = content_->tile_size();
+  const int32_t tile_texels = tile_size * tile_size;
+  texels_.tile_shift = Log2(tile_size);
+  texels_.map_dims = content_->dims();
+  texels_.map_pitch_shift = Log2(texels_.map_dims.x);
+  texels_.map.assign(texels_.map_dims.y << texels_.map_pitch_shift, 0);
+  // Offset 0 is the transparent tile for empty cells.
+  texels_.texels.assign(tile_texels, 0);
+
+  // Offsets of tiles already copied, keyed by set_i << 24 | tile_i.
+  std::unordered_map<uint32_t, uint32_t> offsets;
+  // Tilesets don't keep their pixels, so those used are decoded again here
+  // (cheaply, if FbGfx has an image cache) and dropped once flattened.
+  struct Decoded {
+    util::deleter_ptr<uint8_t> rgba;
+    ivec2 dims;
+  };
+  std::unordered_map<uint32_t, Decoded> decoded;
+  const std::vector<TileDescriptor>& layer = content_->layer(layer_i_);
+  for (int32_t y = 0; y < texels_.map_dims.y; ++y) {
+    for (int32_t x = 0; x < texels_.map_dims.x; ++x) {
+      const TileDescriptor tile = layer[y * texels_.map_dims.x + x];
+      if (tile.empty()) continue;
+      const Tileset& tileset = content_->tileset(tile.set_i);
+      if (tileset.tile_opacity(tile.tile_i) == Tileset::OPACITY_EMPTY) continue;
+
+      const auto [offset_iter, inserted] = offsets.emplace(
+          (static_cast<uint32_t>(tile.set_i) << 24) | tile.tile_i,
+          static_cast<uint32_t>(texels_.texels.size()));
+      if (inserted) {
+        CHECK_EQ(tileset.tile_w(), static_cast<uint32_t>(tile_size))
+            << "Tile size mismatch.";
+        CHECK_EQ(tileset.tile_h(), static_cast<uint32_t>(tile_size))
+            << "Tile size mismatch.";
+        Decoded& image = decoded[tile.set_i];
+        if (image.rgba == nullptr) {
+          image.rgba = FbImg::LoadRgba(tileset.image_path(), &image.dims);
+        }
+        const int32_t columns = image.dims.x / tile_size;
+        const int32_t src_x = ((tile.tile_i - 1) % columns) * tile_size;
+        const int32_t src_y = ((tile.tile_i - 1) / columns) * tile_size;
+        for (int32_t row = 0; row < tile_size; ++row) {
+          const uint8_t* rgba =
+              image.rgba.get() +
+              ((src_y + row) * image.dims.x + src_x) * 4;
+          for (int32_t x = 0; x < tile_size; ++x, rgba += 4) {
+            texels_.texels.push_back(
+                (static_cast<uint32_t>(rgba[0]) << 24) | (rgba[1] << 16) |
+                (rgba[2] << 8) | rgba[3]);
+          }
+        }
+      }
+      texels_.map[(y << texels_.map_pitch_shift) + x] = offset_iter->second;
+    }
+  }
+}
+
+void Mode7Renderer::Render(const Texels& layer, const Options& options,
+                           const FbImg::PixelSpan& dst,
+                           absl::Span<const Scanline> scanlines) {
+  CHECK_EQ(scanlines.size(), static_cast<size_t>(dst.h))
+      << "Need one scanline per row.";
+  const int32_t tile_size = 1 << layer.tile_shift;
+  const Sampler sampler{layer.map.data(),
+                        layer.texels.data(),
+                        layer.tile_shift,
+                        tile_size - 1,
+                        layer.map_pitch_shift,
+                        layer.map_dims.x * tile_size,
+                        layer.map_dims.y * tile_size,
+                        options.repeat,
+                        options.backdrop};
+
+  for (int32_t row = 0; row < dst.h; ++row) {
+    const Scanline& scanline = scanlines[row];
+    uint32_t* out = dst.row(row);
+    const vec2 end = scanline.p + scanline.dp * static_cast<float>(dst.w);
+    if (scanline.blank || !InRange(scanline.p) || !InRange(end)) {
+      std::fill(out, out + dst.w, options.backdrop);
+      continue;
+    }
+    const int32_t u = ToFixed(scanline.p.x);
+    const int32_t v = ToFixed(scanline.p.y);
+    const int32_t du = ToFixed(scanline.dp.x);
+    const int32_t dv = ToFixed(scanline.dp.y);
+
+    int32_t x = 0;
+#if defined(MODE7_AVX2)
+    x += RowAvx2(sampler, u, v, du, dv, dst.w, out);
+#endif
+#if defined(MODE7_SSE2)
+    x += RowSse2(sampler, u + x * du, v + x * dv, du, dv, dst.w - x, out + x);
+#endif
+    for (; x < dst.w; ++x) out[x] = sampler.Sample(u + x * du, v + x * dv);
+  }
+}
+
+void Mode7Renderer::Affine(const glm::mat2& m, vec2 center, vec2 stage_p,
+                           ivec2 dims, std::vector<Scanline>* scanlines) {
+  scanlines->resize(dims.y);
+  for (int32_t y = 0; y < dims.y; ++y) {
+    // Columns of m are the stage steps per screen pixel right and down.
+    (*scanlines)[y] = {m * (vec2(0.0f, y) - center) + stage_p, m[0], false};
+  }
+}
+
+void Mode7Renderer::Perspective(vec2 camera_p, float heading, float height,
+                                int32_t horizon, float focal, ivec2 dims,
+                                std::vector<Scanline>* scanlines) {
+  const vec2 forward(std::cos(heading), std::sin(heading));
+  const vec2 right(-forward.y, forward.x);
+  scanlines->resize(dims.y);
+  for (int32_t y = 0; y < dims.y; ++y) {
+    if (y <= horizon) {
+      (*scanlines)[y] = {vec2(0.0f), vec2(0.0f), true};
+      continue;
+    }
+    // The distance along forward that this row's center sees, and the stage
+    // pixels a screen pixel covers there.
+    const float distance = height * focal / (y - horizon);
+    const float scale = distance / focal;
+    (*scanlines)[y] = {
+        camera_p + forward * distance - right * (scale * dims.x * 0.5f),
+        right * scale, false};
+  }
+}
+
+}  // namespace tlg_lib
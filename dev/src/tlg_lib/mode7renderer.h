@@ -0,0 +1,124 @@
+#ifndef TLG_LIB_MODE7RENDERER_H_
+#define TLG_LIB_MODE7RENDERER_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "glm/mat2x2.hpp"
+#include "glm/vec2.hpp"
+#include "retro/fbimg.h"
+#include "tlg_lib/stagecontent.h"
+#include "util/noncopyable.h"
+
+namespace tlg_lib {
+
+// Draws a tile layer of a StageContent on the CPU under a transform given per
+// scanline, SNES mode 7 style: rotated and scaled planes, or with a scale that
+// changes down the screen, floors in perspective.
+//
+//   Mode7Renderer floor(content, 0);
+//   std::unique_ptr<FbImg> img = FbImg::OfSizeStreaming({320, 240});
+//   std::vector<Mode7Renderer::Scanline> scanlines;
+//   ...
+//   Mode7Renderer::Perspective(camera_p, heading, 24.0f, 64, 160.0f,
+//                              {320, 240}, &scanlines);
+//   floor.Draw(img.get(), scanlines);
+//   FbGfx::Put(*img, {0, 0});
+//
+// Sampling is nearest neighbour on a 16.16 fixed point grid, 4 (SSE2) or 8
+// (AVX2, with gathers) pixels at a time where available. Tiles must be square
+// with a power of two side. The tiles the layer uses are decoded from its
+// tilesets' image files and copied when it's first drawn, so changes to the
+// layer need a call to MarkDirty.
+//
+// The StageContent must outlive the renderer.
+class Mode7Renderer : public util::NonCopyable {
+ public:
+  // A row of the destination samples the layer (in stage pixels) at p for its
+  // leftmost pixel, stepping by dp for each pixel to the right. Blank rows are
+  // filled with the backdrop.
+  struct Scanline {
+    glm::vec2 p;
+    glm::vec2 dp;
+    bool blank = false;
+  };
+
+  struct Options {
+   public:
+    Options() : backdrop(0), repeat(false) {}
+    // RGBA8888 color of pixels that sample outside of the layer (or of blank
+    // rows). Transparent by default.
+    uint32_t backdrop;
+    // Tile the layer endlessly instead of showing the backdrop around it. The
+    // layer's dimensions in pixels must then be powers of two.
+    bool repeat;
+
+    Options& SetBackdrop(uint32_t backdrop) {
+      this->backdrop = backdrop;
+      return *this;
+    }
+    Options& SetRepeat(bool repeat) {
+      this->repeat = repeat;
+      return *this;
+    }
+  };
+
+  // A layer flattened for sampling: the texels of each distinct tile stored
+  // contiguously (with a transparent tile at offset 0 for empty cells), and a
+  // map from each cell to its tile's offset in texels. Rows of the map are
+  // 1 << map_pitch_shift cells apart.
+  struct Texels {
+    int32_t tile_shift;
+    glm::ivec2 map_dims;
+    int32_t map_pitch_shift;
+    std::vector<uint32_t> map;
+    std::vector<uint32_t> texels;
+  };
+
+  Mode7Renderer(const StageContent* content, uint32_t layer_i,
+                const Options& options = Options());
+
+  // Re-copies the layer's tiles on the next Draw.
+  void MarkDirty() { dirty_ = true; }
+
+  // Renders into a streaming image (see retro::FbImg::OfSizeStreaming), one
+  // scanline per row.
+  void Draw(retro::FbImg* target, absl::Span<const Scanline> scanlines);
+
+  // Scanlines for a plane rotated/scaled by m around center, stage pixel
+  // stage_p landing on center: stage = m * (screen - center) + stage_p.
+  static void Affine(const glm::mat2& m, glm::vec2 center, glm::vec2 stage_p,
+                     glm::ivec2 dims, std::vector<Scanline>* scanlines);
+  // Scanlines for a floor seen from height pixels above camera_p, looking
+  // along heading (radians, 0 being +x and increasing clockwise on screen).
+  // Rows at or above the horizon row are blank; focal is the distance of the
+  // projection plane in pixels (half the width for a 90 degree field of
+  // view).
+  static void Perspective(glm::vec2 camera_p, float heading, float height,
+                          int32_t horizon, float focal, glm::ivec2 dims,
+                          std::vector<Scanline>* scanlines);
+
+  // The renderer's core, exposed for testing: renders scanlines (one per row
+  // of dst) of layer. Rows reaching more than 32767 pixels from the stage
+  // origin don't fit the fixed point grid and are blank.
+  static void Render(const Texels& layer, const Options& options,
+                     const retro::FbImg::PixelSpan& dst,
+                     absl::Span<const Scanline> scanlines);
+
+ private:
+  // Flattens the layer for sampling. This waits for its tilesets' images to
+  // load (for their tile opacities), then decodes them again for their
+  // pixels.
+  void Flatten();
+
+  const StageContent* const content_;
+  const uint32_t layer_i_;
+  const Options options_;
+  bool dirty_;
+  Texels texels_;
+};
+
+}  // namespace tlg_lib
+
+#endif  // TLG_LIB_MODE7RENDERER_H_
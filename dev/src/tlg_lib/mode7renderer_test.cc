@@ -0,0 +1,189 @@
+#include "tlg_lib/mode7renderer.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "glm/vec2.hpp"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace tlg_lib {
+namespace {
+using glm::ivec2;
+using glm::vec2;
+using ::testing::Each;
+using ::testing::ElementsAre;
+using ::testing::ElementsAreArray;
+
+constexpr uint32_t kBackdrop = 0xff00ffff;
+
+// A 2x2 map of 2x2 tiles; the bottom right cell is empty. Texel values encode
+// their stage pixel as 0xYYXX.
+Mode7Renderer::Texels TestLayer() {
+  Mode7Renderer::Texels layer;
+  layer.tile_shift = 1;
+  layer.map_dims = {2, 2};
+  layer.map_pitch_shift = 1;
+  layer.texels = {0, 0, 0, 0};
+  for (int32_t tile_y = 0; tile_y < 2; ++tile_y) {
+    for (int32_t tile_x = 0; tile_x < 2; ++tile_x) {
+      if ((tile_x == 1) && (tile_y == 1)) {
+        layer.map.push_back(0);
+        continue;
+      }
+      layer.map.push_back(static_cast<uint32_t>(layer.texels.size()));
+      for (int32_t y = 0; y < 2; ++y) {
+        for (int32_t x = 0; x < 2; ++x) {
+          layer.texels.push_back(((tile_y * 2 + y) << 8) | (tile_x * 2 + x));
+        }
+      }
+    }
+  }
+  return layer;
+}
+
+int32_t ToFixed(float x) {
+  return static_cast<int32_t>(std::lround(x * 65536.0f));
+}
+
+// What Render should produce for a pixel at 16.16 fixed point (u, v), sampled
+// the slow way.
+uint32_t ReferenceSample(const Mode7Renderer::Texels& layer,
+                         const Mode7Renderer::Options& options, int32_t u,
+                         int32_t v) {
+  const int32_t w = layer.map_dims.x << layer.tile_shift;
+  const int32_t h = layer.map_dims.y << layer.tile_shift;
+  int32_t x = u >> 16;
+  int32_t y = v >> 16;
+  if (options.repeat) {
+    x = ((x % w) + w) % w;
+    y = ((y % h) + h) % h;
+  } else if ((x < 0) || (x >= w) || (y < 0) || (y >= h)) {
+    return options.backdrop;
+  }
+  const int32_t tile_size = 1 << layer.tile_shift;
+  const uint32_t offset =
+      layer.map[((y / tile_size) << layer.map_pitch_shift) + x / tile_size];
+  return layer.texels[offset + (y % tile_size) * tile_size + x % tile_size];
+}
+
+class Target {
+ public:
+  explicit Target(ivec2 dims) : pixels_(dims.x * dims.y), dims_(dims) {}
+
+  retro::FbImg::PixelSpan span() {
+    return {pixels_.data(), dims_.x, dims_.y, dims_.x};
+  }
+  std::vector<uint32_t> Row(int32_t y) const {
+    return std::vector<uint32_t>(pixels_.begin() + y * dims_.x,
+                                 pixels_.begin() + (y + 1) * dims_.x);
+  }
+
+ private:
+  std::vector<uint32_t> pixels_;
+  const ivec2 dims_;
+};
+}  // namespace
+
+TEST(Mode7RendererTest, identity) {
+  Target target({4, 4});
+  std::vector<Mode7Renderer::Scanline> scanlines;
+  Mode7Renderer::Affine(glm::mat2(), {0, 0}, {0.5f, 0.5f}, {4, 4}, &scanlines);
+  Mode7Renderer::Render(TestLayer(), Mode7Renderer::Options(), target.span(),
+                        scanlines);
+
+  EXPECT_THAT(target.Row(0), ElementsAre(0x000, 0x001, 0x002, 0x003));
+  EXPECT_THAT(target.Row(3), ElementsAre(0x300, 0x301, 0, 0));
+}
+
+TEST(Mode7RendererTest, backdropOutsideLayer) {
+  Target target({6, 1});
+  const std::vector<Mode7Renderer::Scanline> scanlines = {
+      {{-0.5f, 0.5f}, {1.0f, 0.0f}}};
+  Mode7Renderer::Render(TestLayer(),
+                        Mode7Renderer::Options().SetBackdrop(kBackdrop),
+                        target.span(), scanlines);
+
+  EXPECT_THAT(target.Row(0),
+              ElementsAre(kBackdrop, 0x000, 0x001, 0x002, 0x003, kBackdrop));
+}
+
+TEST(Mode7RendererTest, repeat) {
+  Target target({6, 1});
+  const std::vector<Mode7Renderer::Scanline> scanlines = {
+      {{-0.5f, 4.5f}, {1.0f, 0.0f}}};
+  Mode7Renderer::Render(TestLayer(), Mode7Renderer::Options().SetRepeat(true),
+                        target.span(), scanlines);
+
+  EXPECT_THAT(target.Row(0),
+              ElementsAre(0x003, 0x000, 0x001, 0x002, 0x003, 0x000));
+}
+
+TEST(Mode7RendererTest, blankRows) {
+  Target target({5, 3});
+  std::vector<Mode7Renderer::Scanline> scanlines;
+  Mode7Renderer::Perspective({2, 2}, 0.0f, 8.0f, 1, 2.5f, {5, 3}, &scanlines);
+  EXPECT_TRUE(scanlines[0].blank);
+  EXPECT_TRUE(scanlines[1].blank);
+  EXPECT_FALSE(scanlines[2].blank);
+
+  // Also blank: rows that leave the fixed point range.
+  scanlines[2] = {{40000.0f, 0.0f}, {1.0f, 0.0f}};
+  Mode7Renderer::Render(TestLayer(),
+                        Mode7Renderer::Options().SetBackdrop(kBackdrop),
+                        target.span(), scanlines);
+  for (int32_t y = 0; y < 3; ++y) EXPECT_THAT(target.Row(y), Each(kBackdrop));
+}
+
+TEST(Mode7RendererTest, perspective_looksAlongHeading) {
+  std::vector<Mode7Renderer::Scanline> scanlines;
+  Mode7Renderer::Perspective({10, 20}, 0.0f, 8.0f, 0, 4.0f, {8, 9},
+                             &scanlines);
+  // Row 8 is 8 rows below the horizon: 4 pixels ahead, 1 pixel per pixel.
+  EXPECT_FLOAT_EQ(scanlines[8].p.x, 14.0f);
+  EXPECT_FLOAT_EQ(scanlines[8].p.y, 16.0f);
+  EXPECT_FLOAT_EQ(scanlines[8].dp.x, 0.0f);
+  EXPECT_FLOAT_EQ(scanlines[8].dp.y, 1.0f);
+}
+
+TEST(Mode7RendererTest, matchesReference) {
+  const ivec2 kDims(37, 16);
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> angle(0.0f, 6.28f);
+  std::uniform_real_distribution<float> scale(0.1f, 2.0f);
+  std::uniform_real_distribution<float> position(-8.0f, 8.0f);
+  const Mode7Renderer::Texels layer = TestLayer();
+
+  for (const bool repeat : {false, true}) {
+    const Mode7Renderer::Options options =
+        Mode7Renderer::Options().SetBackdrop(kBackdrop).SetRepeat(repeat);
+    for (int32_t trial = 0; trial < 20; ++trial) {
+      const float a = angle(rng);
+      const float s = scale(rng);
+      const glm::mat2 m(vec2(std::cos(a), std::sin(a)) * s,
+                        vec2(-std::sin(a), std::cos(a)) * s);
+      std::vector<Mode7Renderer::Scanline> scanlines;
+      Mode7Renderer::Affine(m, {18.0f, 8.0f}, {position(rng), position(rng)},
+                            kDims, &scanlines);
+      Target target(kDims);
+      Mode7Renderer::Render(layer, options, target.span(), scanlines);
+
+      for (int32_t y = 0; y < kDims.y; ++y) {
+        // Steps accumulate in fixed point, so the reference does too.
+        const vec2 p = scanlines[y].p;
+        const vec2 dp = scanlines[y].dp;
+        std::vector<uint32_t> expected;
+        for (int32_t x = 0; x < kDims.x; ++x) {
+          expected.push_back(ReferenceSample(
+              layer, options, ToFixed(p.x) + x * ToFixed(dp.x),
+              ToFixed(p.y) + x * ToFixed(dp.y)));
+        }
+        ASSERT_THAT(target.Row(y), ElementsAreArray(expected))
+            << "Row " << y << ", trial " << trial << ", repeat " << repeat;
+      }
+    }
+  }
+}
+
+}  // namespace tlg_lib
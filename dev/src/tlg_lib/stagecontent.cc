@@ -296,22 +296,23 @@ struct TmxTile {
   uint32_t gid : 29, flip_d : 1, flip_v : 1, flip_h : 1;
 };
 
-// Bit field of layout of stage tile descriptor
-struct TileDescriptor {
-  uint32_t tile_i : 24, set_i : 8;
-};
-
 TileDescriptor ToTileDescriptor(const vector<TilesetXmlN>& tilesets,
                                 uint32_t meta_index, TmxTile tile) {
   CHECK_EQ(tile.flip_d | tile.flip_v | tile.flip_h, 0)
       << "Tile flip flags are not allowed.";
-  for (uint32_t i = tilesets.size() - 1; i >= 0; --i) {
-    if (tilesets[i].firstid < tile.gid) {
+  // A gid of 0 is Tiled's "no tile here."
+  if (tile.gid == 0) return {0, 0};
+  for (int32_t i = static_cast<int32_t>(tilesets.size()) - 1; i >= 0; --i) {
+    if (tilesets[i].firstid <= static_cast<int32_t>(tile.gid)) {
       // Include the fact that we don't hold on to the meta tileset in the
       // tileset list by subtracting 1 from every tileset index above it.
-      return {tile.gid - tilesets[i].firstid + 1, i - (i > meta_index ? 1 : 0)};
+      return {tile.gid - tilesets[i].firstid + 1,
+              static_cast<uint32_t>(i) -
+                  (i > static_cast<int32_t>(meta_index) ? 1 : 0)};
     }
   }
+  CHECK(false) << "Tile gid " << tile.gid << " isn't in any tileset.";
+  return {0, 0};
 }
 
 std::tuple<vector<util::Loan<const Tileset>>, uint32_t> LoadTilesets(
@@ -419,7 +420,7 @@ std::unique_ptr<StageContent> StageContent::Load(const string& uri,
     }
   }
 
-  return std::make_unique<StageContent>(
-      std::move(tilesets), std::move(stage_layers), std::move(collision));
+  return std::unique_ptr<StageContent>(new StageContent(
+      std::move(tilesets), std::move(stage_layers), std::move(collision)));
 }
 }  // namespace tlg_lib
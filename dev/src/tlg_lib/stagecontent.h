@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 
+#include "glm/vec2.hpp"
 #include "physics/retro.h"
 #include "tlg_lib/rescache.h"
 #include "tlg_lib/tileset.h"
@@ -12,18 +13,44 @@
 
 // Need to add:
 //     some flavor of "collide" method
-//     need a view-port concept that is passed to draw method
-//     some flavor of draw method (but how is order specified?) ... (by an
-//     index)
 //     need docs
 //     need tests
 
 namespace tlg_lib {
 
+// A single tile of a stage layer. set_i indexes StageContent's (non-meta)
+// tilesets and tile_i is the 1-based index of the tile within that set, with
+// tile_i == 0 meaning there is no tile.
+struct TileDescriptor {
+  uint32_t tile_i : 24, set_i : 8;
+
+  bool empty() const { return tile_i == 0; }
+};
+
 class StageContent : public Loadable {
   friend class ResCache;
 
  public:
+  // Dimensions of the stage (and each of its layers) in tiles.
+  const glm::ivec2& dims() const { return collision_.dims(); }
+  // Side length of a (square) tile in pixels.
+  int32_t tile_size() const {
+    return static_cast<int32_t>(collision_.block_side_length());
+  }
+
+  uint32_t layer_count() const { return static_cast<uint32_t>(layers_.size()); }
+  const std::vector<TileDescriptor>& layer(uint32_t layer_i) const {
+    return layers_[layer_i];
+  }
+  TileDescriptor GetTile(uint32_t layer_i, glm::ivec2 p) const {
+    return layers_[layer_i][p.y * dims().x + p.x];
+  }
+
+  uint32_t tileset_count() const {
+    return static_cast<uint32_t>(tilesets_.size());
+  }
+  const Tileset& tileset(uint32_t set_i) const { return *tilesets_[set_i]; }
+
  private:
   // Members for ResCache ------------------------------------------------------
   static constexpr uint64_t kTypeId = 0x22b86f3bbce132bb;
@@ -32,12 +59,14 @@ class StageContent : public Loadable {
                                             ResCache* cache);
   // ---------------------------------------------------------------------------
   StageContent(std::vector<util::Loan<const Tileset>>&& tilesets,
-               std::vector<std::vector<int32_t>>&& layers,
+               std::vector<std::vector<TileDescriptor>>&& layers,
                physics::retro::BlockGrid&& collision)
-      : tilesets_(tilesets), layers_(layers), collision_(collision) {}
+      : tilesets_(std::move(tilesets)),
+        layers_(std::move(layers)),
+        collision_(std::move(collision)) {}
 
   std::vector<util::Loan<const Tileset>> tilesets_;
-  std::vector<std::vector<int32_t>> layers_;
+  std::vector<std::vector<TileDescriptor>> layers_;
   physics::retro::BlockGrid collision_;
 };
 
@@ -0,0 +1,194 @@
+#include "tlg_lib/tilelayerrenderer.h"
+
+#include <algorithm>
+
+#include "glog/logging.h"
+#include "retro/fbgfx.h"
+
+using glm::ivec2;
+using retro::FbBatch;
+using retro::FbColor32;
+using retro::FbGfx;
+using retro::FbImg;
+using retro::FbRenderQueue;
+using retro::FbViewport;
+
+namespace tlg_lib {
+namespace {
+// Division rounding towards negative infinity (views can start left of or
+// above the stage).
+int32_t FloorDiv(int32_t a, int32_t b) {
+  return (a >= 0) ? (a / b) : -((-a + b - 1) / b);
+}
+
+ivec2 Clamp(ivec2 p, ivec2 lo, ivec2 hi) {
+  return {std::min(std::max(p.x, lo.x), hi.x),
+          std::min(std::max(p.y, lo.y), hi.y)};
+}
+}  // namespace
+
+TileLayerRenderer::TileLayerRenderer(const StageContent* content,
+                                     int32_t chunk_tiles, bool cull_occluded)
+    : content_(content),
+      chunk_tiles_(chunk_tiles),
+      cull_occluded_(cull_occluded),
+      chunk_side_(chunk_tiles * content->tile_size()),
+      chunk_dims_((content->dims().x + chunk_tiles - 1) / chunk_tiles,
+                  (content->dims().y + chunk_tiles - 1) / chunk_tiles),
+      chunks_(content->layer_count()) {
+  CHECK_GT(chunk_tiles, 0) << "Chunks must hold at least one tile.";
+  for (auto& layer_chunks : chunks_) {
+    layer_chunks.resize(chunk_dims_.x * chunk_dims_.y);
+  }
+}
+
+void TileLayerRenderer::MarkDirty(uint32_t layer_i, ivec2 tile_a,
+                                  ivec2 tile_b) {
+  CHECK_LT(layer_i, chunks_.size()) << "Layer index out of range.";
+  if (tile_a.x > tile_b.x) std::swap(tile_a.x, tile_b.x);
+  if (tile_a.y > tile_b.y) std::swap(tile_a.y, tile_b.y);
+  const ivec2 chunk_a =
+      Clamp({FloorDiv(tile_a.x, chunk_tiles_), FloorDiv(tile_a.y, chunk_tiles_)},
+            {0, 0}, chunk_dims_ - ivec2{1, 1});
+  const ivec2 chunk_b =
+      Clamp({FloorDiv(tile_b.x, chunk_tiles_), FloorDiv(tile_b.y, chunk_tiles_)},
+            {0, 0}, chunk_dims_ - ivec2{1, 1});
+  // What's drawn of lower layers depends on this one when culling.
+  for (uint32_t i = cull_occluded_ ? 0 : layer_i; i <= layer_i; ++i) {
+    auto& layer_chunks = chunks_[i];
+    for (int32_t y = chunk_a.y; y <= chunk_b.y; ++y) {
+      for (int32_t x = chunk_a.x; x <= chunk_b.x; ++x) {
+        layer_chunks[y * chunk_dims_.x + x].dirty = true;
+      }
+    }
+  }
+}
+
+void TileLayerRenderer::MarkAllDirty() {
+  for (auto& layer_chunks : chunks_) {
+    for (auto& chunk : layer_chunks) chunk.dirty = true;
+  }
+}
+
+void TileLayerRenderer::DrawLayer(uint32_t layer_i, ivec2 view_p,
+                                  ivec2 view_dims) {
+  InternalDrawLayer(layer_i, view_p, view_dims, -view_p,
+                    [](const FbImg& chunk, ivec2 p) { FbGfx::Put(chunk, p); });
+}
+void TileLayerRenderer::DrawLayer(const FbImg& target, uint32_t layer_i,
+                                  ivec2 view_p, ivec2 view_dims) {
+  InternalDrawLayer(layer_i, view_p, view_dims, -view_p,
+                    [&target](const FbImg& chunk, ivec2 p) {
+                      FbGfx::Put(target, chunk, p);
+                    });
+}
+void TileLayerRenderer::DrawLayer(uint32_t layer_i) {
+  const FbViewport& viewport = FbGfx::GetViewport();
+  InternalDrawLayer(layer_i, viewport.camera(), viewport.clip_dims(), {0, 0},
+                    [](const FbImg& chunk, ivec2 p) { FbGfx::Put(chunk, p); });
+}
+void TileLayerRenderer::QueueLayer(FbRenderQueue* queue, uint32_t layer_i,
+                                   uint32_t queue_layer) {
+  const FbViewport& viewport = FbGfx::GetViewport();
+  InternalDrawLayer(layer_i, viewport.camera(), viewport.clip_dims(), {0, 0},
+                    [queue, queue_layer](const FbImg& chunk, ivec2 p) {
+                      queue->Put(queue_layer, 0, chunk, p);
+                    });
+}
+
+void TileLayerRenderer::InternalDrawLayer(uint32_t layer_i, ivec2 view_p,
+                                          ivec2 view_dims, ivec2 draw_offset,
+                                          const PutFunc& put) {
+  CHECK_LT(layer_i, chunks_.size()) << "Layer index out of range.";
+  if ((view_dims.x <= 0) || (view_dims.y <= 0)) return;
+
+  const ivec2 view_b = view_p + view_dims - ivec2{1, 1};
+  const ivec2 chunk_a{FloorDiv(view_p.x, chunk_side_),
+                      FloorDiv(view_p.y, chunk_side_)};
+  const ivec2 chunk_b{FloorDiv(view_b.x, chunk_side_),
+                      FloorDiv(view_b.y, chunk_side_)};
+  // Entirely off of the stage.
+  if ((chunk_b.x < 0) || (chunk_b.y < 0) || (chunk_a.x >= chunk_dims_.x) ||
+      (chunk_a.y >= chunk_dims_.y)) {
+    return;
+  }
+  const ivec2 first = Clamp(chunk_a, {0, 0}, chunk_dims_ - ivec2{1, 1});
+  const ivec2 last = Clamp(chunk_b, {0, 0}, chunk_dims_ - ivec2{1, 1});
+
+  auto& layer_chunks = chunks_[layer_i];
+  for (int32_t y = first.y; y <= last.y; ++y) {
+    for (int32_t x = first.x; x <= last.x; ++x) {
+      Chunk& chunk = layer_chunks[y * chunk_dims_.x + x];
+      if (chunk.dirty) Bake(layer_i, {x, y}, &chunk);
+      if (chunk.empty) continue;
+      put(*chunk.img, ivec2{x, y} * chunk_side_ + draw_offset);
+    }
+  }
+}
+
+void TileLayerRenderer::Bake(uint32_t layer_i, ivec2 chunk_p, Chunk* chunk) {
+  chunk->dirty = false;
+
+  const ivec2 tile_a = chunk_p * chunk_tiles_;
+  const ivec2 tile_b{std::min(tile_a.x + chunk_tiles_, content_->dims().x),
+                     std::min(tile_a.y + chunk_tiles_, content_->dims().y)};
+  const auto& layer = content_->layer(layer_i);
+
+  std::vector<ivec2> drawn;
+  for (int32_t y = tile_a.y; y < tile_b.y; ++y) {
+    for (int32_t x = tile_a.x; x < tile_b.x; ++x) {
+      if (IsDrawn(layer_i, y * content_->dims().x + x)) drawn.push_back({x, y});
+    }
+  }
+  chunk->empty = drawn.empty();
+  if (chunk->empty) {
+    chunk->img.reset();
+    return;
+  }
+
+  const int32_t tile_size = content_->tile_size();
+  if (!chunk->img) chunk->img = FbImg::OfSize((tile_b - tile_a) * tile_size);
+  FbGfx::Cls(*chunk->img, FbColor32::TRANSPARENT_BLACK);
+
+  // Tiles in a layer never overlap, so we can copy them (alpha and all) into
+  // the chunk and leave blending to when the chunk is drawn.
+  const auto copy_opts =
+      FbGfx::PutOptions().SetBlend(FbGfx::PutOptions::BLEND_NONE);
+  batch_.Begin(FbBatch::SORT_TEXTURE);
+  for (const ivec2 p : drawn) {
+    const TileDescriptor tile = layer[p.y * content_->dims().x + p.x];
+    const Tileset& tileset = content_->tileset(tile.set_i);
+    const ivec2 tile_dims(tileset.tile_w(), tileset.tile_h());
+    const int32_t columns = tileset.w() / tileset.tile_w();
+    const int32_t index = tile.tile_i - 1;
+    const ivec2 src_a = ivec2{index % columns, index / columns} * tile_dims;
+    batch_.PutEx(*chunk->img, tileset.image(), (p - tile_a) * tile_size,
+                 copy_opts, src_a, src_a + tile_dims - ivec2{1, 1});
+  }
+  batch_.End();
+}
+
+bool TileLayerRenderer::IsDrawn(uint32_t layer_i, int32_t tile_i) const {
+  const TileDescriptor tile = content_->layer(layer_i)[tile_i];
+  if (tile.empty()) return false;
+  if (content_->tileset(tile.set_i).tile_opacity(tile.tile_i) ==
+      Tileset::OPACITY_EMPTY) {
+    return false;
+  }
+  if (!cull_occluded_) return true;
+  for (uint32_t i = layer_i + 1; i < content_->layer_count(); ++i) {
+    if (IsOpaque(content_->layer(i)[tile_i])) return false;
+  }
+  return true;
+}
+
+bool TileLayerRenderer::IsOpaque(TileDescriptor tile) const {
+  if (tile.empty()) return false;
+  const Tileset& tileset = content_->tileset(tile.set_i);
+  // Tiles of another size don't exactly cover their cell.
+  return (static_cast<int32_t>(tileset.tile_w()) == content_->tile_size()) &&
+         (static_cast<int32_t>(tileset.tile_h()) == content_->tile_size()) &&
+         (tileset.tile_opacity(tile.tile_i) == Tileset::OPACITY_OPAQUE);
+}
+
+}  // namespace tlg_lib
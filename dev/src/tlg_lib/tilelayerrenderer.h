@@ -0,0 +1,109 @@
+#ifndef TLG_LIB_TILELAYERRENDERER_H_
+#define TLG_LIB_TILELAYERRENDERER_H_
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "glm/vec2.hpp"
+#include "retro/fbbatch.h"
+#include "retro/fbimg.h"
+#include "retro/fbrenderqueue.h"
+#include "tlg_lib/stagecontent.h"
+#include "util/noncopyable.h"
+
+namespace tlg_lib {
+
+// Draws the layers of a StageContent by pre-baking them into chunks of
+// chunk_tiles x chunk_tiles tiles, each held in its own render target. Drawing
+// a layer then costs one FbGfx::Put per visible chunk instead of one per tile.
+//
+// Chunks are baked lazily the first time they're visible and are only re-baked
+// after being marked dirty, so callers that change what a layer should look
+// like must call MarkDirty for the affected tiles.
+//
+// Tiles whose pixels are all transparent (see Tileset::tile_opacity) aren't
+// baked. With cull_occluded, neither are tiles under an opaque tile in a higher
+// layer, which assumes that every layer above a drawn layer is drawn after it
+// at the same position, unmodulated and alpha blended: parallax, fading or
+// tinting a higher layer would leave holes in those below it. Culling also
+// makes baking a chunk check the tile in the same cell of every higher layer
+// for each of its tiles, which waits on Tileset::tile_opacity if a tileset's
+// image is still loading. A chunk left with no tiles isn't drawn at all.
+//
+// The StageContent must outlive the renderer. Like FbGfx, this can only be
+// used from the thread that called FbGfx::Screen.
+class TileLayerRenderer : public util::NonCopyable {
+  friend class TileLayerRendererTest;
+
+ public:
+  static constexpr int32_t kDefaultChunkTiles = 16;
+
+  explicit TileLayerRenderer(const StageContent* content,
+                             int32_t chunk_tiles = kDefaultChunkTiles,
+                             bool cull_occluded = false);
+
+  // Marks the chunks covering the tiles in [tile_a, tile_b] (inclusive) of a
+  // layer for re-baking, along with those of the layers below it if they
+  // could be occluded by it.
+  void MarkDirty(uint32_t layer_i, glm::ivec2 tile_a, glm::ivec2 tile_b);
+  void MarkAllDirty();
+
+  // Draws a layer such that stage pixel view_p lands on (0, 0) of the
+  // destination, skipping chunks that don't overlap the view_dims sized area
+  // at view_p.
+  void DrawLayer(uint32_t layer_i, glm::ivec2 view_p, glm::ivec2 view_dims);
+  void DrawLayer(const retro::FbImg& target, uint32_t layer_i,
+                 glm::ivec2 view_p, glm::ivec2 view_dims);
+  // Draws a layer to the screen in stage coordinates, through (and skipping
+  // chunks outside of) FbGfx's viewport.
+  void DrawLayer(uint32_t layer_i);
+  // Queues what DrawLayer(layer_i) would draw on queue instead, at depth 0 of
+  // queue_layer, so that it's ordered against other draws by layer.
+  void QueueLayer(retro::FbRenderQueue* queue, uint32_t layer_i,
+                  uint32_t queue_layer);
+
+  // Dimensions of the chunk grid.
+  const glm::ivec2& chunk_dims() const { return chunk_dims_; }
+  int32_t chunk_tiles() const { return chunk_tiles_; }
+
+ private:
+  struct Chunk {
+    Chunk() : img(nullptr), dirty(true), empty(false) {}
+    std::unique_ptr<retro::FbImg> img;
+    bool dirty;
+    // True if the last bake found no tiles, in which case img isn't kept.
+    bool empty;
+  };
+
+  typedef std::function<void(const retro::FbImg& chunk, glm::ivec2 p)>
+      PutFunc;
+
+  // Puts the chunks overlapping the view, offsetting their stage positions
+  // by draw_offset.
+  void InternalDrawLayer(uint32_t layer_i, glm::ivec2 view_p,
+                         glm::ivec2 view_dims, glm::ivec2 draw_offset,
+                         const PutFunc& put);
+
+  // (Re)bakes a chunk at chunk_p in the chunk grid of a layer.
+  void Bake(uint32_t layer_i, glm::ivec2 chunk_p, Chunk* chunk);
+
+  // True if the tile at index tile_i of a layer's tiles would be visible.
+  bool IsDrawn(uint32_t layer_i, int32_t tile_i) const;
+  // True if a tile completely covers its cell.
+  bool IsOpaque(TileDescriptor tile) const;
+
+  const StageContent* const content_;
+  const int32_t chunk_tiles_;
+  const bool cull_occluded_;
+  const int32_t chunk_side_;
+  const glm::ivec2 chunk_dims_;
+
+  // Chunks in row major order, per layer.
+  std::vector<std::vector<Chunk>> chunks_;
+
+  retro::FbBatch batch_;
+};
+
+}  // namespace tlg_lib
+#endif  // TLG_LIB_TILELAYERRENDERER_H_
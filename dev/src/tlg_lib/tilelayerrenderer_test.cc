@@ -0,0 +1,325 @@
+#include "tlg_lib/tilelayerrenderer.h"
+
+#include <stdio.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_cat.h"
+#include "glm/vec2.hpp"
+#include "glog/logging.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "retro/fbcore.h"
+#include "retro/fbgfx.h"
+#include "retro/fbtestscreen.h"
+#include "tlg_lib/rescache.h"
+#include "tlg_lib/stagecontent.h"
+#include "util/loan.h"
+
+namespace tlg_lib {
+using glm::ivec2;
+using retro::FbColor32;
+using retro::FbGfx;
+using retro::fbtest::DrawCalls;
+using retro::fbtest::ScreenRow;
+using ::testing::ElementsAre;
+
+namespace {
+constexpr uint32_t kRed = FbColor32::RED;
+constexpr uint32_t kGreen = FbColor32::GREEN;
+constexpr uint32_t kBlue = FbColor32::BLUE;
+constexpr uint32_t kBlack = FbColor32::BLACK;
+
+// The stage is 6x2 tiles of 2x2 pixels, so two tile chunks make a 3x1 chunk
+// grid of 4x4 pixel chunks that exactly covers the screen.
+const ivec2 kStageDims{6, 2};
+constexpr int32_t kTileSize = 2;
+constexpr int32_t kChunkTiles = 2;
+const ivec2 kScreenDims = kStageDims * kTileSize;
+
+// Tile ids of the test tileset (tile_i, or gid since its firstgid is 1).
+constexpr uint32_t kRedTile = 1;
+constexpr uint32_t kGreenTile = 2;
+// All transparent, so never baked.
+constexpr uint32_t kEmptyTile = 3;
+// Opaque blue in its left column, transparent in its right.
+constexpr uint32_t kHalfBlueTile = 4;
+
+// Chunk 0 is red, chunk 1 green and chunk 2 has no tiles.
+const std::vector<uint32_t> kBackLayer = {
+    kRedTile, kRedTile, kGreenTile, kGreenTile, 0, 0,  //
+    kRedTile, kRedTile, kGreenTile, kGreenTile, 0, 0};
+// Chunk 0 covers the top left tile of the back layer with an opaque tile and
+// the one next to it with a partial tile, chunk 1 has no tiles and chunk 2
+// only has an empty tile.
+const std::vector<uint32_t> kFrontLayer = {
+    kGreenTile, kHalfBlueTile, 0, 0, kEmptyTile, 0,  //
+    0,          0,             0, 0, 0,          0};
+
+void WriteFile(const std::string& path, const std::string& contents) {
+  FILE* file = fopen(path.c_str(), "wb");
+  CHECK(file) << "Can't write " << path;
+  fwrite(contents.data(), 1, contents.size(), file);
+  fclose(file);
+}
+
+// An uncompressed 32 bit TGA (which stb_image decodes) holding the four tiles
+// side by side.
+std::string TilesetTga() {
+  const uint32_t pixels[] = {kRed, kRed, kGreen, kGreen, 0, 0, kBlue, 0,  //
+                             kRed, kRed, kGreen, kGreen, 0, 0, kBlue, 0};
+  const int32_t w = 4 * kTileSize;
+  const int32_t h = kTileSize;
+  // Image type 2 (true color), 8 bits of alpha, rows stored top to bottom.
+  std::string tga = {0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+  tga += {static_cast<char>(w), 0, static_cast<char>(h), 0, 32, 0x28};
+  for (uint32_t rgba : pixels) {
+    // BGRA byte order.
+    tga += {static_cast<char>(rgba >> 8), static_cast<char>(rgba >> 16),
+            static_cast<char>(rgba >> 24), static_cast<char>(rgba)};
+  }
+  return tga;
+}
+
+std::string Tsx(const std::string& name, const std::string& image) {
+  return absl::StrCat(
+      "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<tileset name=\"", name,
+      "\" tilewidth=\"", kTileSize, "\" tileheight=\"", kTileSize,
+      "\">\n <image source=\"", image, "\"/>\n</tileset>\n");
+}
+
+std::string TmxLayer(const std::string& name, const std::vector<uint32_t>& gids,
+                     const std::string& properties) {
+  return absl::StrCat(
+      " <layer name=\"", name, "\" width=\"", kStageDims.x, "\" height=\"",
+      kStageDims.y, "\">\n", properties, "  <data encoding=\"base64\">",
+      absl::Base64Escape(
+          {reinterpret_cast<const char*>(gids.data()), gids.size() * 4}),
+      "</data>\n </layer>\n");
+}
+
+std::string Tmx() {
+  const std::vector<uint32_t> no_tiles(kStageDims.x * kStageDims.y, 0);
+  return absl::StrCat(
+      "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<map version=\"1.0\" "
+      "tiledversion=\"1.1.5\" orientation=\"orthogonal\" width=\"",
+      kStageDims.x, "\" height=\"", kStageDims.y, "\" tilewidth=\"",
+      kTileSize, "\" tileheight=\"", kTileSize, "\">\n",
+      " <tileset firstgid=\"1\" source=\"tiles.tsx\"/>\n",
+      " <tileset firstgid=\"5\" source=\"collision.tsx\"/>\n",
+      TmxLayer("Back", kBackLayer, ""), TmxLayer("Front", kFrontLayer, ""),
+      TmxLayer("Meta", no_tiles,
+               "  <properties>\n   <property name=\"meta\" type=\"bool\" "
+               "value=\"true\"/>\n  </properties>\n"),
+      "</map>\n");
+}
+}  // namespace
+
+// A friend of TileLayerRenderer so that tests can inspect its chunks. Layers
+// are drawn to a screen the size of the stage on the software backend, whose
+// frame can still be read after Flip.
+class TileLayerRendererTest : public ::testing::Test {
+ protected:
+  static void SetUpTestSuite() {
+    retro::fbtest::OpenHeadlessScreen(kScreenDims, FbGfx::BACKEND_SOFTWARE);
+    const std::string dir = ::testing::TempDir();
+    // Tilesets load their images from paths relative to the working
+    // directory, not to the tileset.
+    WriteFile(dir + "tilelayerrenderer_test.tga", TilesetTga());
+    WriteFile(dir + "tiles.tsx",
+              Tsx("tiles", dir + "tilelayerrenderer_test.tga"));
+    WriteFile(dir + "collision.tsx", Tsx("collision", "unused.png"));
+    WriteFile(dir + "tilelayerrenderer_test.tmx", Tmx());
+  }
+
+  void SetUp() override {
+    stage_ = cache_.Load<StageContent>(::testing::TempDir() +
+                                       "tilelayerrenderer_test.tmx");
+  }
+
+  // The screen rows after clearing it, drawing and flipping.
+  static std::vector<std::vector<uint32_t>> Draw(
+      const std::function<void()>& draw) {
+    FbGfx::Cls();
+    draw();
+    FbGfx::Flip();
+    std::vector<std::vector<uint32_t>> rows;
+    for (int32_t y = 0; y < kScreenDims.y; ++y) rows.push_back(ScreenRow(y));
+    return rows;
+  }
+  static void DrawAll(TileLayerRenderer* renderer, uint32_t layer_i) {
+    renderer->DrawLayer(layer_i, {0, 0}, kScreenDims);
+  }
+
+  static std::vector<bool> DirtyChunks(const TileLayerRenderer& renderer,
+                                       uint32_t layer_i) {
+    std::vector<bool> dirty;
+    for (const auto& chunk : renderer.chunks_[layer_i]) {
+      dirty.push_back(chunk.dirty);
+    }
+    return dirty;
+  }
+  static bool Empty(const TileLayerRenderer& renderer, uint32_t layer_i,
+                    int32_t chunk_x) {
+    return renderer.chunks_[layer_i][chunk_x].empty;
+  }
+  static bool HasImg(const TileLayerRenderer& renderer, uint32_t layer_i,
+                     int32_t chunk_x) {
+    return renderer.chunks_[layer_i][chunk_x].img != nullptr;
+  }
+
+  ResCache cache_;
+  util::Loan<const StageContent> stage_;
+};
+
+TEST_F(TileLayerRendererTest, chunkGridCoversStage) {
+  TileLayerRenderer renderer(stage_.get(), kChunkTiles);
+  EXPECT_EQ(renderer.chunk_dims(), ivec2(3, 1));
+  EXPECT_EQ(renderer.chunk_tiles(), kChunkTiles);
+  // A chunk size that doesn't divide the stage rounds the grid up.
+  EXPECT_EQ(TileLayerRenderer(stage_.get(), 4).chunk_dims(), ivec2(2, 1));
+}
+
+TEST_F(TileLayerRendererTest, drawLayer_bakesTilesAtStagePositions) {
+  TileLayerRenderer renderer(stage_.get(), kChunkTiles);
+  const std::vector<uint32_t> back = {kRed,   kRed,   kRed,   kRed,
+                                      kGreen, kGreen, kGreen, kGreen,
+                                      kBlack, kBlack, kBlack, kBlack};
+  EXPECT_THAT(Draw([&] { DrawAll(&renderer, 0); }),
+              ElementsAre(back, back, back, back));
+
+  // Transparent pixels are baked as they are, and blended when drawn.
+  const std::vector<uint32_t> front_top = {
+      kGreen, kGreen, kBlue,  kBlack, kBlack, kBlack,
+      kBlack, kBlack, kBlack, kBlack, kBlack, kBlack};
+  const std::vector<uint32_t> blank(kScreenDims.x, kBlack);
+  EXPECT_THAT(Draw([&] { DrawAll(&renderer, 1); }),
+              ElementsAre(front_top, front_top, blank, blank));
+}
+
+TEST_F(TileLayerRendererTest, drawLayer_skipsAndClipsChunksOutsideView) {
+  TileLayerRenderer renderer(stage_.get(), kChunkTiles);
+  // Only chunk 1 overlaps the view, so it's drawn at (0, 0) and the others
+  // aren't even baked.
+  const auto rows = Draw([&] { renderer.DrawLayer(0, {4, 0}, {4, 4}); });
+  EXPECT_THAT(rows[0], ElementsAre(kGreen, kGreen, kGreen, kGreen, kBlack,
+                                   kBlack, kBlack, kBlack, kBlack, kBlack,
+                                   kBlack, kBlack));
+  EXPECT_THAT(DirtyChunks(renderer, 0), ElementsAre(true, false, true));
+
+  // Chunks partly in the view are drawn whole and clipped by the destination.
+  const auto clipped = Draw([&] { renderer.DrawLayer(0, {2, 0}, {4, 4}); });
+  EXPECT_THAT(clipped[0], ElementsAre(kRed, kRed, kGreen, kGreen, kGreen,
+                                      kGreen, kBlack, kBlack, kBlack, kBlack,
+                                      kBlack, kBlack));
+}
+
+TEST_F(TileLayerRendererTest, drawLayer_viewLeftOfOrAboveStage) {
+  TileLayerRenderer renderer(stage_.get(), kChunkTiles);
+  // Views ending just short of the stage, which rounding towards zero would
+  // put in chunk 0.
+  EXPECT_EQ(DrawCalls([&] { renderer.DrawLayer(0, {-3, 0}, {2, 4}); }), 0u);
+  EXPECT_EQ(DrawCalls([&] { renderer.DrawLayer(0, {0, -3}, {12, 2}); }), 0u);
+  EXPECT_THAT(DirtyChunks(renderer, 0), ElementsAre(true, true, true));
+
+  // A view overlapping the top left corner of the stage.
+  const auto rows = Draw([&] { renderer.DrawLayer(0, {-2, -1}, kScreenDims); });
+  EXPECT_EQ(rows[0], std::vector<uint32_t>(kScreenDims.x, kBlack));
+  EXPECT_THAT(rows[1], ElementsAre(kBlack, kBlack, kRed, kRed, kRed, kRed,
+                                   kGreen, kGreen, kGreen, kGreen, kBlack,
+                                   kBlack));
+}
+
+TEST_F(TileLayerRendererTest, drawLayer_skipsEmptyChunks) {
+  TileLayerRenderer renderer(stage_.get(), kChunkTiles);
+  Draw([&] {
+    DrawAll(&renderer, 0);
+    DrawAll(&renderer, 1);
+  });
+  // Chunks with no tiles, or only all transparent tiles, keep no image.
+  EXPECT_FALSE(Empty(renderer, 0, 0));
+  EXPECT_TRUE(HasImg(renderer, 0, 0));
+  EXPECT_TRUE(Empty(renderer, 0, 2));
+  EXPECT_FALSE(HasImg(renderer, 0, 2));
+  EXPECT_TRUE(Empty(renderer, 1, 1));
+  EXPECT_TRUE(Empty(renderer, 1, 2));
+  EXPECT_FALSE(HasImg(renderer, 1, 2));
+
+  // Baked layers cost one Put per chunk with tiles.
+  EXPECT_EQ(DrawCalls([&] { DrawAll(&renderer, 0); }), 2u);
+  EXPECT_EQ(DrawCalls([&] { DrawAll(&renderer, 1); }), 1u);
+}
+
+TEST_F(TileLayerRendererTest, cullOccluded_skipsTilesUnderOpaqueTiles) {
+  TileLayerRenderer renderer(stage_.get(), kChunkTiles, true);
+  // The top left tile is under an opaque tile in the front layer, but the one
+  // next to it is only partly covered.
+  const std::vector<uint32_t> top = {kBlack, kBlack, kRed,   kRed,
+                                     kGreen, kGreen, kGreen, kGreen,
+                                     kBlack, kBlack, kBlack, kBlack};
+  const std::vector<uint32_t> bottom = {kRed,   kRed,   kRed,   kRed,
+                                        kGreen, kGreen, kGreen, kGreen,
+                                        kBlack, kBlack, kBlack, kBlack};
+  EXPECT_THAT(Draw([&] { DrawAll(&renderer, 0); }),
+              ElementsAre(top, top, bottom, bottom));
+}
+
+TEST_F(TileLayerRendererTest, markDirty_marksChunksCoveringTiles) {
+  TileLayerRenderer renderer(stage_.get(), kChunkTiles);
+  Draw([&] {
+    DrawAll(&renderer, 0);
+    DrawAll(&renderer, 1);
+  });
+  ASSERT_THAT(DirtyChunks(renderer, 0), ElementsAre(false, false, false));
+
+  // Corners in either order.
+  renderer.MarkDirty(0, {3, 1}, {2, 0});
+  EXPECT_THAT(DirtyChunks(renderer, 0), ElementsAre(false, true, false));
+  // Tiles off of the stage are clamped to the chunks at its edges.
+  renderer.MarkDirty(0, {-4, -1}, {-1, 0});
+  EXPECT_THAT(DirtyChunks(renderer, 0), ElementsAre(true, true, false));
+  renderer.MarkDirty(1, {5, 0}, {9, 3});
+  EXPECT_THAT(DirtyChunks(renderer, 1), ElementsAre(false, false, true));
+  // Without culling, layers below aren't affected.
+  EXPECT_THAT(DirtyChunks(renderer, 0), ElementsAre(true, true, false));
+
+  renderer.MarkAllDirty();
+  EXPECT_THAT(DirtyChunks(renderer, 0), ElementsAre(true, true, true));
+  EXPECT_THAT(DirtyChunks(renderer, 1), ElementsAre(true, true, true));
+}
+
+TEST_F(TileLayerRendererTest, markDirty_cascadesToLowerLayersWhenCulling) {
+  TileLayerRenderer renderer(stage_.get(), kChunkTiles, true);
+  Draw([&] {
+    DrawAll(&renderer, 0);
+    DrawAll(&renderer, 1);
+  });
+
+  renderer.MarkDirty(1, {0, 0}, {0, 0});
+  EXPECT_THAT(DirtyChunks(renderer, 1), ElementsAre(true, false, false));
+  EXPECT_THAT(DirtyChunks(renderer, 0), ElementsAre(true, false, false));
+  // But never to layers above.
+  renderer.MarkDirty(0, {2, 0}, {2, 0});
+  EXPECT_THAT(DirtyChunks(renderer, 1), ElementsAre(true, false, false));
+  EXPECT_THAT(DirtyChunks(renderer, 0), ElementsAre(true, true, false));
+}
+
+TEST_F(TileLayerRendererTest, markDirty_rebakesOnlyDirtyChunksWhenDrawn) {
+  TileLayerRenderer renderer(stage_.get(), kChunkTiles);
+  const auto baked = Draw([&] { DrawAll(&renderer, 0); });
+
+  renderer.MarkDirty(0, {2, 0}, {3, 1});
+  // Drawing a view that doesn't reach chunk 1 leaves it dirty.
+  Draw([&] { renderer.DrawLayer(0, {0, 0}, {4, 4}); });
+  EXPECT_THAT(DirtyChunks(renderer, 0), ElementsAre(false, true, false));
+  // Rebaking it costs more than putting it...
+  EXPECT_GT(DrawCalls([&] { DrawAll(&renderer, 0); }), 2u);
+  EXPECT_THAT(DirtyChunks(renderer, 0), ElementsAre(false, false, false));
+  // ...and gives the same pixels.
+  EXPECT_EQ(Draw([&] { DrawAll(&renderer, 0); }), baked);
+  EXPECT_EQ(DrawCalls([&] { DrawAll(&renderer, 0); }), 2u);
+}
+
+}  // namespace tlg_lib
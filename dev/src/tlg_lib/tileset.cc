@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "glog/logging.h"
+#include "retro/fbgfx.h"
 #include "util/xml.h"
 
 namespace tlg_lib {
@@ -77,13 +78,67 @@ std::unique_ptr<Tileset> Tileset::Load(const std::string& uri,
                                    tileset.tile_h, tileset.name);
 }
 
+std::vector<Tileset::Opacity> Tileset::ClassifyTiles(const uint8_t* rgba,
+                                                     glm::ivec2 dims,
+                                                     uint32_t tile_w,
+                                                     uint32_t tile_h) {
+  const int32_t columns = dims.x / tile_w;
+  const int32_t rows = dims.y / tile_h;
+  std::vector<Opacity> opacity;
+  opacity.reserve(columns * rows);
+  for (int32_t row = 0; row < rows; ++row) {
+    for (int32_t column = 0; column < columns; ++column) {
+      bool any_opaque = false;
+      bool any_transparent = false;
+      for (uint32_t y = 0; y < tile_h; ++y) {
+        // Alpha is the 4th byte of each pixel.
+        const uint8_t* alpha =
+            rgba + ((row * tile_h + y) * dims.x + column * tile_w) * 4 + 3;
+        for (uint32_t x = 0; x < tile_w; ++x, alpha += 4) {
+          any_opaque |= (*alpha != 0);
+          any_transparent |= (*alpha != 255);
+        }
+      }
+      opacity.push_back(!any_opaque         ? OPACITY_EMPTY
+                        : !any_transparent ? OPACITY_OPAQUE
+                                           : OPACITY_PARTIAL);
+    }
+  }
+  return opacity;
+}
+
 Tileset::Tileset(const std::string& image_path, uint32_t tile_w,
                  uint32_t tile_h, const std::string& name)
     : tile_w_(tile_w),
       tile_h_(tile_h),
       name_(name),
-      image_(retro::FbImg::FromFile(image_path)) {}
+      image_path_(image_path),
+      opacity_(std::make_shared<std::vector<Opacity>>()),
+      image_(retro::FbGfx::GetLoader().Load(
+          image_path, [opacity = opacity_, tile_w, tile_h](
+                          const uint8_t* rgba, glm::ivec2 dims) {
+            *opacity = ClassifyTiles(rgba, dims, tile_w, tile_h);
+          })) {}
 
 Tileset::Tileset(uint32_t tile_w, uint32_t tile_h, const std::string& name)
-    : tile_w_(tile_w), tile_h_(tile_h), name_(name), image_(nullptr) {}
+    : tile_w_(tile_w),
+      tile_h_(tile_h),
+      name_(name),
+      image_path_(""),
+      opacity_(nullptr),
+      image_(nullptr) {}
+
+const retro::FbImg& Tileset::image() const {
+  CHECK(image_) << "Meta tileset.";
+  if (!image_->ready()) retro::FbGfx::GetLoader().Wait(*image_);
+  return image_->img();
+}
+
+Tileset::Opacity Tileset::tile_opacity(uint32_t tile_i) const {
+  if (tile_i == 0) return OPACITY_EMPTY;
+  // Makes sure the image, and so opacity_, has finished loading.
+  image();
+  CHECK_LE(tile_i, opacity_->size()) << "Tile index out of range.";
+  return (*opacity_)[tile_i - 1];
+}
 }  // namespace tlg_lib
@@ -1,10 +1,14 @@
 #ifndef TLG_LIB_TILESET_H_
 #define TLG_LIB_TILESET_H_
 
+#include <stdint.h>
 #include <memory>
 #include <string>
+#include <vector>
 
+#include "glm/vec2.hpp"
 #include "retro/fbimg.h"
+#include "retro/fbimgloader.h"
 #include "tlg_lib/rescache.h"
 
 namespace tlg_lib {
@@ -16,22 +20,43 @@ class Tileset : public Loadable {
 
   static std::unique_ptr<Tileset> Load(const std::string& uri, ResCache* cache);
 
+  // How much of a tile's area its pixels cover.
+  enum Opacity : uint8_t {
+    // Every pixel is fully transparent.
+    OPACITY_EMPTY,
+    OPACITY_PARTIAL,
+    // Every pixel is fully opaque.
+    OPACITY_OPAQUE
+  };
+  // Classifies the tile_w x tile_h tiles of an image from its RGBA bytes, in
+  // row major order. Partial tiles on the right and bottom edges are ignored.
+  static std::vector<Opacity> ClassifyTiles(const uint8_t* rgba,
+                                            glm::ivec2 dims, uint32_t tile_w,
+                                            uint32_t tile_h);
+
   const std::string& name() const { return name_; }
   uint32_t tile_w() const { return tile_w_; }
   uint32_t tile_h() const { return tile_h_; }
-  uint32_t w() const {
-    CHECK(image_) << "Meta tileset.";
-    return image_->width();
-  }
-  uint32_t h() const {
+  uint32_t w() const { return image().width(); }
+  uint32_t h() const { return image().height(); }
+  // The tileset image is decoded asynchronously (see retro::FbImgLoader), so
+  // this blocks if it hasn't finished loading yet.
+  const retro::FbImg& image() const;
+  // True once image() can be called without blocking.
+  bool is_image_ready() const {
     CHECK(image_) << "Meta tileset.";
-    return image_->height();
-  }
-  const retro::FbImg& image() const {
-    CHECK(image_) << "Meta tileset.";
-    return *(image_.get());
+    return image_->ready();
   }
   bool is_meta() const { return !image_; }
+  // The file image() is loaded from, for CPU renderers like Mode7Renderer
+  // that need its pixels (see retro::FbImg::LoadRgba). Tilesets don't keep a
+  // copy of their pixels themselves.
+  const std::string& image_path() const { return image_path_; }
+
+  // The opacity of a tile, tile_i being 1-based as in TileDescriptor (so 0 is
+  // OPACITY_EMPTY). Tiles are classified when the image is decoded, so like
+  // image() this blocks if it hasn't finished loading yet.
+  Opacity tile_opacity(uint32_t tile_i) const;
 
  private:
   Tileset(const std::string& image_path, uint32_t tile_w, uint32_t tile_h,
@@ -42,7 +67,10 @@ class Tileset : public Loadable {
   const uint32_t tile_w_;
   const uint32_t tile_h_;
   const std::string name_;
-  std::unique_ptr<retro::FbImg> image_;
+  const std::string image_path_;
+  // Filled in by the image loader's worker once the image is decoded.
+  const std::shared_ptr<std::vector<Opacity>> opacity_;
+  const std::shared_ptr<retro::FbImgLoader::Handle> image_;
 };
 
 }  // namespace tlg_lib
@@ -0,0 +1,49 @@
+#include "tlg_lib/tileset.h"
+
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace tlg_lib {
+namespace {
+
+using ::testing::ElementsAre;
+
+// An RGBA image whose pixels are opaque black or transparent per alphas.
+std::vector<uint8_t> MakeImage(const std::vector<uint8_t>& alphas) {
+  std::vector<uint8_t> rgba;
+  for (uint8_t alpha : alphas) rgba.insert(rgba.end(), {0, 0, 0, alpha});
+  return rgba;
+}
+
+}  // namespace
+
+TEST(TilesetTest, classifyTiles_emptyOpaqueAndPartial) {
+  // Three 2x2 tiles side by side.
+  const std::vector<uint8_t> rgba = MakeImage({0, 0, 255, 255, 255, 0,  //
+                                               0, 0, 255, 255, 128, 0});
+  EXPECT_THAT(Tileset::ClassifyTiles(rgba.data(), {6, 2}, 2, 2),
+              ElementsAre(Tileset::OPACITY_EMPTY, Tileset::OPACITY_OPAQUE,
+                          Tileset::OPACITY_PARTIAL));
+}
+
+TEST(TilesetTest, classifyTiles_rowMajor) {
+  // 1x1 tiles in a 2x2 image.
+  const std::vector<uint8_t> rgba = MakeImage({255, 0,  //
+                                               10, 0});
+  EXPECT_THAT(Tileset::ClassifyTiles(rgba.data(), {2, 2}, 1, 1),
+              ElementsAre(Tileset::OPACITY_OPAQUE, Tileset::OPACITY_EMPTY,
+                          Tileset::OPACITY_PARTIAL, Tileset::OPACITY_EMPTY));
+}
+
+TEST(TilesetTest, classifyTiles_ignoresEdgeRemainder) {
+  // One whole 2x2 tile, plus a column and row that don't make a tile.
+  const std::vector<uint8_t> rgba = MakeImage({255, 255, 0,  //
+                                               255, 255, 0,  //
+                                               0, 0, 0});
+  EXPECT_THAT(Tileset::ClassifyTiles(rgba.data(), {3, 3}, 2, 2),
+              ElementsAre(Tileset::OPACITY_OPAQUE));
+}
+
+}  // namespace tlg_lib
@@ -0,0 +1,93 @@
+#ifndef UTIL_LRUCACHE_H_
+#define UTIL_LRUCACHE_H_
+
+#include <stddef.h>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+#include "glog/logging.h"
+#include "util/noncopyable.h"
+
+namespace util {
+
+// A map holding at most capacity entries, evicting the least recently used
+// entry (by Find or Insert) to make room for new ones.
+//
+// Pointers returned by Find and Insert are valid until their entry is
+// evicted, erased or the cache is cleared.
+template <class K, class V, class Hash = std::hash<K>>
+class LruCache : public NonCopyable {
+ public:
+  explicit LruCache(size_t capacity) : capacity_(capacity) {
+    CHECK_GT(capacity, 0) << "LruCache capacity must be positive.";
+  }
+
+  // Returns the value for key and marks it as most recently used, or returns
+  // nullptr if key isn't cached.
+  V* Find(const K& key) {
+    auto index_iter = index_.find(key);
+    if (index_iter == index_.end()) return nullptr;
+    entries_.splice(entries_.begin(), entries_, index_iter->second);
+    return &(index_iter->second->second);
+  }
+
+  // Caches value for key (replacing any existing value), evicting the least
+  // recently used entry if the cache is full.
+  V* Insert(const K& key, V value) {
+    auto index_iter = index_.find(key);
+    if (index_iter != index_.end()) {
+      index_iter->second->second = std::move(value);
+      entries_.splice(entries_.begin(), entries_, index_iter->second);
+      return &(index_iter->second->second);
+    }
+    entries_.emplace_front(key, std::move(value));
+    index_.emplace(key, entries_.begin());
+    Trim();
+    return &(entries_.front().second);
+  }
+
+  // Returns true if key was cached.
+  bool Erase(const K& key) {
+    auto index_iter = index_.find(key);
+    if (index_iter == index_.end()) return false;
+    entries_.erase(index_iter->second);
+    index_.erase(index_iter);
+    return true;
+  }
+
+  void Clear() {
+    index_.clear();
+    entries_.clear();
+  }
+
+  // Evicts least recently used entries until at most capacity remain.
+  void SetCapacity(size_t capacity) {
+    CHECK_GT(capacity, 0) << "LruCache capacity must be positive.";
+    capacity_ = capacity;
+    Trim();
+  }
+
+  size_t size() const { return entries_.size(); }
+  size_t capacity() const { return capacity_; }
+
+ private:
+  typedef std::list<std::pair<K, V>> EntryList;
+
+  void Trim() {
+    while (entries_.size() > capacity_) {
+      index_.erase(entries_.back().first);
+      entries_.pop_back();
+    }
+  }
+
+  size_t capacity_;
+  // Most recently used first.
+  EntryList entries_;
+  std::unordered_map<K, typename EntryList::iterator, Hash> index_;
+};
+
+}  // namespace util
+
+#endif  // UTIL_LRUCACHE_H_
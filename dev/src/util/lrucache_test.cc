@@ -0,0 +1,75 @@
+#include "util/lrucache.h"
+
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+
+using util::LruCache;
+
+TEST(LruCacheTest, Find_returnsNull_whenEmpty) {
+  LruCache<int, int> cache(2);
+  EXPECT_EQ(cache.Find(1), nullptr);
+}
+
+TEST(LruCacheTest, Find_returnsValue_whenInserted) {
+  LruCache<std::string, int> cache(2);
+  cache.Insert("cat", 7);
+  ASSERT_NE(cache.Find("cat"), nullptr);
+  EXPECT_EQ(*cache.Find("cat"), 7);
+  EXPECT_EQ(cache.size(), 1);
+}
+
+TEST(LruCacheTest, Insert_replacesValue_whenKeyExists) {
+  LruCache<int, int> cache(2);
+  cache.Insert(1, 10);
+  cache.Insert(1, 11);
+  EXPECT_EQ(*cache.Find(1), 11);
+  EXPECT_EQ(cache.size(), 1);
+}
+
+TEST(LruCacheTest, Insert_evictsLeastRecentlyUsed_whenFull) {
+  LruCache<int, int> cache(2);
+  cache.Insert(1, 10);
+  cache.Insert(2, 20);
+  // Touch 1 so that 2 is the least recently used.
+  cache.Find(1);
+  cache.Insert(3, 30);
+  EXPECT_NE(cache.Find(1), nullptr);
+  EXPECT_EQ(cache.Find(2), nullptr);
+  EXPECT_NE(cache.Find(3), nullptr);
+  EXPECT_EQ(cache.size(), 2);
+}
+
+TEST(LruCacheTest, Insert_holdsMoveOnlyValues) {
+  LruCache<int, std::unique_ptr<int>> cache(1);
+  cache.Insert(1, std::make_unique<int>(5));
+  EXPECT_EQ(**cache.Find(1), 5);
+}
+
+TEST(LruCacheTest, Erase_removesEntry) {
+  LruCache<int, int> cache(2);
+  cache.Insert(1, 10);
+  EXPECT_TRUE(cache.Erase(1));
+  EXPECT_FALSE(cache.Erase(1));
+  EXPECT_EQ(cache.Find(1), nullptr);
+}
+
+TEST(LruCacheTest, SetCapacity_evicts_whenShrunk) {
+  LruCache<int, int> cache(3);
+  cache.Insert(1, 10);
+  cache.Insert(2, 20);
+  cache.Insert(3, 30);
+  cache.SetCapacity(1);
+  EXPECT_EQ(cache.size(), 1);
+  EXPECT_NE(cache.Find(3), nullptr);
+}
+
+TEST(LruCacheTest, Clear_removesAll) {
+  LruCache<int, int> cache(2);
+  cache.Insert(1, 10);
+  cache.Insert(2, 20);
+  cache.Clear();
+  EXPECT_EQ(cache.size(), 0);
+  EXPECT_EQ(cache.Find(1), nullptr);
+}
@@ -0,0 +1,105 @@
+#include "util/mappedfile.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "absl/strings/str_cat.h"
+
+namespace util {
+
+#if defined(_WIN32)
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) UnmapViewOfFile(data_);
+  if (mapping_ != nullptr) CloseHandle(mapping_);
+}
+
+StatusOr<std::unique_ptr<MappedFile>> MappedFile::Open(
+    const std::string& path) {
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return IOError(absl::StrCat("Couldn't open ", path, " (error ",
+                                GetLastError(), ")."));
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size)) {
+    const DWORD error = GetLastError();
+    CloseHandle(file);
+    return IOError(
+        absl::StrCat("Couldn't size ", path, " (error ", error, ")."));
+  }
+  // Empty files can't be mapped.
+  if (size.QuadPart == 0) {
+    CloseHandle(file);
+    return std::unique_ptr<MappedFile>(new MappedFile(nullptr, 0, nullptr));
+  }
+  HANDLE mapping =
+      CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  // The mapping keeps the file open.
+  CloseHandle(file);
+  if (mapping == nullptr) {
+    return IOError(absl::StrCat("Couldn't map ", path, " (error ",
+                                GetLastError(), ")."));
+  }
+  const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (data == nullptr) {
+    const DWORD error = GetLastError();
+    CloseHandle(mapping);
+    return IOError(
+        absl::StrCat("Couldn't map ", path, " (error ", error, ")."));
+  }
+  return std::unique_ptr<MappedFile>(
+      new MappedFile(static_cast<const uint8_t*>(data),
+                     static_cast<size_t>(size.QuadPart), mapping));
+}
+
+#else
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) munmap(const_cast<uint8_t*>(data_), size_);
+}
+
+StatusOr<std::unique_ptr<MappedFile>> MappedFile::Open(
+    const std::string& path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    return IOError(
+        absl::StrCat("Couldn't open ", path, " (errno ", errno, ")."));
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) == -1) {
+    const int error = errno;
+    close(fd);
+    return IOError(
+        absl::StrCat("Couldn't stat ", path, " (errno ", error, ")."));
+  }
+  const size_t size = static_cast<size_t>(file_stat.st_size);
+  // Empty files can't be mapped.
+  if (size == 0) {
+    close(fd);
+    return std::unique_ptr<MappedFile>(new MappedFile(nullptr, 0, nullptr));
+  }
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps the file open.
+  const int error = errno;
+  close(fd);
+  if (data == MAP_FAILED) {
+    return IOError(
+        absl::StrCat("Couldn't map ", path, " (errno ", error, ")."));
+  }
+  return std::unique_ptr<MappedFile>(
+      new MappedFile(static_cast<const uint8_t*>(data), size, nullptr));
+}
+
+#endif
+
+}  // namespace util
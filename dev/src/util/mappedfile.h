@@ -0,0 +1,42 @@
+#ifndef UTIL_MAPPEDFILE_H_
+#define UTIL_MAPPEDFILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+
+#include "util/noncopyable.h"
+#include "util/statusor.h"
+
+namespace util {
+
+// A whole file mapped read-only into memory, so that reading it costs no
+// more than paging it in: there's no buffer to allocate and no copy out of
+// the OS's file cache.
+class MappedFile : public util::NonCopyable {
+ public:
+  ~MappedFile();
+
+  // Maps the file at path, returning an IO_ERROR if it can't be opened or
+  // mapped.
+  static util::StatusOr<std::unique_ptr<MappedFile>> Open(
+      const std::string& path);
+
+  // The file's bytes, nullptr if it's empty.
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  MappedFile(const uint8_t* data, size_t size, void* mapping)
+      : data_(data), size_(size), mapping_(mapping) {}
+
+  const uint8_t* data_;
+  size_t size_;
+  // The platform's mapping handle, if any, that must be closed with the view.
+  void* mapping_;
+};
+
+}  // namespace util
+
+#endif  // UTIL_MAPPEDFILE_H_
@@ -0,0 +1,52 @@
+#include "util/mappedfile.h"
+
+#include <stdio.h>
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace util {
+namespace {
+
+std::string WriteTempFile(const std::string& name,
+                          const std::string& contents) {
+  const std::string path = testing::TempDir() + name;
+  FILE* file = fopen(path.c_str(), "wb");
+  fwrite(contents.data(), 1, contents.size(), file);
+  fclose(file);
+  return path;
+}
+
+}  // namespace
+
+TEST(MappedFileTest, open_mapsContents) {
+  const std::string path = WriteTempFile("mappedfile_contents", "mapped!");
+  auto file_or = MappedFile::Open(path);
+  ASSERT_TRUE(file_or.ok());
+  std::unique_ptr<MappedFile> file = file_or.ConsumeValue();
+
+  EXPECT_EQ(file->size(), 7);
+  EXPECT_EQ(std::string(reinterpret_cast<const char*>(file->data()),
+                        file->size()),
+            "mapped!");
+  remove(path.c_str());
+}
+
+TEST(MappedFileTest, open_emptyFile) {
+  const std::string path = WriteTempFile("mappedfile_empty", "");
+  auto file_or = MappedFile::Open(path);
+  ASSERT_TRUE(file_or.ok());
+  std::unique_ptr<MappedFile> file = file_or.ConsumeValue();
+
+  EXPECT_EQ(file->size(), 0);
+  EXPECT_EQ(file->data(), nullptr);
+  remove(path.c_str());
+}
+
+TEST(MappedFileTest, open_missingFileIsIOError) {
+  auto file_or = MappedFile::Open(testing::TempDir() + "mappedfile_missing");
+  EXPECT_FALSE(file_or.ok());
+  EXPECT_EQ(file_or.status().canonical_error_code(), error::IO_ERROR);
+}
+
+}  // namespace util
@@ -0,0 +1,67 @@
+#ifndef UTIL_RADIXSORT_H_
+#define UTIL_RADIXSORT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <array>
+#include <utility>
+#include <vector>
+
+namespace util {
+
+// Stably sorts items in ascending order of key(item), a uint64_t, with a least
+// significant digit radix sort of 8 bits per pass. Passes over bytes that are
+// the same in every key (like unused high bits) are skipped, so sorting n
+// items costs O(n) per byte that actually varies.
+//
+// scratch is resized to match items and left holding garbage; keeping one
+// around between sorts avoids reallocating it.
+template <class T, class KeyFunc>
+void RadixSort(std::vector<T>* items, std::vector<T>* scratch, KeyFunc key) {
+  constexpr int kDigitBits = 8;
+  constexpr int kPasses = 64 / kDigitBits;
+  constexpr size_t kBuckets = size_t{1} << kDigitBits;
+  if (items->size() < 2) return;
+
+  // Count all of the digits in a single pass over the keys.
+  std::vector<std::array<size_t, kBuckets>> counts(kPasses);
+  for (std::array<size_t, kBuckets>& pass_counts : counts) pass_counts.fill(0);
+  for (const T& item : *items) {
+    const uint64_t item_key = key(item);
+    for (int pass = 0; pass < kPasses; ++pass) {
+      ++counts[pass][(item_key >> (pass * kDigitBits)) & (kBuckets - 1)];
+    }
+  }
+
+  scratch->resize(items->size());
+  for (int pass = 0; pass < kPasses; ++pass) {
+    std::array<size_t, kBuckets>& pass_counts = counts[pass];
+    // Every key has the same digit, so this pass wouldn't move anything.
+    const uint64_t digit =
+        (key(items->front()) >> (pass * kDigitBits)) & (kBuckets - 1);
+    if (pass_counts[digit] == items->size()) continue;
+
+    size_t offset = 0;
+    for (size_t& count : pass_counts) {
+      const size_t bucket_size = count;
+      count = offset;
+      offset += bucket_size;
+    }
+    for (T& item : *items) {
+      const uint64_t bucket =
+          (key(item) >> (pass * kDigitBits)) & (kBuckets - 1);
+      (*scratch)[pass_counts[bucket]++] = std::move(item);
+    }
+    items->swap(*scratch);
+  }
+}
+
+// Sorts plain keys.
+inline void RadixSort(std::vector<uint64_t>* keys,
+                      std::vector<uint64_t>* scratch) {
+  RadixSort(keys, scratch, [](uint64_t key) { return key; });
+}
+
+}  // namespace util
+
+#endif  // UTIL_RADIXSORT_H_
@@ -0,0 +1,57 @@
+#include "util/radixsort.h"
+
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace util {
+
+TEST(RadixSortTest, sortsKeys) {
+  std::vector<uint64_t> keys{5, 0xffffffffffffffff, 0, 300, 0x100000000, 7};
+  std::vector<uint64_t> scratch;
+  RadixSort(&keys, &scratch);
+  EXPECT_EQ(keys, std::vector<uint64_t>(
+                      {0, 5, 7, 300, 0x100000000, 0xffffffffffffffff}));
+}
+
+TEST(RadixSortTest, emptyAndSingle) {
+  std::vector<uint64_t> keys;
+  std::vector<uint64_t> scratch;
+  RadixSort(&keys, &scratch);
+  EXPECT_TRUE(keys.empty());
+
+  keys.push_back(42);
+  RadixSort(&keys, &scratch);
+  EXPECT_EQ(keys, std::vector<uint64_t>({42}));
+}
+
+TEST(RadixSortTest, matchesStdSort) {
+  std::mt19937_64 rng(1234);
+  std::vector<uint64_t> keys(1000);
+  for (uint64_t& key : keys) {
+    // Vary a few bytes only, so that some passes are skipped.
+    key = (rng() & 0xff00ff) | (uint64_t{rng() & 0xf} << 56);
+  }
+  std::vector<uint64_t> expected = keys;
+  std::sort(expected.begin(), expected.end());
+
+  std::vector<uint64_t> scratch;
+  RadixSort(&keys, &scratch);
+  EXPECT_EQ(keys, expected);
+}
+
+TEST(RadixSortTest, isStable) {
+  std::vector<std::pair<uint64_t, int>> items{
+      {2, 0}, {1, 1}, {2, 2}, {0x200, 3}, {1, 4}, {0x200, 5}};
+  std::vector<std::pair<uint64_t, int>> scratch;
+  RadixSort(&items, &scratch,
+            [](const std::pair<uint64_t, int>& item) { return item.first; });
+  const std::vector<std::pair<uint64_t, int>> expected{
+      {1, 1}, {1, 4}, {2, 0}, {2, 2}, {0x200, 3}, {0x200, 5}};
+  EXPECT_EQ(items, expected);
+}
+
+}  // namespace util
@@ -0,0 +1,77 @@
+#ifndef UTIL_RINGBUFFER_H_
+#define UTIL_RINGBUFFER_H_
+
+#include <stddef.h>
+#include <utility>
+#include <vector>
+
+#include "glog/logging.h"
+
+namespace util {
+
+// A FIFO queue of at most capacity elements held in a fixed block of storage.
+// Pushing onto a full buffer overwrites its oldest element.
+template <class T>
+class RingBuffer {
+ public:
+  explicit RingBuffer(size_t capacity)
+      : elements_(capacity), head_(0), size_(0) {
+    CHECK_GT(capacity, 0) << "RingBuffer capacity must be positive.";
+  }
+
+  // Appends value, returning false if the oldest element was overwritten to
+  // make room for it.
+  bool Push(T value) {
+    const bool had_room = !full();
+    elements_[(head_ + size_) % capacity()] = std::move(value);
+    if (had_room) {
+      ++size_;
+    } else {
+      head_ = (head_ + 1) % capacity();
+    }
+    return had_room;
+  }
+
+  // The oldest element.
+  const T& front() const {
+    CHECK(!empty()) << "RingBuffer is empty.";
+    return elements_[head_];
+  }
+  T& front() {
+    CHECK(!empty()) << "RingBuffer is empty.";
+    return elements_[head_];
+  }
+
+  // Removes the oldest element.
+  void Pop() {
+    CHECK(!empty()) << "RingBuffer is empty.";
+    head_ = (head_ + 1) % capacity();
+    --size_;
+  }
+
+  // The i-th oldest element.
+  const T& operator[](size_t i) const {
+    DCHECK_LT(i, size_);
+    return elements_[(head_ + i) % capacity()];
+  }
+
+  void Clear() {
+    head_ = 0;
+    size_ = 0;
+  }
+
+  size_t size() const { return size_; }
+  size_t capacity() const { return elements_.size(); }
+  bool empty() const { return size_ == 0; }
+  bool full() const { return size_ == capacity(); }
+
+ private:
+  std::vector<T> elements_;
+  // Index of the oldest element.
+  size_t head_;
+  size_t size_;
+};
+
+}  // namespace util
+
+#endif  // UTIL_RINGBUFFER_H_
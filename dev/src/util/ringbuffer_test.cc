@@ -0,0 +1,63 @@
+#include "util/ringbuffer.h"
+
+#include "gtest/gtest.h"
+
+namespace util {
+
+TEST(RingBufferTest, startsEmpty) {
+  RingBuffer<int> buffer(4);
+  EXPECT_TRUE(buffer.empty());
+  EXPECT_FALSE(buffer.full());
+  EXPECT_EQ(buffer.size(), 0);
+  EXPECT_EQ(buffer.capacity(), 4);
+}
+
+TEST(RingBufferTest, push_pop_fifoOrder) {
+  RingBuffer<int> buffer(4);
+  EXPECT_TRUE(buffer.Push(1));
+  EXPECT_TRUE(buffer.Push(2));
+  EXPECT_TRUE(buffer.Push(3));
+  EXPECT_EQ(buffer.size(), 3);
+  EXPECT_EQ(buffer.front(), 1);
+  buffer.Pop();
+  EXPECT_EQ(buffer.front(), 2);
+  buffer.Pop();
+  EXPECT_EQ(buffer.front(), 3);
+  buffer.Pop();
+  EXPECT_TRUE(buffer.empty());
+}
+
+TEST(RingBufferTest, push_overwritesOldestWhenFull) {
+  RingBuffer<int> buffer(3);
+  buffer.Push(1);
+  buffer.Push(2);
+  buffer.Push(3);
+  EXPECT_TRUE(buffer.full());
+  EXPECT_FALSE(buffer.Push(4));
+  EXPECT_EQ(buffer.size(), 3);
+  EXPECT_EQ(buffer[0], 2);
+  EXPECT_EQ(buffer[1], 3);
+  EXPECT_EQ(buffer[2], 4);
+}
+
+TEST(RingBufferTest, wrapsAround) {
+  RingBuffer<int> buffer(3);
+  for (int i = 0; i < 10; ++i) {
+    buffer.Push(i);
+    if (buffer.size() == 2) buffer.Pop();
+  }
+  EXPECT_EQ(buffer.size(), 1);
+  EXPECT_EQ(buffer.front(), 9);
+}
+
+TEST(RingBufferTest, clear_empties) {
+  RingBuffer<int> buffer(2);
+  buffer.Push(1);
+  buffer.Push(2);
+  buffer.Clear();
+  EXPECT_TRUE(buffer.empty());
+  buffer.Push(3);
+  EXPECT_EQ(buffer.front(), 3);
+}
+
+}  // namespace util